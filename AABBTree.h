@@ -0,0 +1,315 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <assert.h>
+#include "GameMaths.h"
+#include "Collider.h"
+#include "GJK.h"
+
+//Dynamic bounding volume tree for moving colliders (crates, doors, other players)
+//Leaves store fattened AABBs, so a collider only gets reinserted once it moves out of its fat bounds
+//Tree is kept balanced with AVL-style rotations, so insert/remove/move are O(log n)
+//Based on Erin Catto's b2DynamicTree (Box2D)
+
+#define AABB_TREE_NULL -1
+#define AABB_TREE_FAT_MARGIN 0.1f	//fat bounds are this much bigger than the collider on every side
+#define AABB_TREE_DISPLACEMENT_MULTIPLIER 2.0f	//fat bounds also stretch in the direction a collider moved
+#define AABB_TREE_MAX_DEPTH 256	//queries assert the tree is shallower than this
+
+struct AABBTreeNode {
+	AABB bounds;		//fat bounds for leaves
+	Collider* collider;	//NULL for internal nodes
+	int32_t parent;		//next node in free list if node is unused
+	int32_t left, right;	//AABB_TREE_NULL for leaves
+	int32_t height;		//leaves are 0, unused nodes are -1
+};
+
+struct AABBTree {
+	AABBTreeNode* nodes;
+	int32_t capacity;
+	int32_t num_nodes;
+	int32_t root;
+	int32_t free_list;
+};
+
+AABBTree init_aabb_tree(int32_t initial_capacity=16);
+void clear_aabb_tree(AABBTree* tree);
+//Returns a proxy id for the collider (stable until it's removed)
+int32_t aabb_tree_insert(AABBTree* tree, Collider* collider);
+void aabb_tree_remove(AABBTree* tree, int32_t proxy);
+//Call after the collider has moved by displacement. Returns true if it left its fat bounds and was reinserted
+bool aabb_tree_move(AABBTree* tree, int32_t proxy, vec3 displacement);
+//Writes colliders whose fat bounds overlap box, returns how many (at most max_results)
+int aabb_tree_query(const AABBTree &tree, AABB box, Collider** results, int max_results);
+//Writes colliders intersecting the capsule (broadphase on the tree, then GJK), returns how many
+int aabb_tree_query_capsule(const AABBTree &tree, Capsule* capsule, Collider** results, int max_results);
+
+static bool aabb_contains(const AABB &outer, const AABB &inner){
+    for(int k=0; k<3; k++){
+        if(inner.min.v[k]<outer.min.v[k] || inner.max.v[k]>outer.max.v[k]) return false;
+    }
+    return true;
+}
+
+static float aabb_surface_area(AABB a){
+    vec3 d = a.max - a.min;
+    return 2*(d.x*d.y + d.y*d.z + d.z*d.x);
+}
+
+AABBTree init_aabb_tree(int32_t initial_capacity){
+    AABBTree tree;
+    tree.capacity = MAX(initial_capacity, 1);
+    tree.nodes = (AABBTreeNode*)malloc(tree.capacity*sizeof(AABBTreeNode));
+    tree.num_nodes = 0;
+    tree.root = AABB_TREE_NULL;
+    //Link all nodes into free list
+    for(int32_t i=0; i<tree.capacity; i++){
+        tree.nodes[i].parent = (i+1<tree.capacity) ? i+1 : AABB_TREE_NULL;
+        tree.nodes[i].height = -1;
+    }
+    tree.free_list = 0;
+    return tree;
+}
+
+void clear_aabb_tree(AABBTree* tree){
+    free(tree->nodes);
+    tree->nodes = NULL;
+    tree->capacity = tree->num_nodes = 0;
+    tree->root = tree->free_list = AABB_TREE_NULL;
+}
+
+static int32_t alloc_aabb_tree_node(AABBTree* tree){
+    if(tree->free_list==AABB_TREE_NULL){
+        //Grow node pool, doubling capacity
+        int32_t old_capacity = tree->capacity;
+        tree->capacity *= 2;
+        tree->nodes = (AABBTreeNode*)realloc((void*)tree->nodes, tree->capacity*sizeof(AABBTreeNode));
+        for(int32_t i=old_capacity; i<tree->capacity; i++){
+            tree->nodes[i].parent = (i+1<tree->capacity) ? i+1 : AABB_TREE_NULL;
+            tree->nodes[i].height = -1;
+        }
+        tree->free_list = old_capacity;
+    }
+    int32_t index = tree->free_list;
+    AABBTreeNode* node = &tree->nodes[index];
+    tree->free_list = node->parent;
+    node->parent = node->left = node->right = AABB_TREE_NULL;
+    node->height = 0;
+    node->collider = NULL;
+    tree->num_nodes++;
+    return index;
+}
+
+static void free_aabb_tree_node(AABBTree* tree, int32_t index){
+    tree->nodes[index].parent = tree->free_list;
+    tree->nodes[index].height = -1;
+    tree->free_list = index;
+    tree->num_nodes--;
+}
+
+//Rotate node a up if its subtrees are unbalanced, returns index of new subtree root
+static int32_t balance_aabb_tree_node(AABBTree* tree, int32_t ia){
+    AABBTreeNode* a = &tree->nodes[ia];
+    if(a->left==AABB_TREE_NULL || a->height<2) return ia;
+
+    int32_t ib = a->left, ic = a->right;
+    AABBTreeNode* b = &tree->nodes[ib];
+    AABBTreeNode* c = &tree->nodes[ic];
+    int32_t balance = c->height - b->height;
+
+    //Rotate c up (or b, mirror image)
+    if(balance>1 || balance<-1){
+        int32_t iup = (balance>1) ? ic : ib;     //child that moves up
+        int32_t iother = (balance>1) ? ib : ic;  //child that stays under a
+        AABBTreeNode* up = &tree->nodes[iup];
+        int32_t i_f = up->left, ig = up->right;
+        AABBTreeNode* f = &tree->nodes[i_f];
+        AABBTreeNode* g = &tree->nodes[ig];
+
+        //Swap a and up
+        up->left = ia;
+        up->parent = a->parent;
+        a->parent = iup;
+        if(up->parent!=AABB_TREE_NULL){
+            if(tree->nodes[up->parent].left==ia) tree->nodes[up->parent].left = iup;
+            else tree->nodes[up->parent].right = iup;
+        }
+        else tree->root = iup;
+
+        //Taller grandchild stays with up, shorter one goes under a
+        int32_t ikeep = (f->height>g->height) ? i_f : ig;
+        int32_t igive = (f->height>g->height) ? ig : i_f;
+        up->right = ikeep;
+        if(balance>1) a->right = igive;
+        else a->left = igive;
+        tree->nodes[igive].parent = ia;
+
+        a->bounds = aabb_union(tree->nodes[iother].bounds, tree->nodes[igive].bounds);
+        up->bounds = aabb_union(a->bounds, tree->nodes[ikeep].bounds);
+        a->height = 1 + MAX(tree->nodes[iother].height, tree->nodes[igive].height);
+        up->height = 1 + MAX(a->height, tree->nodes[ikeep].height);
+        return iup;
+    }
+    return ia;
+}
+
+static void insert_aabb_tree_leaf(AABBTree* tree, int32_t leaf){
+    if(tree->root==AABB_TREE_NULL){
+        tree->root = leaf;
+        tree->nodes[leaf].parent = AABB_TREE_NULL;
+        return;
+    }
+
+    //Find best sibling by walking down the tree, using cost of increasing surface area
+    AABB leaf_bounds = tree->nodes[leaf].bounds;
+    int32_t index = tree->root;
+    while(tree->nodes[index].left!=AABB_TREE_NULL){
+        const AABBTreeNode &node = tree->nodes[index];
+        float area = aabb_surface_area(node.bounds);
+        float combined_area = aabb_surface_area(aabb_union(node.bounds, leaf_bounds));
+
+        //Cost of creating a new parent for this node and the new leaf
+        float cost = 2*combined_area;
+        //Minimum cost of pushing the leaf further down the tree
+        float inheritance_cost = 2*(combined_area - area);
+
+        float child_cost[2];
+        int32_t children[2] = { node.left, node.right };
+        for(int i=0; i<2; i++){
+            const AABBTreeNode &child = tree->nodes[children[i]];
+            float new_area = aabb_surface_area(aabb_union(leaf_bounds, child.bounds));
+            if(child.left==AABB_TREE_NULL) child_cost[i] = new_area + inheritance_cost;
+            else child_cost[i] = new_area - aabb_surface_area(child.bounds) + inheritance_cost;
+        }
+
+        if(cost<child_cost[0] && cost<child_cost[1]) break;
+        index = (child_cost[0]<child_cost[1]) ? children[0] : children[1];
+    }
+    int32_t sibling = index;
+
+    //Create new parent for sibling and leaf
+    int32_t old_parent = tree->nodes[sibling].parent;
+    int32_t new_parent = alloc_aabb_tree_node(tree); //NB: may realloc nodes
+    tree->nodes[new_parent].parent = old_parent;
+    tree->nodes[new_parent].bounds = aabb_union(leaf_bounds, tree->nodes[sibling].bounds);
+    tree->nodes[new_parent].height = tree->nodes[sibling].height + 1;
+    tree->nodes[new_parent].left = sibling;
+    tree->nodes[new_parent].right = leaf;
+    tree->nodes[sibling].parent = new_parent;
+    tree->nodes[leaf].parent = new_parent;
+    if(old_parent!=AABB_TREE_NULL){
+        if(tree->nodes[old_parent].left==sibling) tree->nodes[old_parent].left = new_parent;
+        else tree->nodes[old_parent].right = new_parent;
+    }
+    else tree->root = new_parent;
+
+    //Walk back up fixing heights and bounds
+    index = tree->nodes[leaf].parent;
+    while(index!=AABB_TREE_NULL){
+        index = balance_aabb_tree_node(tree, index);
+        AABBTreeNode* node = &tree->nodes[index];
+        node->height = 1 + MAX(tree->nodes[node->left].height, tree->nodes[node->right].height);
+        node->bounds = aabb_union(tree->nodes[node->left].bounds, tree->nodes[node->right].bounds);
+        index = node->parent;
+    }
+}
+
+static void remove_aabb_tree_leaf(AABBTree* tree, int32_t leaf){
+    if(leaf==tree->root){
+        tree->root = AABB_TREE_NULL;
+        return;
+    }
+
+    //Replace parent with sibling
+    int32_t parent = tree->nodes[leaf].parent;
+    int32_t grandparent = tree->nodes[parent].parent;
+    int32_t sibling = (tree->nodes[parent].left==leaf) ? tree->nodes[parent].right : tree->nodes[parent].left;
+    free_aabb_tree_node(tree, parent);
+    tree->nodes[sibling].parent = grandparent;
+    if(grandparent==AABB_TREE_NULL){
+        tree->root = sibling;
+        return;
+    }
+    if(tree->nodes[grandparent].left==parent) tree->nodes[grandparent].left = sibling;
+    else tree->nodes[grandparent].right = sibling;
+
+    int32_t index = grandparent;
+    while(index!=AABB_TREE_NULL){
+        index = balance_aabb_tree_node(tree, index);
+        AABBTreeNode* node = &tree->nodes[index];
+        node->height = 1 + MAX(tree->nodes[node->left].height, tree->nodes[node->right].height);
+        node->bounds = aabb_union(tree->nodes[node->left].bounds, tree->nodes[node->right].bounds);
+        index = node->parent;
+    }
+}
+
+static AABB fatten_aabb(AABB box, vec3 displacement){
+    vec3 margin = vec3(AABB_TREE_FAT_MARGIN, AABB_TREE_FAT_MARGIN, AABB_TREE_FAT_MARGIN);
+    box.min -= margin;
+    box.max += margin;
+    //Predict further movement in the same direction
+    for(int k=0; k<3; k++){
+        float d = AABB_TREE_DISPLACEMENT_MULTIPLIER*displacement.v[k];
+        if(d<0) box.min.v[k] += d;
+        else box.max.v[k] += d;
+    }
+    return box;
+}
+
+int32_t aabb_tree_insert(AABBTree* tree, Collider* collider){
+    int32_t proxy = alloc_aabb_tree_node(tree);
+    tree->nodes[proxy].bounds = fatten_aabb(collider_aabb(collider), vec3(0,0,0));
+    tree->nodes[proxy].collider = collider;
+    insert_aabb_tree_leaf(tree, proxy);
+    return proxy;
+}
+
+void aabb_tree_remove(AABBTree* tree, int32_t proxy){
+    remove_aabb_tree_leaf(tree, proxy);
+    free_aabb_tree_node(tree, proxy);
+}
+
+bool aabb_tree_move(AABBTree* tree, int32_t proxy, vec3 displacement){
+    AABB box = collider_aabb(tree->nodes[proxy].collider);
+    if(aabb_contains(tree->nodes[proxy].bounds, box)) return false;
+
+    remove_aabb_tree_leaf(tree, proxy);
+    tree->nodes[proxy].bounds = fatten_aabb(box, displacement);
+    insert_aabb_tree_leaf(tree, proxy);
+    return true;
+}
+
+int aabb_tree_query(const AABBTree &tree, AABB box, Collider** results, int max_results){
+    if(tree.root==AABB_TREE_NULL) return 0;
+    //Stack holds at most one pending sibling per level plus two children, so height+1 entries
+    //The tree is AVL balanced, so this only fails if it's been corrupted
+    assert(tree.nodes[tree.root].height<AABB_TREE_MAX_DEPTH);
+    int num_results = 0;
+    int32_t stack[AABB_TREE_MAX_DEPTH];
+    int stack_size = 0;
+    stack[stack_size++] = tree.root;
+    while(stack_size>0 && num_results<max_results){
+        const AABBTreeNode &node = tree.nodes[stack[--stack_size]];
+        if(!aabb_overlaps(node.bounds, box)) continue;
+        if(node.left==AABB_TREE_NULL){
+            results[num_results++] = node.collider;
+        }
+        else {
+            stack[stack_size++] = node.left;
+            stack[stack_size++] = node.right;
+        }
+    }
+    return num_results;
+}
+
+int aabb_tree_query_capsule(const AABBTree &tree, Capsule* capsule, Collider** results, int max_results){
+    PROFILE_FUNCTION();
+    int num_candidates = aabb_tree_query(tree, collider_aabb(capsule), results, max_results);
+    int num_results = 0;
+    for(int i=0; i<num_candidates; i++){
+        if(results[i]==capsule) continue;
+        if(gjk(capsule, results[i])) results[num_results++] = results[i];
+    }
+    return num_results;
+}
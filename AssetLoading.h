@@ -0,0 +1,71 @@
+#pragma once
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <atomic>
+#include "JobSystem.h"
+#include "load_obj.h"
+#include "Level.h"
+#include "Profiler.h"
+
+//Meshes are parsed (and collision data built) on job system workers while the main thread
+//creates the window and compiles shaders. Main thread polls mesh_load_done() and uploads
+//each mesh to GL as soon as it arrives; GL calls never happen on workers
+//With no workers (single core) submit_mesh_load() just loads on the calling thread
+
+struct MeshLoad {
+	const char* file_name;
+	bool build_level;		//also build a LevelCollider from the mesh
+	bool loaded;			//false if the file couldn't be loaded
+	float* vp;
+	float* vt;
+	float* vn;
+	uint16_t* indices;
+	uint32_t num_verts;
+	uint32_t num_indices;
+	LevelCollider level;	//if build_level, owned by caller once loaded (zeroed if not)
+	JobCounter counter;
+};
+
+//file_name is relative to OBJ_PATH and must stay valid until the load is done
+void submit_mesh_load(MeshLoad* load, const char* file_name, bool build_level=false);
+inline bool mesh_load_done(const MeshLoad &load){
+	return load.counter.num_pending.load(std::memory_order_acquire)==0;
+}
+//Free CPU-side render data once it's uploaded (level is untouched)
+void free_mesh_load(MeshLoad* load);
+
+static void mesh_load_job(void* data){
+	MeshLoad* load = (MeshLoad*)data;
+	PROFILE_SCOPE(load->file_name);
+	load->loaded = load_obj_indexed(load->file_name, &load->vp, &load->vt, &load->vn, &load->indices, &load->num_verts, &load->num_indices);
+	if(!load->loaded || !load->build_level) return;
+
+	//Level takes ownership of its verts/indices (and frees them if it turns out to be a heightfield),
+	//so give it a copy and keep the originals for the GL upload
+	float* level_vp = (float*)malloc(3*load->num_verts*sizeof(float));
+	uint16_t* level_indices = (uint16_t*)malloc(load->num_indices*sizeof(uint16_t));
+	memcpy(level_vp, load->vp, 3*load->num_verts*sizeof(float));
+	memcpy(level_indices, load->indices, load->num_indices*sizeof(uint16_t));
+	load->level = init_level(level_vp, level_indices, load->num_verts, load->num_indices);
+}
+
+void submit_mesh_load(MeshLoad* load, const char* file_name, bool build_level){
+	load->file_name = file_name;
+	load->build_level = build_level;
+	load->loaded = false;
+	load->vp = load->vt = load->vn = NULL;
+	load->indices = NULL;
+	load->num_verts = load->num_indices = 0;
+	memset(&load->level, 0, sizeof(LevelCollider)); //so clear_level() is safe on it whether or not the load works
+	job_submit(mesh_load_job, load, &load->counter);
+}
+
+void free_mesh_load(MeshLoad* load){
+	free(load->vp);
+	free(load->vt);
+	free(load->vn);
+	free(load->indices);
+	load->vp = load->vt = load->vn = NULL;
+	load->indices = NULL;
+}
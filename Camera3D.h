@@ -33,7 +33,9 @@ void Camera3D::init(){
 	V = look_at(pos, pos+fwd, up);
 	P = perspective(90/gl_aspect_ratio, gl_aspect_ratio, near_plane, far_plane);
 
+#ifndef HEADLESS
     if(cam_mouse_controls) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); 
+#endif
 }
 
 void Camera3D::init(vec3 cam_pos){
@@ -48,7 +50,9 @@ void Camera3D::init(vec3 cam_pos){
 	move_speed = 10;
 	turn_speed = 100;
 
+#ifndef HEADLESS
     if(cam_mouse_controls) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); 
+#endif
 }
 
 void Camera3D::init(vec3 cam_pos, vec3 target_pos){
@@ -63,7 +67,9 @@ void Camera3D::init(vec3 cam_pos, vec3 target_pos){
 	move_speed = 10;
 	turn_speed = 100;
 
+#ifndef HEADLESS
     if(cam_mouse_controls) glfwSetInputMode(window, GLFW_CURSOR, GLFW_CURSOR_DISABLED); 
+#endif
 }
 
 void Camera3D::update_debug(double dt){
@@ -158,6 +164,7 @@ void Camera3D::update_player(vec3 player_pos, double dt){
     V = R*V;
 }
 
+#ifndef HEADLESS
 void window_resize_callback(GLFWwindow* window, int width, int height){
     gl_width = width;
     gl_height = height;
@@ -167,3 +174,4 @@ void window_resize_callback(GLFWwindow* window, int width, int height){
 	glfwGetFramebufferSize(window,&fb_w,&fb_h);
 	glViewport(0,0,fb_w,fb_h);
 }
+#endif
@@ -1,42 +1,174 @@
 #pragma once
+#include <stdio.h>
+#include <math.h>
 #include "GameMaths.h"
 
 //Kevin's simple collider objects for collision detection
 //Different shapes which inherit from Collider and implement
 //support() function for use in GJK
 
+//Axis-aligned bounding box
+struct AABB {
+    vec3 min, max;
+};
+
+inline AABB aabb_union(const AABB &a, const AABB &b){
+    AABB r;
+    for(int k=0; k<3; k++){
+        r.min.v[k] = MIN(a.min.v[k], b.min.v[k]);
+        r.max.v[k] = MAX(a.max.v[k], b.max.v[k]);
+    }
+    return r;
+}
+
+inline bool aabb_overlaps(const AABB &a, const AABB &b){
+    for(int k=0; k<3; k++){
+        if(a.max.v[k]<b.min.v[k] || b.max.v[k]<a.min.v[k]) return false;
+    }
+    return true;
+}
+
+inline bool aabb_overlaps_sphere(const AABB &a, vec3 center, float radius){
+    float dist2 = 0;
+    for(int k=0; k<3; k++){
+        float d = center.v[k] - CLAMP(center.v[k], a.min.v[k], a.max.v[k]);
+        dist2 += d*d;
+    }
+    return dist2 <= radius*radius;
+}
+
+enum ColliderType {
+    COLLIDER_CAPSULE,
+    COLLIDER_TRIANGLE,
+    COLLIDER_CONVEX_HULL,
+    COLLIDER_SPHERE,
+    COLLIDER_BOX,
+    COLLIDER_CYLINDER,
+    COLLIDER_COMPOUND,
+    NUM_COLLIDER_TYPES
+};
+const char* collider_type_names[NUM_COLLIDER_TYPES] = { "capsule", "triangle", "convex hull", "sphere", "box", "cylinder", "compound" };
+
+//Write floats with enough digits to reproduce them exactly
+inline void write_floats(FILE* fp, const char* label, const float* f, int count){
+    fprintf(fp, "  %s", label);
+    for(int i=0; i<count; i++) fprintf(fp, " %.9g", f[i]);
+    fprintf(fp, "\n");
+}
+
 //Base struct for all collision shapes
 struct Collider {
-    vec3    pos;            //origin in world space
-    mat3    matRS;          //rotation/scale component of model matrix
-    mat3    matRS_inverse; 
+    ColliderType type;
+    Transform xform;        //model space to world space (xform.pos is origin in world space)
     virtual vec3 support(vec3 dir) = 0;
+
+    Collider(){ xform = identity_transform(); }
+
+    //Dump full state of collider (e.g. to reproduce a failed query offline)
+    virtual void write_state(FILE* fp){
+        fprintf(fp, "  type %s\n", collider_type_names[type]);
+        write_floats(fp, "pos", xform.pos.v, 3);
+        write_floats(fp, "rot", xform.rot.q, 4);
+        write_floats(fp, "scale", xform.scale.v, 3);
+    }
 };
+//vptr + type + 48-byte Transform (16-byte aligned) = one cache line, was 96 bytes with pos/matRS/matRS_inverse
+static_assert(sizeof(Collider)<=64, "Collider base should fit in a cache line");
 
 //Capsule: Height-aligned with y-axis
 struct Capsule : Collider {
     float r, y_base, y_cap;
 
+    Capsule(){ type = COLLIDER_CAPSULE; }
+
     vec3 support(vec3 dir){
-        dir = matRS_inverse*dir; //find support in model space
+        dir = inverse_transform_dir(xform, dir); //find support in model space
 
         vec3 result = normalise(dir)*r;
         result.y += (dir.y>0) ? y_cap : y_base;
 
-        return matRS*result + pos; //convert support to world space
+        return transform_point(xform, result); //convert support to world space
+    }
+
+    void write_state(FILE* fp){
+        Collider::write_state(fp);
+        fprintf(fp, "  r %.9g y_base %.9g y_cap %.9g\n", r, y_base, y_cap);
+    }
+};
+
+//Sphere: Centred on origin
+struct Sphere : Collider {
+    float r;
+
+    Sphere(){ type = COLLIDER_SPHERE; }
+
+    vec3 support(vec3 dir){
+        dir = inverse_transform_dir(xform, dir); //find support in model space
+        return transform_point(xform, normalise(dir)*r); //convert support to world space
+    }
+
+    void write_state(FILE* fp){
+        Collider::write_state(fp);
+        fprintf(fp, "  r %.9g\n", r);
+    }
+};
+
+//Box: Centred on origin, xform makes it an OBB
+struct Box : Collider {
+    vec3 half_extents;
+
+    Box(){ type = COLLIDER_BOX; }
+
+    vec3 support(vec3 dir){
+        dir = inverse_transform_dir(xform, dir); //find support in model space
+
+        //Corner in the octant of dir
+        vec3 result = vec3(copysignf(half_extents.x, dir.x), copysignf(half_extents.y, dir.y), copysignf(half_extents.z, dir.z));
+
+        return transform_point(xform, result); //convert support to world space
+    }
+
+    void write_state(FILE* fp){
+        Collider::write_state(fp);
+        write_floats(fp, "half_extents", half_extents.v, 3);
+    }
+};
+
+//Cylinder: Height-aligned with y-axis
+struct Cylinder : Collider {
+    float r, y_base, y_cap;
+
+    Cylinder(){ type = COLLIDER_CYLINDER; }
+
+    vec3 support(vec3 dir){
+        dir = inverse_transform_dir(xform, dir); //find support in model space
+
+        //Furthest point on rim of whichever cap dir points at
+        float radial_length = sqrtf(dir.x*dir.x + dir.z*dir.z);
+        float radial_scale = (radial_length>0) ? r/radial_length : 0;
+        vec3 result = vec3(dir.x*radial_scale, (dir.y>0) ? y_cap : y_base, dir.z*radial_scale);
+
+        return transform_point(xform, result); //convert support to world space
+    }
+
+    void write_state(FILE* fp){
+        Collider::write_state(fp);
+        fprintf(fp, "  r %.9g y_base %.9g y_cap %.9g\n", r, y_base, y_cap);
     }
 };
 
 //Triangle: Kind of a hack 
 // "All physics code is an awful hack" - Will, #HandmadeDev
 //Need to fake a prism for GJK to converge
-//NB: Currently using world-space points, ignore matRS and pos from base class
+//NB: Currently using world-space points, ignore xform from base class (except xform.pos for GJK's initial search dir)
 //Don't use EPA with this! Might resolve collision along any one of prism's faces
 //Only resolve around triangle normal
 struct TriangleCollider : Collider {
     vec3 points[3];
     vec3 normal;
 
+    TriangleCollider(){ type = COLLIDER_TRIANGLE; }
+
     vec3 support(vec3 dir){
         //Find which triangle vertex is furthest along dir
         float dot0 = dot(points[0], dir);
@@ -57,4 +189,45 @@ struct TriangleCollider : Collider {
 
         return furthest_point;
     }
+
+    void write_state(FILE* fp){
+        fprintf(fp, "  type %s\n", collider_type_names[type]);
+        write_floats(fp, "pos", xform.pos.v, 3);
+        write_floats(fp, "points", points[0].v, 3);
+        write_floats(fp, "", points[1].v, 3);
+        write_floats(fp, "", points[2].v, 3);
+        write_floats(fp, "normal", normal.v, 3);
+    }
 };
+
+//Tight world-space bounds of a collider
+inline AABB collider_aabb(Collider* collider){
+    AABB box;
+    if(collider->type==COLLIDER_CAPSULE){
+        //Segment endpoints plus extents of the (scaled) sphere, avoids 6 virtual support calls
+        //NB: Bounds the exact scaled shape, which contains everything support() returns for non-uniform scale
+        Capsule* capsule = (Capsule*)collider;
+        vec3 p0 = transform_point(capsule->xform, vec3(0, capsule->y_base, 0));
+        vec3 p1 = transform_point(capsule->xform, vec3(0, capsule->y_cap, 0));
+        versor inv_rot = conjugate(capsule->xform.rot);
+        for(int k=0; k<3; k++){
+            vec3 axis = vec3(0,0,0);
+            axis.v[k] = 1;
+            vec3 local_axis = rotate(inv_rot, axis);
+            vec3 s = capsule->xform.scale;
+            float extent = capsule->r*length(vec3(local_axis.x*s.x, local_axis.y*s.y, local_axis.z*s.z));
+            box.min.v[k] = MIN(p0.v[k], p1.v[k]) - extent;
+            box.max.v[k] = MAX(p0.v[k], p1.v[k]) + extent;
+        }
+        return box;
+    }
+    //General case: 6 calls to support function
+    for(int k=0; k<3; k++){
+        vec3 dir = vec3(0,0,0);
+        dir.v[k] = 1;
+        box.max.v[k] = collider->support(dir).v[k];
+        dir.v[k] = -1;
+        box.min.v[k] = collider->support(dir).v[k];
+    }
+    return box;
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <mutex>
+#include "Collider.h"
+
+//Counters to see where collision time goes, per query and per frame
+//Compiled out unless COLLISION_STATS is defined (it's on by default in Debug builds)
+//Counters are thread_local, so each thread reads the stats of the queries it ran itself
+
+//Queries that hit an iteration cap always have both shapes dumped to this file (stats or not),
+//so pathological cases from release builds can be reproduced offline
+#define COLLISION_FAILURE_LOG_PATH "collision_failures.log"
+#define COLLISION_MAX_FAILURE_LOGS 100 //per run, so a bad level can't fill the disk
+
+#if defined(DEBUG) && !defined(COLLISION_STATS)
+#define COLLISION_STATS
+#endif
+
+struct CollisionStats {
+	uint32_t num_queries;
+	uint32_t faces_considered;
+	uint32_t broadphase_survivors;
+	uint32_t ground_cache_hits;		//player found its faces by walking the mesh
+	uint32_t ground_cache_misses;	//needed a full search
+	uint32_t closed_form_tests;	//pairs collide() handled without GJK
+	uint32_t gjk_calls;
+	uint32_t gjk_iterations;
+	uint32_t epa_runs;
+	uint32_t epa_iterations;
+	uint32_t epa_failures;		//EPA didn't converge
+};
+
+//Iteration counts of GJK/EPA queries for one pair of shape types
+#define COLLISION_HISTOGRAM_MAX_ITERATIONS 64 //>= GJK_MAX_NUM_ITERATIONS and EPA_MAX_NUM_ITERATIONS
+struct IterationHistogram {
+	uint32_t counts[COLLISION_HISTOGRAM_MAX_ITERATIONS+1]; //counts[i] = number of queries that took i iterations
+	uint32_t num_capped; //queries that gave up at the iteration cap (also included in counts)
+};
+
+struct CollisionHistograms {
+	IterationHistogram gjk[NUM_COLLIDER_TYPES][NUM_COLLIDER_TYPES]; //indexed [coll1->type][coll2->type]
+	IterationHistogram epa[NUM_COLLIDER_TYPES][NUM_COLLIDER_TYPES];
+};
+
+//Reset per-frame counters; stats for the frame that just ended can then be read with collision_stats_last_frame()
+void collision_stats_begin_frame();
+//Reset per-query counters (called at the start of collide_player_ground etc.)
+void collision_stats_begin_query();
+const CollisionStats& collision_stats_query();		//current/most recent query
+const CollisionStats& collision_stats_frame();		//current frame so far
+const CollisionStats& collision_stats_last_frame();
+void print_collision_stats(const CollisionStats &stats, FILE* fp=stdout);
+
+//Called by gjk()/EPA() once per query
+void collision_stats_record_gjk(const Collider* coll1, const Collider* coll2, int iterations, bool capped);
+void collision_stats_record_epa(const Collider* coll1, const Collider* coll2, int iterations, bool capped);
+//Histograms accumulate for the lifetime of the thread, reset with collision_histograms_reset()
+const CollisionHistograms& collision_histograms();
+void collision_histograms_reset();
+void print_collision_histograms(const CollisionHistograms &histograms, FILE* fp=stdout);
+//Append full state of both colliders to COLLISION_FAILURE_LOG_PATH
+void log_collision_failure(const char* reason, Collider* coll1, Collider* coll2);
+
+#ifdef COLLISION_STATS
+thread_local CollisionStats g_collision_stats_query;
+thread_local CollisionStats g_collision_stats_frame;
+thread_local CollisionStats g_collision_stats_last_frame;
+thread_local CollisionHistograms g_collision_histograms;
+
+#define COLLISION_STAT_ADD(counter, n) { \
+	g_collision_stats_query.counter += (n); \
+	g_collision_stats_frame.counter += (n); \
+}
+#else
+#define COLLISION_STAT_ADD(counter, n) {}
+#endif
+#define COLLISION_STAT_INC(counter) COLLISION_STAT_ADD(counter, 1)
+
+#ifdef COLLISION_STATS
+void collision_stats_begin_frame(){
+	g_collision_stats_last_frame = g_collision_stats_frame;
+	memset(&g_collision_stats_frame, 0, sizeof(CollisionStats));
+}
+
+void collision_stats_begin_query(){
+	memset(&g_collision_stats_query, 0, sizeof(CollisionStats));
+	COLLISION_STAT_INC(num_queries);
+}
+
+const CollisionStats& collision_stats_query(){ return g_collision_stats_query; }
+const CollisionStats& collision_stats_frame(){ return g_collision_stats_frame; }
+const CollisionStats& collision_stats_last_frame(){ return g_collision_stats_last_frame; }
+
+static void record_iterations(IterationHistogram* h, int iterations, bool capped){
+	if(iterations>COLLISION_HISTOGRAM_MAX_ITERATIONS) iterations = COLLISION_HISTOGRAM_MAX_ITERATIONS;
+	h->counts[iterations]++;
+	if(capped) h->num_capped++;
+}
+
+void collision_stats_record_gjk(const Collider* coll1, const Collider* coll2, int iterations, bool capped){
+	record_iterations(&g_collision_histograms.gjk[coll1->type][coll2->type], iterations, capped);
+}
+
+void collision_stats_record_epa(const Collider* coll1, const Collider* coll2, int iterations, bool capped){
+	record_iterations(&g_collision_histograms.epa[coll1->type][coll2->type], iterations, capped);
+}
+
+const CollisionHistograms& collision_histograms(){ return g_collision_histograms; }
+void collision_histograms_reset(){ memset(&g_collision_histograms, 0, sizeof(CollisionHistograms)); }
+
+#else
+static const CollisionStats g_collision_stats_empty = {};
+void collision_stats_begin_frame(){}
+void collision_stats_begin_query(){}
+const CollisionStats& collision_stats_query(){ return g_collision_stats_empty; }
+const CollisionStats& collision_stats_frame(){ return g_collision_stats_empty; }
+const CollisionStats& collision_stats_last_frame(){ return g_collision_stats_empty; }
+static const CollisionHistograms g_collision_histograms_empty = {};
+void collision_stats_record_gjk(const Collider*, const Collider*, int, bool){}
+void collision_stats_record_epa(const Collider*, const Collider*, int, bool){}
+const CollisionHistograms& collision_histograms(){ return g_collision_histograms_empty; }
+void collision_histograms_reset(){}
+#endif
+
+void print_collision_stats(const CollisionStats &stats, FILE* fp){
+	fprintf(fp, "queries: %u, faces: %u, broadphase survivors: %u, ", stats.num_queries, stats.faces_considered, stats.broadphase_survivors);
+	fprintf(fp, "ground cache: %u hits %u misses, ", stats.ground_cache_hits, stats.ground_cache_misses);
+	fprintf(fp, "closed form: %u, gjk: %u (%u iterations), ", stats.closed_form_tests, stats.gjk_calls, stats.gjk_iterations);
+	fprintf(fp, "epa: %u (%u iterations, %u failed)\n", stats.epa_runs, stats.epa_iterations, stats.epa_failures);
+}
+
+static void print_iteration_histogram(const char* algorithm, int type1, int type2, const IterationHistogram &h, FILE* fp){
+	uint32_t total = 0, max_iterations = 0;
+	uint64_t sum = 0;
+	for(int i=0; i<=COLLISION_HISTOGRAM_MAX_ITERATIONS; i++){
+		total += h.counts[i];
+		sum += (uint64_t)i*h.counts[i];
+		if(h.counts[i]) max_iterations = i;
+	}
+	if(total==0) return;
+
+	//Percentiles straight from the buckets
+	uint32_t p50 = 0, p99 = 0, running = 0;
+	for(int i=0; i<=COLLISION_HISTOGRAM_MAX_ITERATIONS; i++){
+		if(running<(total+1)/2 && running+h.counts[i]>=(total+1)/2) p50 = i;
+		if(running<total-total/100 && running+h.counts[i]>=total-total/100) p99 = i;
+		running += h.counts[i];
+	}
+	fprintf(fp, "%s %s-%s: %u queries, mean %.2f, p50 %u, p99 %u, max %u, capped %u\n",
+		algorithm, collider_type_names[type1], collider_type_names[type2],
+		total, (double)sum/total, p50, p99, max_iterations, h.num_capped);
+	fprintf(fp, "   ");
+	for(int i=0; i<=COLLISION_HISTOGRAM_MAX_ITERATIONS; i++){
+		if(h.counts[i]) fprintf(fp, " %d:%u", i, h.counts[i]);
+	}
+	fprintf(fp, "\n");
+}
+
+void print_collision_histograms(const CollisionHistograms &histograms, FILE* fp){
+	for(int i=0; i<NUM_COLLIDER_TYPES; i++){
+		for(int j=0; j<NUM_COLLIDER_TYPES; j++){
+			print_iteration_histogram("gjk", i, j, histograms.gjk[i][j], fp);
+			print_iteration_histogram("epa", i, j, histograms.epa[i][j], fp);
+		}
+	}
+}
+
+static std::mutex g_collision_failure_log_mutex;
+static int g_num_collision_failures_logged = 0;
+
+void log_collision_failure(const char* reason, Collider* coll1, Collider* coll2){
+	std::lock_guard<std::mutex> lock(g_collision_failure_log_mutex);
+	if(g_num_collision_failures_logged>=COLLISION_MAX_FAILURE_LOGS) return;
+	FILE* fp = fopen(COLLISION_FAILURE_LOG_PATH, "a");
+	if(!fp){
+		printf("Error: Failed to open %s for writing\n", COLLISION_FAILURE_LOG_PATH);
+		return;
+	}
+	fprintf(fp, "%s\ncoll1\n", reason);
+	coll1->write_state(fp);
+	fprintf(fp, "coll2\n");
+	coll2->write_state(fp);
+	fprintf(fp, "\n");
+	fclose(fp);
+	if(++g_num_collision_failures_logged==COLLISION_MAX_FAILURE_LOGS){
+		printf("Logged %d collision failures to %s, not logging any more\n", COLLISION_MAX_FAILURE_LOGS, COLLISION_FAILURE_LOG_PATH);
+	}
+}
@@ -0,0 +1,194 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include "GameMaths.h"
+#include "Collider.h"
+#include "Narrowphase.h"
+#include "Profiler.h"
+
+//Compound collider: union of convex children, each with a transform relative to the compound
+//A small BVH over the children (built once, refitted when the compound moves) means
+//collide_compound() only runs GJK/closed-form tests on children whose bounds overlap the other shape
+//NB: Child world transforms come from combine(), which is only exact for uniformly scaled compounds
+//NB: TriangleColliders use world-space points, so they can't be children
+
+#define COMPOUND_MAX_DEPTH 32
+
+struct CompoundNode {
+	AABB bounds;		//world space
+	uint32_t first;		//leaf: index into child_order, internal: index of left child (right is first+1)
+	uint32_t count;		//1 for leaves, 0 for internal nodes
+};
+
+struct CompoundContact {
+	int child;	//index into children
+	vec3 mtv;	//move compound by this to separate that child from the other shape
+};
+
+struct CompoundCollider : Collider {
+    Collider** children;        //not owned
+    Transform* child_xforms;    //child space to compound space
+    uint32_t num_children;
+    CompoundNode* nodes;        //children of a node are always stored after it
+    uint32_t num_nodes;
+    uint32_t* child_order;      //children in leaf order
+
+    CompoundCollider(){
+        type = COLLIDER_COMPOUND;
+        children = NULL;
+        child_xforms = NULL;
+        nodes = NULL;
+        child_order = NULL;
+        num_children = num_nodes = 0;
+    }
+
+    //Support of the convex hull of all children, for plain gjk() on the whole compound
+    vec3 support(vec3 dir){
+        vec3 best = children[0]->support(dir);
+        float best_dot = dot(best, dir);
+        for(uint32_t i=1; i<num_children; i++){
+            vec3 p = children[i]->support(dir);
+            float d = dot(p, dir);
+            if(d>best_dot){
+                best_dot = d;
+                best = p;
+            }
+        }
+        return best;
+    }
+
+    void write_state(FILE* fp){
+        Collider::write_state(fp);
+        fprintf(fp, "  num_children %u\n", num_children);
+        for(uint32_t i=0; i<num_children; i++) children[i]->write_state(fp);
+    }
+};
+
+//Copies child_xforms, keeps pointers to children (must outlive the compound)
+void init_compound(CompoundCollider* compound, Collider** children, const Transform* child_xforms, uint32_t num_children);
+//Call after changing compound->xform: moves children into world space and refits bounds
+void update_compound(CompoundCollider* compound);
+//Test every child whose bounds overlap other, writes contacts for those that hit and returns how many (at most max_contacts)
+int collide_compound(CompoundCollider* compound, Collider* other, CompoundContact* contacts, int max_contacts);
+void clear_compound(CompoundCollider* compound);
+
+//qsort has no context pointer
+static thread_local const vec3* g_compound_sort_centres;
+static thread_local int g_compound_sort_axis;
+static int compare_compound_centres(const void* a, const void* b){
+    float ca = g_compound_sort_centres[*(const uint32_t*)a].v[g_compound_sort_axis];
+    float cb = g_compound_sort_centres[*(const uint32_t*)b].v[g_compound_sort_axis];
+    return (ca>cb) - (ca<cb);
+}
+
+//Median split on longest axis of child centres, one child per leaf
+static void build_compound_node(CompoundCollider* compound, uint32_t node_index, uint32_t first, uint32_t count, const vec3* centres, int depth){
+    CompoundNode* node = &compound->nodes[node_index];
+    if(count==1 || depth>=COMPOUND_MAX_DEPTH){
+        node->first = first;
+        node->count = count;
+        return;
+    }
+    vec3 cmin = centres[compound->child_order[first]];
+    vec3 cmax = cmin;
+    for(uint32_t i=first+1; i<first+count; i++){
+        const vec3 &c = centres[compound->child_order[i]];
+        for(int k=0; k<3; k++){
+            cmin.v[k] = MIN(cmin.v[k], c.v[k]);
+            cmax.v[k] = MAX(cmax.v[k], c.v[k]);
+        }
+    }
+    int axis = 0;
+    if(cmax.y-cmin.y > cmax.v[axis]-cmin.v[axis]) axis = 1;
+    if(cmax.z-cmin.z > cmax.v[axis]-cmin.v[axis]) axis = 2;
+
+    g_compound_sort_centres = centres;
+    g_compound_sort_axis = axis;
+    qsort(&compound->child_order[first], count, sizeof(uint32_t), compare_compound_centres);
+
+    uint32_t left = compound->num_nodes;
+    compound->num_nodes += 2;
+    node->first = left;
+    node->count = 0;
+    build_compound_node(compound, left, first, count/2, centres, depth+1);
+    build_compound_node(compound, left+1, first+count/2, count-count/2, centres, depth+1);
+}
+
+void init_compound(CompoundCollider* compound, Collider** children, const Transform* child_xforms, uint32_t num_children){
+    compound->children = (Collider**)malloc(MAX(num_children, 1u)*sizeof(Collider*));
+    compound->child_xforms = (Transform*)malloc(MAX(num_children, 1u)*sizeof(Transform));
+    compound->child_order = (uint32_t*)malloc(MAX(num_children, 1u)*sizeof(uint32_t));
+    compound->nodes = (CompoundNode*)malloc(MAX(2*num_children, 1u)*sizeof(CompoundNode));
+    compound->num_children = num_children;
+    vec3* centres = (vec3*)malloc(MAX(num_children, 1u)*sizeof(vec3));
+    for(uint32_t i=0; i<num_children; i++){
+        compound->children[i] = children[i];
+        compound->child_xforms[i] = child_xforms[i];
+        compound->child_order[i] = i;
+        centres[i] = child_xforms[i].pos;
+    }
+    compound->num_nodes = 1;
+    if(num_children>0) build_compound_node(compound, 0, 0, num_children, centres, 0);
+    free(centres);
+    update_compound(compound);
+}
+
+void update_compound(CompoundCollider* compound){
+    if(compound->num_children==0) return;
+    for(uint32_t i=0; i<compound->num_children; i++){
+        compound->children[i]->xform = combine(compound->xform, compound->child_xforms[i]);
+    }
+    //Refit bottom-up, children come after parents so walk backwards
+    for(int32_t i=compound->num_nodes-1; i>=0; i--){
+        CompoundNode* node = &compound->nodes[i];
+        if(node->count>0){
+            node->bounds = collider_aabb(compound->children[compound->child_order[node->first]]);
+            for(uint32_t k=1; k<node->count; k++){
+                node->bounds = aabb_union(node->bounds, collider_aabb(compound->children[compound->child_order[node->first+k]]));
+            }
+        }
+        else node->bounds = aabb_union(compound->nodes[node->first].bounds, compound->nodes[node->first+1].bounds);
+    }
+}
+
+int collide_compound(CompoundCollider* compound, Collider* other, CompoundContact* contacts, int max_contacts){
+    PROFILE_FUNCTION();
+    if(compound->num_children==0) return 0;
+    AABB other_bounds = collider_aabb(other);
+    int num_contacts = 0;
+    uint32_t stack[COMPOUND_MAX_DEPTH+2];
+    int stack_size = 0;
+    stack[stack_size++] = 0;
+    while(stack_size>0 && num_contacts<max_contacts){
+        const CompoundNode &node = compound->nodes[stack[--stack_size]];
+        if(!aabb_overlaps(node.bounds, other_bounds)) continue;
+        if(node.count>0){
+            for(uint32_t k=0; k<node.count && num_contacts<max_contacts; k++){
+                uint32_t child = compound->child_order[node.first+k];
+                vec3 mtv;
+                if(!collide(compound->children[child], other, &mtv)) continue;
+                contacts[num_contacts].child = child;
+                contacts[num_contacts].mtv = mtv;
+                num_contacts++;
+            }
+        }
+        else {
+            stack[stack_size++] = node.first;
+            stack[stack_size++] = node.first+1;
+        }
+    }
+    return num_contacts;
+}
+
+void clear_compound(CompoundCollider* compound){
+    free(compound->children);
+    free(compound->child_xforms);
+    free(compound->nodes);
+    free(compound->child_order);
+    compound->children = NULL;
+    compound->child_xforms = NULL;
+    compound->nodes = NULL;
+    compound->child_order = NULL;
+    compound->num_children = compound->num_nodes = 0;
+}
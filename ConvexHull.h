@@ -0,0 +1,403 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include "GameMaths.h"
+#include "Collider.h"
+
+//Convex hull collider built from any point cloud (e.g. a mesh from load_obj) with quickhull
+//support() hill-climbs over the hull's vertex adjacency from the last support vertex,
+//so for GJK (where successive search directions are close) it's usually a handful of dot products
+//instead of a scan over every vertex
+
+#define CONVEX_HULL_LINEAR_SCAN_MAX_VERTS 16 //small hulls just check every vertex
+
+struct ConvexHull : Collider {
+    vec3* verts;                //model space
+    uint32_t num_verts;
+    uint16_t* indices;          //hull triangles with outward winding (3 per face)
+    uint32_t num_faces;
+    uint32_t* neighbour_start;  //num_verts+1 offsets into neighbours
+    uint32_t* neighbours;       //verts sharing an edge with each vert
+    uint32_t last_support;      //NB: support() writes this, so don't query one hull from two threads at once
+
+    ConvexHull(){
+        type = COLLIDER_CONVEX_HULL;
+        verts = NULL;
+        indices = NULL;
+        neighbour_start = neighbours = NULL;
+        num_verts = num_faces = last_support = 0;
+    }
+
+    vec3 support(vec3 dir){
+        dir = inverse_transform_dir(xform, dir); //find support in model space
+
+        uint32_t best = last_support;
+        float best_dot = dot(verts[best], dir);
+        if(num_verts<=CONVEX_HULL_LINEAR_SCAN_MAX_VERTS){
+            for(uint32_t i=0; i<num_verts; i++){
+                float d = dot(verts[i], dir);
+                if(d>best_dot){
+                    best_dot = d;
+                    best = i;
+                }
+            }
+        }
+        else {
+            //Walk to a better neighbour until there isn't one; on a convex hull the local max is the global max
+            bool improved = true;
+            while(improved){
+                improved = false;
+                uint32_t current = best;
+                for(uint32_t i=neighbour_start[current]; i<neighbour_start[current+1]; i++){
+                    uint32_t n = neighbours[i];
+                    float d = dot(verts[n], dir);
+                    if(d>best_dot){
+                        best_dot = d;
+                        best = n;
+                        improved = true;
+                    }
+                }
+            }
+        }
+        last_support = best;
+
+        return transform_point(xform, verts[best]); //convert support to world space
+    }
+
+    void write_state(FILE* fp){
+        Collider::write_state(fp);
+        fprintf(fp, "  num_verts %u\n", num_verts);
+        for(uint32_t i=0; i<num_verts; i++) write_floats(fp, "v", verts[i].v, 3);
+    }
+};
+
+//Build hull of vert_count points (3 floats each). Returns false if the points are degenerate (coplanar etc.)
+bool init_convex_hull(ConvexHull* hull, const float* vp, uint32_t vert_count);
+void clear_convex_hull(ConvexHull* hull);
+
+//Quickhull internals
+struct QuickhullFace {
+    uint32_t v[3];          //point indices, counterclockwise seen from outside
+    int32_t neighbour[3];   //face across edge i (v[i] -> v[(i+1)%3])
+    vec3 normal;
+    float dist;             //plane: dot(normal, p) = dist
+    int32_t first_outside;  //linked list of points in front of this face
+    uint32_t visited;
+    bool alive;
+};
+
+struct Quickhull {
+    vec3* points;
+    int32_t* next_outside;  //per point, next point in same outside list
+    QuickhullFace* faces;
+    uint32_t num_faces;
+    uint32_t capacity;
+    float epsilon;
+};
+
+static float quickhull_distance(const Quickhull &qh, const QuickhullFace &face, uint32_t point){
+    return dot(face.normal, qh.points[point]) - face.dist;
+}
+
+static uint32_t add_quickhull_face(Quickhull* qh, uint32_t a, uint32_t b, uint32_t c){
+    if(qh->num_faces==qh->capacity){
+        qh->capacity *= 2;
+        qh->faces = (QuickhullFace*)realloc((void*)qh->faces, qh->capacity*sizeof(QuickhullFace));
+    }
+    QuickhullFace* face = &qh->faces[qh->num_faces];
+    face->v[0] = a;
+    face->v[1] = b;
+    face->v[2] = c;
+    face->neighbour[0] = face->neighbour[1] = face->neighbour[2] = -1;
+    face->normal = normalise(cross(qh->points[b]-qh->points[a], qh->points[c]-qh->points[a]));
+    face->dist = dot(face->normal, qh->points[a]);
+    face->first_outside = -1;
+    face->visited = 0;
+    face->alive = true;
+    return qh->num_faces++;
+}
+
+//Put point in outside list of whichever face it's furthest in front of (if any)
+static void assign_quickhull_point(Quickhull* qh, uint32_t point, const uint32_t* faces, uint32_t num_faces){
+    float best_dist = qh->epsilon;
+    int32_t best_face = -1;
+    for(uint32_t i=0; i<num_faces; i++){
+        float d = quickhull_distance(*qh, qh->faces[faces[i]], point);
+        if(d>best_dist){
+            best_dist = d;
+            best_face = faces[i];
+        }
+    }
+    if(best_face<0) return; //inside hull, gone for good
+    qh->next_outside[point] = qh->faces[best_face].first_outside;
+    qh->faces[best_face].first_outside = point;
+}
+
+//Find neighbours for a small set of faces by matching each edge with its reverse
+static void link_quickhull_faces(Quickhull* qh, const uint32_t* faces, uint32_t num_faces){
+    for(uint32_t i=0; i<num_faces; i++){
+        QuickhullFace* f = &qh->faces[faces[i]];
+        for(int e=0; e<3; e++){
+            if(f->neighbour[e]>=0) continue;
+            uint32_t a = f->v[e], b = f->v[(e+1)%3];
+            for(uint32_t j=0; j<num_faces && f->neighbour[e]<0; j++){
+                if(j==i) continue;
+                QuickhullFace* g = &qh->faces[faces[j]];
+                for(int k=0; k<3; k++){
+                    if(g->v[k]==b && g->v[(k+1)%3]==a){
+                        f->neighbour[e] = faces[j];
+                        g->neighbour[k] = faces[i];
+                        break;
+                    }
+                }
+            }
+        }
+    }
+}
+
+bool init_convex_hull(ConvexHull* hull, const float* vp, uint32_t vert_count){
+    if(vert_count<4){
+        printf("Error: init_convex_hull needs at least 4 points, got %u\n", vert_count);
+        return false;
+    }
+    Quickhull qh;
+    qh.points = (vec3*)malloc(vert_count*sizeof(vec3));
+    qh.next_outside = (int32_t*)malloc(vert_count*sizeof(int32_t));
+    qh.capacity = 64;
+    qh.faces = (QuickhullFace*)malloc(qh.capacity*sizeof(QuickhullFace));
+    qh.num_faces = 0;
+    for(uint32_t i=0; i<vert_count; i++) qh.points[i] = vec3(vp[3*i], vp[3*i+1], vp[3*i+2]);
+
+    //Initial tetrahedron from extreme points
+    uint32_t extremes[6] = {0,0,0,0,0,0}; //min x, max x, min y...
+    for(uint32_t i=0; i<vert_count; i++){
+        for(int k=0; k<3; k++){
+            if(qh.points[i].v[k]<qh.points[extremes[2*k]].v[k]) extremes[2*k] = i;
+            if(qh.points[i].v[k]>qh.points[extremes[2*k+1]].v[k]) extremes[2*k+1] = i;
+        }
+    }
+    //Tolerance for "in front of a face", scaled to the input like qhull does
+    qh.epsilon = 0;
+    for(int k=0; k<3; k++){
+        qh.epsilon += MAX(fabsf(qh.points[extremes[2*k]].v[k]), fabsf(qh.points[extremes[2*k+1]].v[k]));
+    }
+    qh.epsilon *= 3*FLT_EPSILON;
+
+    uint32_t t[4] = {0, 0, 0, 0};
+    float best = -1;
+    for(int i=0; i<6; i++){
+        for(int j=i+1; j<6; j++){
+            vec3 d = qh.points[extremes[i]] - qh.points[extremes[j]];
+            if(dot(d,d)>best){
+                best = dot(d,d);
+                t[0] = extremes[i];
+                t[1] = extremes[j];
+            }
+        }
+    }
+    vec3 line = normalise(qh.points[t[1]] - qh.points[t[0]]);
+    best = -1;
+    for(uint32_t i=0; i<vert_count; i++){
+        vec3 d = qh.points[i] - qh.points[t[0]];
+        vec3 perp = d - line*dot(d, line);
+        if(dot(perp, perp)>best){
+            best = dot(perp, perp);
+            t[2] = i;
+        }
+    }
+    vec3 plane_normal = normalise(cross(qh.points[t[1]]-qh.points[t[0]], qh.points[t[2]]-qh.points[t[0]]));
+    best = -1;
+    for(uint32_t i=0; i<vert_count; i++){
+        float d = fabsf(dot(qh.points[i]-qh.points[t[0]], plane_normal));
+        if(d>best){
+            best = d;
+            t[3] = i;
+        }
+    }
+    if(best<=qh.epsilon || plane_normal==vec3(0,0,0)){
+        printf("Error: init_convex_hull got degenerate (flat) points\n");
+        free(qh.points);
+        free(qh.next_outside);
+        free(qh.faces);
+        return false;
+    }
+
+    //Each face of the tetrahedron leaves out one point, wind it to face away from that point
+    uint32_t start_faces[4];
+    for(int i=0; i<4; i++){
+        uint32_t a = t[(i+1)%4], b = t[(i+2)%4], c = t[(i+3)%4];
+        if(dot(cross(qh.points[b]-qh.points[a], qh.points[c]-qh.points[a]), qh.points[t[i]]-qh.points[a])>0){
+            uint32_t tmp = b;
+            b = c;
+            c = tmp;
+        }
+        start_faces[i] = add_quickhull_face(&qh, a, b, c);
+    }
+    link_quickhull_faces(&qh, start_faces, 4);
+    for(uint32_t i=0; i<vert_count; i++){
+        if(i==t[0] || i==t[1] || i==t[2] || i==t[3]) continue;
+        assign_quickhull_point(&qh, i, start_faces, 4);
+    }
+
+    //Scratch lists, any one step touches at most every face
+    uint32_t scratch_capacity = 64;
+    uint32_t* visible = (uint32_t*)malloc(scratch_capacity*sizeof(uint32_t));
+    uint32_t* horizon = (uint32_t*)malloc(3*scratch_capacity*2*sizeof(uint32_t)); //pairs: face, edge
+    uint32_t* new_faces = (uint32_t*)malloc(3*scratch_capacity*sizeof(uint32_t));
+    uint32_t* stack = (uint32_t*)malloc(scratch_capacity*sizeof(uint32_t));
+    uint32_t visit_stamp = 0;
+
+    //New faces go on the end, so one pass over the array handles them too
+    for(uint32_t f=0; f<qh.num_faces; f++){
+        if(!qh.faces[f].alive || qh.faces[f].first_outside<0) continue;
+        if(qh.num_faces>scratch_capacity){
+            scratch_capacity = 2*qh.num_faces;
+            visible = (uint32_t*)realloc(visible, scratch_capacity*sizeof(uint32_t));
+            horizon = (uint32_t*)realloc(horizon, 3*scratch_capacity*2*sizeof(uint32_t));
+            new_faces = (uint32_t*)realloc(new_faces, 3*scratch_capacity*sizeof(uint32_t));
+            stack = (uint32_t*)realloc(stack, scratch_capacity*sizeof(uint32_t));
+        }
+
+        //Furthest outside point is the next hull vertex
+        uint32_t eye = qh.faces[f].first_outside;
+        float eye_dist = quickhull_distance(qh, qh.faces[f], eye);
+        for(int32_t p=qh.next_outside[eye]; p>=0; p=qh.next_outside[p]){
+            float d = quickhull_distance(qh, qh.faces[f], p);
+            if(d>eye_dist){
+                eye_dist = d;
+                eye = p;
+            }
+        }
+
+        //Flood out from f over every face the eye can see, edges to faces it can't see form the horizon
+        visit_stamp++;
+        uint32_t num_visible = 0, num_horizon = 0, stack_size = 0;
+        stack[stack_size++] = f;
+        qh.faces[f].visited = visit_stamp;
+        while(stack_size>0){
+            uint32_t v = stack[--stack_size];
+            visible[num_visible++] = v;
+            for(int e=0; e<3; e++){
+                int32_t n = qh.faces[v].neighbour[e];
+                if(n<0 || qh.faces[n].visited==visit_stamp) continue;
+                if(quickhull_distance(qh, qh.faces[n], eye)>qh.epsilon){
+                    qh.faces[n].visited = visit_stamp;
+                    stack[stack_size++] = n;
+                }
+                else {
+                    horizon[2*num_horizon] = v;
+                    horizon[2*num_horizon+1] = e;
+                    num_horizon++;
+                }
+            }
+        }
+
+        //Cone of new faces from horizon to eye
+        for(uint32_t h=0; h<num_horizon; h++){
+            uint32_t v = horizon[2*h], e = horizon[2*h+1];
+            uint32_t a = qh.faces[v].v[e], b = qh.faces[v].v[(e+1)%3];
+            int32_t outside_face = qh.faces[v].neighbour[e];
+            uint32_t nf = add_quickhull_face(&qh, a, b, eye); //NB: may realloc faces
+            qh.faces[nf].neighbour[0] = outside_face;
+            for(int k=0; k<3; k++){
+                if(qh.faces[outside_face].v[k]==b && qh.faces[outside_face].v[(k+1)%3]==a) qh.faces[outside_face].neighbour[k] = nf;
+            }
+            new_faces[h] = nf;
+        }
+        //Side edges: (b,eye) of one new face pairs with (eye,a) of the new face starting at b
+        for(uint32_t i=0; i<num_horizon; i++){
+            QuickhullFace* fi = &qh.faces[new_faces[i]];
+            for(uint32_t j=0; j<num_horizon; j++){
+                QuickhullFace* fj = &qh.faces[new_faces[j]];
+                if(fj->v[0]==fi->v[1]){
+                    fi->neighbour[1] = new_faces[j];
+                    fj->neighbour[2] = new_faces[i];
+                    break;
+                }
+            }
+        }
+
+        //Hand outside points of dead faces to the new ones
+        for(uint32_t i=0; i<num_visible; i++){
+            QuickhullFace* dead = &qh.faces[visible[i]];
+            dead->alive = false;
+            int32_t p = dead->first_outside;
+            dead->first_outside = -1;
+            while(p>=0){
+                int32_t next = qh.next_outside[p];
+                if((uint32_t)p!=eye) assign_quickhull_point(&qh, p, new_faces, num_horizon);
+                p = next;
+            }
+        }
+    }
+    free(visible);
+    free(horizon);
+    free(new_faces);
+    free(stack);
+
+    //Compact: keep verts used by live faces
+    int32_t* remap = (int32_t*)malloc(vert_count*sizeof(int32_t));
+    for(uint32_t i=0; i<vert_count; i++) remap[i] = -1;
+    hull->num_verts = 0;
+    hull->num_faces = 0;
+    for(uint32_t f=0; f<qh.num_faces; f++){
+        if(!qh.faces[f].alive) continue;
+        hull->num_faces++;
+        for(int k=0; k<3; k++){
+            if(remap[qh.faces[f].v[k]]<0) remap[qh.faces[f].v[k]] = hull->num_verts++;
+        }
+    }
+    if(hull->num_verts>0xFFFF){
+        printf("Error: init_convex_hull made a hull with %u verts, max is 65535\n", hull->num_verts);
+        free(remap);
+        free(qh.points);
+        free(qh.next_outside);
+        free(qh.faces);
+        return false;
+    }
+    hull->verts = (vec3*)malloc(hull->num_verts*sizeof(vec3));
+    hull->indices = (uint16_t*)malloc(3*hull->num_faces*sizeof(uint16_t));
+    for(uint32_t i=0; i<vert_count; i++){
+        if(remap[i]>=0) hull->verts[remap[i]] = qh.points[i];
+    }
+    uint32_t index = 0;
+    for(uint32_t f=0; f<qh.num_faces; f++){
+        if(!qh.faces[f].alive) continue;
+        for(int k=0; k<3; k++) hull->indices[index++] = (uint16_t)remap[qh.faces[f].v[k]];
+    }
+    free(remap);
+    free(qh.points);
+    free(qh.next_outside);
+    free(qh.faces);
+
+    //Vertex adjacency: every edge shows up once in each direction, so each directed edge a->b gives a one neighbour
+    hull->neighbour_start = (uint32_t*)calloc(hull->num_verts+1, sizeof(uint32_t));
+    for(uint32_t i=0; i<3*hull->num_faces; i++) hull->neighbour_start[hull->indices[i]+1]++;
+    for(uint32_t i=0; i<hull->num_verts; i++) hull->neighbour_start[i+1] += hull->neighbour_start[i];
+    hull->neighbours = (uint32_t*)malloc(3*hull->num_faces*sizeof(uint32_t));
+    uint32_t* fill = (uint32_t*)malloc(hull->num_verts*sizeof(uint32_t));
+    memcpy(fill, hull->neighbour_start, hull->num_verts*sizeof(uint32_t));
+    for(uint32_t f=0; f<hull->num_faces; f++){
+        for(int k=0; k<3; k++){
+            uint32_t a = hull->indices[3*f+k], b = hull->indices[3*f+(k+1)%3];
+            hull->neighbours[fill[a]++] = b;
+        }
+    }
+    free(fill);
+    hull->last_support = 0;
+    return true;
+}
+
+void clear_convex_hull(ConvexHull* hull){
+    free(hull->verts);
+    free(hull->indices);
+    free(hull->neighbour_start);
+    free(hull->neighbours);
+    hull->verts = NULL;
+    hull->indices = NULL;
+    hull->neighbour_start = hull->neighbours = NULL;
+    hull->num_verts = hull->num_faces = hull->last_support = 0;
+}
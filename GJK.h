@@ -1,6 +1,8 @@
 #pragma once
 #include "GameMaths.h"
 #include "Collider.h"
+#include "CollisionStats.h"
+#include "Profiler.h"
 
 //Kevin's implementation of the Gilbert-Johnson-Keerthi intersection algorithm
 //and the Expanding Polytope Algorithm
@@ -36,8 +38,10 @@ vec3 EPA(vec3 a, vec3 b, vec3 c, vec3 d, Collider* coll1, Collider* coll2);
 #define GJK_MAX_NUM_ITERATIONS 64
 
 bool gjk(Collider* coll1, Collider* coll2, vec3* mtv){
+    PROFILE_FUNCTION();
+    COLLISION_STAT_INC(gjk_calls);
     vec3 a, b, c, d; //Simplex: just a set of points (a is always most recently added)
-    vec3 search_dir = coll1->pos - coll2->pos; //initial search direction between colliders
+    vec3 search_dir = coll1->xform.pos - coll2->xform.pos; //initial search direction between colliders
 
     //Get initial point for simplex
     c = coll2->support(search_dir) - coll1->support(-search_dir);
@@ -46,7 +50,10 @@ bool gjk(Collider* coll1, Collider* coll2, vec3* mtv){
     //Get second point for a line segment simplex
     b = coll2->support(search_dir) - coll1->support(-search_dir);
 
-    if(dot(b, search_dir)<0) { return false; }//we didn't reach the origin, won't enclose it
+    if(dot(b, search_dir)<0) { //we didn't reach the origin, won't enclose it
+        collision_stats_record_gjk(coll1, coll2, 0, false);
+        return false;
+    }
 
     search_dir = cross(cross(c-b,-b),c-b); //search perpendicular to line segment towards origin
     if(search_dir==vec3(0,0,0)){ //origin is on this line segment
@@ -58,18 +65,25 @@ bool gjk(Collider* coll1, Collider* coll2, vec3* mtv){
     
     for(int iterations=0; iterations<GJK_MAX_NUM_ITERATIONS; iterations++)
     {
+        COLLISION_STAT_INC(gjk_iterations);
         a = coll2->support(search_dir) - coll1->support(-search_dir);
-        if(dot(a, search_dir)<0) { return false; }//we didn't reach the origin, won't enclose it
+        if(dot(a, search_dir)<0) { //we didn't reach the origin, won't enclose it
+            collision_stats_record_gjk(coll1, coll2, iterations+1, false);
+            return false;
+        }
     
         simp_dim++;
         if(simp_dim==3){
             update_simplex3(a,b,c,d,simp_dim,search_dir);
         }
         else if(update_simplex4(a,b,c,d,simp_dim,search_dir)) {
+            collision_stats_record_gjk(coll1, coll2, iterations+1, false);
             if(mtv) *mtv = EPA(a,b,c,d,coll1,coll2);
             return true;
         }
     }//endfor
+    collision_stats_record_gjk(coll1, coll2, GJK_MAX_NUM_ITERATIONS, true);
+    log_collision_failure("GJK hit GJK_MAX_NUM_ITERATIONS", coll1, coll2);
     return false;
 }
 
@@ -176,6 +190,7 @@ bool update_simplex4(vec3 &a, vec3 &b, vec3 &c, vec3 &d, int &simp_dim, vec3 &se
 #define EPA_MAX_NUM_LOOSE_EDGES 32
 #define EPA_MAX_NUM_ITERATIONS 64
 vec3 EPA(vec3 a, vec3 b, vec3 c, vec3 d, Collider* coll1, Collider* coll2){
+    PROFILE_FUNCTION();
     vec3 faces[EPA_MAX_NUM_FACES][4]; //Array of faces, each with 3 verts and a normal
     
     //Init with final simplex from GJK
@@ -199,7 +214,9 @@ vec3 EPA(vec3 a, vec3 b, vec3 c, vec3 d, Collider* coll1, Collider* coll2){
     int num_faces=4;
     int closest_face;
 
+    COLLISION_STAT_INC(epa_runs);
     for(int iterations=0; iterations<EPA_MAX_NUM_ITERATIONS; iterations++){
+        COLLISION_STAT_INC(epa_iterations);
         //Find face that's closest to origin
         float min_dist = dot(faces[0][0], faces[0][3]);
         closest_face = 0;
@@ -217,6 +234,7 @@ vec3 EPA(vec3 a, vec3 b, vec3 c, vec3 d, Collider* coll1, Collider* coll2){
 
         if(dot(p, search_dir)-min_dist<EPA_TOLERANCE){
             //Convergence (new point is not significantly further from origin)
+            collision_stats_record_epa(coll1, coll2, iterations+1, false);
             return faces[closest_face][3]*dot(p, search_dir); //dot vertex with normal to resolve collision along normal!
         }
 
@@ -289,6 +307,9 @@ vec3 EPA(vec3 a, vec3 b, vec3 c, vec3 d, Collider* coll1, Collider* coll2){
             num_faces++;
         }
     } //End for iterations
+    COLLISION_STAT_INC(epa_failures);
+    collision_stats_record_epa(coll1, coll2, EPA_MAX_NUM_ITERATIONS, true);
+    log_collision_failure("EPA did not converge within EPA_MAX_NUM_ITERATIONS", coll1, coll2);
     printf("EPA did not converge\n");
     //Return most recent closest point
     return faces[closest_face][3] * dot(faces[closest_face][0], faces[closest_face][3]);
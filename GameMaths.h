@@ -3,7 +3,9 @@
 //Based off simple maths library included with online source for 'Anton's OpenGL Tutorials' book by Anton Gerdelan
 //License: https://github.com/capnramses/antons_opengl_tutorials_book/blob/master/LICENCE.md
 //Modified and added to by me over the years
-// TODO: Maybe SIMD if it'll help, never needed it so far
+//vec4, mat4 and versor are 16-byte aligned and use SSE (x86) or NEON (ARM) where it helps,
+//define GAMEMATHS_NO_SIMD to force the plain scalar code. vec3 stays a packed 12 bytes
+//since we alias it onto vertex arrays
 
 //Original header:
 /******************************************************************************\
@@ -24,6 +26,19 @@
 #define _USE_MATH_DEFINES
 #include <math.h>
 
+#if !defined(GAMEMATHS_NO_SIMD) && (defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP>=1))
+#define GAMEMATHS_SSE
+#include <xmmintrin.h>
+#elif !defined(GAMEMATHS_NO_SIMD) && ((defined(__ARM_NEON) && defined(__aarch64__)) || defined(_M_ARM64))
+#define GAMEMATHS_NEON
+#include <arm_neon.h>
+#endif
+
+#ifdef GAMEMATHS_SSE
+#define GM_SHUFFLE(a, b, x,y,z,w) _mm_shuffle_ps((a), (b), _MM_SHUFFLE(w,z,y,x)) //(a[x], a[y], b[z], b[w])
+#define GM_SWIZZLE(a, x,y,z,w) GM_SHUFFLE(a, a, x,y,z,w)
+#endif
+
 #define MIN(a,b) (((a)<(b)) ? a : b)
 #define MAX(a,b) (((a)>(b)) ? a : b)
 #define CLAMP(x,lo,hi) (MIN ((hi), MAX ((lo), (x))))
@@ -99,6 +114,18 @@ versor normalise(versor& q);
 float dot(const versor& q, const versor& r);
 versor slerp(versor& q, versor& r, float t);
 
+// affine transform functions
+struct Transform;
+Transform make_transform(const vec3& pos, const versor& rot, const vec3& scale);
+Transform identity_transform();
+vec3 transform_point(const Transform& t, const vec3& p);
+vec3 transform_dir(const Transform& t, const vec3& d);
+vec3 inverse_transform_point(const Transform& t, const vec3& p);
+vec3 inverse_transform_dir(const Transform& t, const vec3& d);
+Transform inverse(const Transform& t);
+Transform combine(const Transform& parent, const Transform& child);
+mat4 transform_to_mat4(const Transform& t);
+
 // print functions
 void print(const vec2& v);
 void print(const vec3& v);
@@ -332,7 +359,7 @@ union vec3 {
 	}
 };
 
-union vec4 {
+union alignas(16) vec4 {
 	struct{
 		float v[4];
 	};
@@ -377,7 +404,7 @@ struct mat3 {
 		m[3] = d; m[4] = e; m[5] = f;
 		m[6] = g; m[7] = h; m[8] = i;
 	}
-	mat3(mat4); //fwd dec,  can't define before mat4
+	mat3(const mat4&); //fwd dec,  can't define before mat4
 
 	vec3 operator* (const vec3& rhs) {
 		// 0x + 3y + 6z
@@ -399,7 +426,7 @@ struct mat3 {
 	}
 };
 
-struct mat4 {
+struct alignas(16) mat4 {
 	float m[16];
 	/* stored like this:
 		0  4  8 12
@@ -417,6 +444,24 @@ struct mat4 {
 		m[12] = mm; m[13] = n; m[14] = o; m[15] = p;
 	}
 	vec4 operator* (const vec4& rhs) {
+		#if defined(GAMEMATHS_SSE)
+		__m128 v = _mm_load_ps(rhs.v);
+		__m128 r = _mm_mul_ps(_mm_load_ps(&m[0]), GM_SWIZZLE(v, 0,0,0,0));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[4]), GM_SWIZZLE(v, 1,1,1,1)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[8]), GM_SWIZZLE(v, 2,2,2,2)));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_load_ps(&m[12]), GM_SWIZZLE(v, 3,3,3,3)));
+		vec4 result;
+		_mm_store_ps(result.v, r);
+		return result;
+		#elif defined(GAMEMATHS_NEON)
+		float32x4_t r = vmulq_n_f32(vld1q_f32(&m[0]), rhs.v[0]);
+		r = vmlaq_n_f32(r, vld1q_f32(&m[4]), rhs.v[1]);
+		r = vmlaq_n_f32(r, vld1q_f32(&m[8]), rhs.v[2]);
+		r = vmlaq_n_f32(r, vld1q_f32(&m[12]), rhs.v[3]);
+		vec4 result;
+		vst1q_f32(result.v, r);
+		return result;
+		#else
 		// 0x + 4y + 8z + 12w
 		float x =
 			m[0] * rhs.v[0] +
@@ -442,8 +487,40 @@ struct mat4 {
 			m[11] * rhs.v[2] +
 			m[15] * rhs.v[3];
 		return vec4 (x, y, z, w);
+		#endif
 	}
 	mat4 operator* (const mat4& rhs) {
+		#if defined(GAMEMATHS_SSE)
+		//Each column of result is a combination of our columns weighted by rhs' column
+		__m128 c0 = _mm_load_ps(&m[0]);
+		__m128 c1 = _mm_load_ps(&m[4]);
+		__m128 c2 = _mm_load_ps(&m[8]);
+		__m128 c3 = _mm_load_ps(&m[12]);
+		mat4 result;
+		for(int col = 0; col < 4; col++) {
+			__m128 v = _mm_load_ps(&rhs.m[col*4]);
+			__m128 r = _mm_mul_ps(c0, GM_SWIZZLE(v, 0,0,0,0));
+			r = _mm_add_ps(r, _mm_mul_ps(c1, GM_SWIZZLE(v, 1,1,1,1)));
+			r = _mm_add_ps(r, _mm_mul_ps(c2, GM_SWIZZLE(v, 2,2,2,2)));
+			r = _mm_add_ps(r, _mm_mul_ps(c3, GM_SWIZZLE(v, 3,3,3,3)));
+			_mm_store_ps(&result.m[col*4], r);
+		}
+		return result;
+		#elif defined(GAMEMATHS_NEON)
+		float32x4_t c0 = vld1q_f32(&m[0]);
+		float32x4_t c1 = vld1q_f32(&m[4]);
+		float32x4_t c2 = vld1q_f32(&m[8]);
+		float32x4_t c3 = vld1q_f32(&m[12]);
+		mat4 result;
+		for(int col = 0; col < 4; col++) {
+			float32x4_t r = vmulq_n_f32(c0, rhs.m[col*4]);
+			r = vmlaq_n_f32(r, c1, rhs.m[col*4+1]);
+			r = vmlaq_n_f32(r, c2, rhs.m[col*4+2]);
+			r = vmlaq_n_f32(r, c3, rhs.m[col*4+3]);
+			vst1q_f32(&result.m[col*4], r);
+		}
+		return result;
+		#else
 		mat4 r = zero_mat4 ();
 		int r_index = 0;
 		for(int col = 0; col < 4; col++) {
@@ -457,6 +534,7 @@ struct mat4 {
 			}
 		}
 		return r;
+		#endif
 	}
 	mat4& operator= (const mat4& rhs) {
 		for(int i = 0; i < 16; i++) {
@@ -466,7 +544,7 @@ struct mat4 {
 	}
 };
 
-struct versor {
+struct alignas(16) versor {
 	float q[4];
 
 	versor() {}
@@ -488,6 +566,14 @@ struct versor {
 	}
 	versor operator* (const versor& rhs) {
 		versor result;
+		#ifdef GAMEMATHS_SSE
+		__m128 a = _mm_load_ps(q);
+		__m128 r = _mm_mul_ps(a, _mm_set1_ps(rhs.q[0]));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(GM_SWIZZLE(a, 1,0,3,2), _mm_setr_ps(-1, 1, 1,-1)), _mm_set1_ps(rhs.q[1])));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(GM_SWIZZLE(a, 2,3,0,1), _mm_setr_ps(-1,-1, 1, 1)), _mm_set1_ps(rhs.q[2])));
+		r = _mm_add_ps(r, _mm_mul_ps(_mm_mul_ps(GM_SWIZZLE(a, 3,2,1,0), _mm_setr_ps(-1, 1,-1, 1)), _mm_set1_ps(rhs.q[3])));
+		_mm_store_ps(result.q, r);
+		#else
 		result.q[0] = rhs.q[0] * q[0] - rhs.q[1] * q[1] -
 			rhs.q[2] * q[2] - rhs.q[3] * q[3];
 		result.q[1] = rhs.q[0] * q[1] + rhs.q[1] * q[0] -
@@ -496,6 +582,7 @@ struct versor {
 			rhs.q[2] * q[0] - rhs.q[3] * q[1];
 		result.q[3] = rhs.q[0] * q[3] - rhs.q[1] * q[2] +
 			rhs.q[2] * q[1] + rhs.q[3] * q[0];
+		#endif
 		// re-normalise in case of mangling
 		return normalise(result);
 	}
@@ -644,7 +731,7 @@ inline mat4 identity_mat4() {
 	*/
 }
 
-inline mat3::mat3(mat4 RTS){
+inline mat3::mat3(const mat4& RTS){
 	//Grab R and S from RTS matrix
 	m[0] = RTS.m[0];
 	m[1] = RTS.m[1];
@@ -657,9 +744,82 @@ inline mat3::mat3(mat4 RTS){
 	m[8] = RTS.m[10];
 }
 
+#ifdef GAMEMATHS_SSE
+//Block-wise 4x4 inverse, treating the matrix as four 2x2 blocks
+//see "Fast 4x4 Matrix Inverse with SSE SIMD, Explained" by Eric Zhang
+//https://lxjk.github.io/2017/09/03/Fast-4x4-Matrix-Inverse-with-SSE-SIMD-Explained.html
+//(written for row-major but inverse(transpose(M)) == transpose(inverse(M)) so it works as is)
+//2x2 blocks are packed as (m00, m01, m10, m11)
+inline __m128 gm_mat2_mul(__m128 a, __m128 b) {
+	return _mm_add_ps(_mm_mul_ps(a, GM_SWIZZLE(b, 0,3,0,3)), _mm_mul_ps(GM_SWIZZLE(a, 1,0,3,2), GM_SWIZZLE(b, 2,1,2,1)));
+}
+//adjugate(a)*b
+inline __m128 gm_mat2_adj_mul(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(GM_SWIZZLE(a, 3,3,0,0), b), _mm_mul_ps(GM_SWIZZLE(a, 1,1,2,2), GM_SWIZZLE(b, 2,3,0,1)));
+}
+//a*adjugate(b)
+inline __m128 gm_mat2_mul_adj(__m128 a, __m128 b) {
+	return _mm_sub_ps(_mm_mul_ps(a, GM_SWIZZLE(b, 3,0,3,0)), _mm_mul_ps(GM_SWIZZLE(a, 1,0,3,2), GM_SWIZZLE(b, 2,1,2,1)));
+}
+
+//Returns determinant of mm, and writes inverse to result if result isn't NULL and det isn't zero
+inline float gm_inverse_sse(const mat4& mm, mat4* result) {
+	__m128 c0 = _mm_load_ps(&mm.m[0]);
+	__m128 c1 = _mm_load_ps(&mm.m[4]);
+	__m128 c2 = _mm_load_ps(&mm.m[8]);
+	__m128 c3 = _mm_load_ps(&mm.m[12]);
+	__m128 A = _mm_movelh_ps(c0, c1);
+	__m128 B = _mm_movehl_ps(c1, c0);
+	__m128 C = _mm_movelh_ps(c2, c3);
+	__m128 D = _mm_movehl_ps(c3, c2);
+
+	//(|A|, |B|, |C|, |D|)
+	__m128 det_sub = _mm_sub_ps(
+		_mm_mul_ps(GM_SHUFFLE(c0, c2, 0,2,0,2), GM_SHUFFLE(c1, c3, 1,3,1,3)),
+		_mm_mul_ps(GM_SHUFFLE(c0, c2, 1,3,1,3), GM_SHUFFLE(c1, c3, 0,2,0,2))
+	);
+	__m128 det_A = GM_SWIZZLE(det_sub, 0,0,0,0);
+	__m128 det_B = GM_SWIZZLE(det_sub, 1,1,1,1);
+	__m128 det_C = GM_SWIZZLE(det_sub, 2,2,2,2);
+	__m128 det_D = GM_SWIZZLE(det_sub, 3,3,3,3);
+
+	__m128 D_C = gm_mat2_adj_mul(D, C);
+	__m128 A_B = gm_mat2_adj_mul(A, B);
+
+	//|M| = |A||D| + |B||C| - tr((A#B)(D#C))
+	__m128 tr = _mm_mul_ps(A_B, GM_SWIZZLE(D_C, 0,2,1,3));
+	tr = _mm_add_ps(tr, GM_SWIZZLE(tr, 2,3,0,1));
+	tr = _mm_add_ps(tr, GM_SWIZZLE(tr, 1,0,3,2));
+	__m128 det_M = _mm_sub_ps(_mm_add_ps(_mm_mul_ps(det_A, det_D), _mm_mul_ps(det_B, det_C)), tr);
+	float det = _mm_cvtss_f32(det_M);
+	if(!result || det == 0.0f) return det;
+
+	__m128 X_ = _mm_sub_ps(_mm_mul_ps(det_D, A), gm_mat2_mul(B, D_C));
+	__m128 W_ = _mm_sub_ps(_mm_mul_ps(det_A, D), gm_mat2_mul(C, A_B));
+	__m128 Y_ = _mm_sub_ps(_mm_mul_ps(det_B, C), gm_mat2_mul_adj(D, A_B));
+	__m128 Z_ = _mm_sub_ps(_mm_mul_ps(det_C, B), gm_mat2_mul_adj(A, D_C));
+
+	__m128 inv_det = _mm_div_ps(_mm_setr_ps(1.0f, -1.0f, -1.0f, 1.0f), det_M);
+	X_ = _mm_mul_ps(X_, inv_det);
+	Y_ = _mm_mul_ps(Y_, inv_det);
+	Z_ = _mm_mul_ps(Z_, inv_det);
+	W_ = _mm_mul_ps(W_, inv_det);
+
+	//Apply adjugate while storing
+	_mm_store_ps(&result->m[0], GM_SHUFFLE(X_, Y_, 3,1,3,1));
+	_mm_store_ps(&result->m[4], GM_SHUFFLE(X_, Y_, 2,0,2,0));
+	_mm_store_ps(&result->m[8], GM_SHUFFLE(Z_, W_, 3,1,3,1));
+	_mm_store_ps(&result->m[12], GM_SHUFFLE(Z_, W_, 2,0,2,0));
+	return det;
+}
+#endif
+
 // returns a scalar value with the determinant for a 4x4 matrix
 // see http://www.euclideanspace.com/maths/algebra/matrix/functions/determinant/fourD/index.htm
 inline float determinant(const mat4& mm) {
+	#ifdef GAMEMATHS_SSE
+	return gm_inverse_sse(mm, NULL);
+	#else
 	return
 		mm.m[12] * mm.m[9] * mm.m[6] * mm.m[3] -
 		mm.m[8] * mm.m[13] * mm.m[6] * mm.m[3] -
@@ -685,11 +845,20 @@ inline float determinant(const mat4& mm) {
 		mm.m[0] * mm.m[9] * mm.m[6] * mm.m[15] -
 		mm.m[4] * mm.m[1] * mm.m[10] * mm.m[15] +
 		mm.m[0] * mm.m[5] * mm.m[10] * mm.m[15];
+	#endif
 }
 
 /* returns a 16-element array that is the inverse of a 16-element array (4x4
 matrix). see http://www.euclideanspace.com/maths/algebra/matrix/functions/inverse/fourD/index.htm */
 inline mat4 inverse(const mat4& mm) {
+	#ifdef GAMEMATHS_SSE
+	mat4 result;
+	if(0.0f == gm_inverse_sse(mm, &result)) {
+		fprintf(stderr, "WARNING. matrix has no determinant. can not invert\n");
+		return mm;
+	}
+	return result;
+	#else
 	float det = determinant(mm);
 	/* there is no inverse if determinant is zero (not likely unless scale is
 	broken) */
@@ -781,16 +950,31 @@ inline mat4 inverse(const mat4& mm) {
 			mm.m[4] * mm.m[1] * mm.m[10] + mm.m[0] * mm.m[5] * mm.m[10]
 		)
 	);
+	#endif
 }
 
 // returns a 16-element array flipped on the main diagonal
 inline mat4 transpose(const mat4& mm) {
+	#ifdef GAMEMATHS_SSE
+	__m128 c0 = _mm_load_ps(&mm.m[0]);
+	__m128 c1 = _mm_load_ps(&mm.m[4]);
+	__m128 c2 = _mm_load_ps(&mm.m[8]);
+	__m128 c3 = _mm_load_ps(&mm.m[12]);
+	_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+	mat4 result;
+	_mm_store_ps(&result.m[0], c0);
+	_mm_store_ps(&result.m[4], c1);
+	_mm_store_ps(&result.m[8], c2);
+	_mm_store_ps(&result.m[12], c3);
+	return result;
+	#else
 	return mat4(
 		mm.m[0], mm.m[4], mm.m[8], mm.m[12],
 		mm.m[1], mm.m[5], mm.m[9], mm.m[13],
 		mm.m[2], mm.m[6], mm.m[10], mm.m[14],
 		mm.m[3], mm.m[7], mm.m[11], mm.m[15]
 	);
+	#endif
 }
 
 /*--------------------------AFFINE MATRIX FUNCTIONS---------------------------*/
@@ -1054,6 +1238,38 @@ inline float dot(const versor& q, const versor& r) {
 	return q.q[0] * r.q[0] + q.q[1] * r.q[1] + q.q[2] * r.q[2] + q.q[3] * r.q[3];
 }
 
+inline versor identity_quat() {
+	versor q;
+	q.q[0] = 1.0f;
+	q.q[1] = 0.0f;
+	q.q[2] = 0.0f;
+	q.q[3] = 0.0f;
+	return q;
+}
+
+//Inverse rotation (for unit quaternions)
+inline versor conjugate(const versor& q) {
+	versor r;
+	r.q[0] = q.q[0];
+	r.q[1] = -q.q[1];
+	r.q[2] = -q.q[2];
+	r.q[3] = -q.q[3];
+	return r;
+}
+
+//Rotate v by unit quaternion q without building a matrix
+//v' = v + w*t + cross(u, t) where t = 2*cross(u, v)
+inline vec3 rotate(const versor& q, const vec3& v) {
+	vec3 u(q.q[1], q.q[2], q.q[3]);
+	vec3 t = cross(u, v) * 2.0f;
+	vec3 r = cross(u, t);
+	return vec3(
+		v.v[0] + q.q[0] * t.v[0] + r.v[0],
+		v.v[1] + q.q[0] * t.v[1] + r.v[1],
+		v.v[2] + q.q[0] * t.v[2] + r.v[2]
+	);
+}
+
 inline versor slerp(versor& q, versor& r, float t) {
 	// angle between q0-q1
 	float cos_half_theta = dot(q, r);
@@ -1091,6 +1307,79 @@ inline versor slerp(versor& q, versor& r, float t) {
 	return result;
 }
 
+/*-------------------------------AFFINE TRANSFORM-----------------------------*/
+//Compact replacement for a model matrix: scale, then rotate, then translate (same as T*R*S)
+//Cheap to invert exactly for points/directions (no cofactor expansion), see inverse_transform_point()
+struct Transform {
+	versor rot;
+	vec3 scale;
+	vec3 pos;
+};
+
+inline Transform make_transform(const vec3& pos, const versor& rot, const vec3& scale) {
+	Transform t;
+	t.rot = rot;
+	t.scale = scale;
+	t.pos = pos;
+	return t;
+}
+
+inline Transform identity_transform() {
+	return make_transform(vec3(0,0,0), identity_quat(), vec3(1,1,1));
+}
+
+inline vec3 transform_dir(const Transform& t, const vec3& d) {
+	return rotate(t.rot, vec3(d.v[0] * t.scale.v[0], d.v[1] * t.scale.v[1], d.v[2] * t.scale.v[2]));
+}
+
+inline vec3 transform_point(const Transform& t, const vec3& p) {
+	vec3 r = transform_dir(t, p);
+	return vec3(r.v[0] + t.pos.v[0], r.v[1] + t.pos.v[1], r.v[2] + t.pos.v[2]);
+}
+
+//S^-1 * R^-1 * d, exact for any scale
+inline vec3 inverse_transform_dir(const Transform& t, const vec3& d) {
+	vec3 r = rotate(conjugate(t.rot), d);
+	return vec3(r.v[0] / t.scale.v[0], r.v[1] / t.scale.v[1], r.v[2] / t.scale.v[2]);
+}
+
+inline vec3 inverse_transform_point(const Transform& t, const vec3& p) {
+	return inverse_transform_dir(t, vec3(p.v[0] - t.pos.v[0], p.v[1] - t.pos.v[1], p.v[2] - t.pos.v[2]));
+}
+
+//NB: S^-1*R^-1 can only be written as R'*S' when scale is uniform,
+//use inverse_transform_point/dir for non-uniform scale
+inline Transform inverse(const Transform& t) {
+	Transform r;
+	r.rot = conjugate(t.rot);
+	r.scale = vec3(1.0f / t.scale.v[0], 1.0f / t.scale.v[1], 1.0f / t.scale.v[2]);
+	vec3 p = rotate(r.rot, t.pos);
+	r.pos = vec3(-p.v[0] * r.scale.v[0], -p.v[1] * r.scale.v[1], -p.v[2] * r.scale.v[2]);
+	return r;
+}
+
+//Returns transform that applies child then parent
+//NB: Exact when parent's scale is uniform (or child has no rotation), same limitation as inverse()
+inline Transform combine(const Transform& parent, const Transform& child) {
+	Transform r;
+	versor parent_rot = parent.rot;
+	r.rot = parent_rot * child.rot;
+	r.scale = vec3(parent.scale.v[0] * child.scale.v[0], parent.scale.v[1] * child.scale.v[1], parent.scale.v[2] * child.scale.v[2]);
+	r.pos = transform_point(parent, child.pos);
+	return r;
+}
+
+inline mat4 transform_to_mat4(const Transform& t) {
+	mat4 m = quat_to_mat4(t.rot);
+	for(int col = 0; col < 3; col++) {
+		for(int row = 0; row < 3; row++) m.m[col*4 + row] *= t.scale.v[col];
+	}
+	m.m[12] = t.pos.v[0];
+	m.m[13] = t.pos.v[1];
+	m.m[14] = t.pos.v[2];
+	return m;
+}
+
 /*-----------------------------PRINT FUNCTIONS--------------------------------*/
 inline void print(const vec2& v) {
 	printf("[%.2f, %.2f]\n", v.v[0], v.v[1]);
@@ -1123,6 +1412,549 @@ inline void print(const versor& q) {
 	printf("[%.2f ,%.2f, %.2f, %.2f]\n", q.q[0], q.q[1], q.q[2], q.q[3]);
 }
 
+/*-----------------------------WIDE (SoA) TYPES-------------------------------*/
+//floatx4/floatx8 hold 4/8 floats processed lane-wise, maskx4/maskx8 are the results of comparing them
+//vec3x4/vec3x8 hold 4/8 vec3s as separate x, y and z lanes so batch kernels (broadphase, triangle tests,
+//support functions, agent integration) can be written once with the same operators as vec3
+//floatx8 uses AVX when compiled with it, otherwise it's just two floatx4s
+//Lane-wise helpers are prefixed with lane_ (<windows.h> defines min and max, POSIX has select)
+
+#if defined(GAMEMATHS_SSE) && defined(__AVX__)
+#define GAMEMATHS_AVX
+#include <immintrin.h>
+#endif
+
+struct alignas(16) floatx4 {
+	#if defined(GAMEMATHS_SSE)
+	__m128 v;
+	#elif defined(GAMEMATHS_NEON)
+	float32x4_t v;
+	#else
+	float v[4];
+	#endif
+};
+
+struct alignas(16) maskx4 {
+	#if defined(GAMEMATHS_SSE)
+	__m128 v;
+	#elif defined(GAMEMATHS_NEON)
+	uint32x4_t v;
+	#else
+	bool v[4];
+	#endif
+};
+
+inline floatx4 floatx4_set1(float f) {
+	floatx4 r;
+	#if defined(GAMEMATHS_SSE)
+	r.v = _mm_set1_ps(f);
+	#elif defined(GAMEMATHS_NEON)
+	r.v = vdupq_n_f32(f);
+	#else
+	for(int i = 0; i < 4; i++) r.v[i] = f;
+	#endif
+	return r;
+}
+//Load/store 4 floats (no alignment needed)
+inline floatx4 floatx4_load(const float* f) {
+	floatx4 r;
+	#if defined(GAMEMATHS_SSE)
+	r.v = _mm_loadu_ps(f);
+	#elif defined(GAMEMATHS_NEON)
+	r.v = vld1q_f32(f);
+	#else
+	for(int i = 0; i < 4; i++) r.v[i] = f[i];
+	#endif
+	return r;
+}
+inline void floatx4_store(float* f, floatx4 a) {
+	#if defined(GAMEMATHS_SSE)
+	_mm_storeu_ps(f, a.v);
+	#elif defined(GAMEMATHS_NEON)
+	vst1q_f32(f, a.v);
+	#else
+	for(int i = 0; i < 4; i++) f[i] = a.v[i];
+	#endif
+}
+
+#if defined(GAMEMATHS_SSE)
+#define GM_FLOATX4_OP(name, sse, neon, op) inline floatx4 name(floatx4 a, floatx4 b) { floatx4 r; r.v = sse(a.v, b.v); return r; }
+#define GM_FLOATX4_CMP(name, sse, neon, op) inline maskx4 name(floatx4 a, floatx4 b) { maskx4 r; r.v = sse(a.v, b.v); return r; }
+#elif defined(GAMEMATHS_NEON)
+#define GM_FLOATX4_OP(name, sse, neon, op) inline floatx4 name(floatx4 a, floatx4 b) { floatx4 r; r.v = neon(a.v, b.v); return r; }
+#define GM_FLOATX4_CMP(name, sse, neon, op) inline maskx4 name(floatx4 a, floatx4 b) { maskx4 r; r.v = neon(a.v, b.v); return r; }
+#else
+#define GM_FLOATX4_OP(name, sse, neon, op) inline floatx4 name(floatx4 a, floatx4 b) { floatx4 r; for(int i = 0; i < 4; i++) r.v[i] = op(a.v[i], b.v[i]); return r; }
+#define GM_FLOATX4_CMP(name, sse, neon, op) inline maskx4 name(floatx4 a, floatx4 b) { maskx4 r; for(int i = 0; i < 4; i++) r.v[i] = op(a.v[i], b.v[i]); return r; }
+#endif
+#define GM_ADD(a,b) ((a)+(b))
+#define GM_SUB(a,b) ((a)-(b))
+#define GM_MUL(a,b) ((a)*(b))
+#define GM_DIV(a,b) ((a)/(b))
+#define GM_LT(a,b) ((a)<(b))
+#define GM_GT(a,b) ((a)>(b))
+#define GM_LE(a,b) ((a)<=(b))
+#define GM_GE(a,b) ((a)>=(b))
+
+GM_FLOATX4_OP(operator+, _mm_add_ps, vaddq_f32, GM_ADD)
+GM_FLOATX4_OP(operator-, _mm_sub_ps, vsubq_f32, GM_SUB)
+GM_FLOATX4_OP(operator*, _mm_mul_ps, vmulq_f32, GM_MUL)
+GM_FLOATX4_OP(operator/, _mm_div_ps, vdivq_f32, GM_DIV)
+GM_FLOATX4_OP(lane_min, _mm_min_ps, vminq_f32, MIN)
+GM_FLOATX4_OP(lane_max, _mm_max_ps, vmaxq_f32, MAX)
+GM_FLOATX4_CMP(operator<, _mm_cmplt_ps, vcltq_f32, GM_LT)
+GM_FLOATX4_CMP(operator>, _mm_cmpgt_ps, vcgtq_f32, GM_GT)
+GM_FLOATX4_CMP(operator<=, _mm_cmple_ps, vcleq_f32, GM_LE)
+GM_FLOATX4_CMP(operator>=, _mm_cmpge_ps, vcgeq_f32, GM_GE)
+
+inline floatx4 operator-(floatx4 a) { return floatx4_set1(0.0f) - a; }
+inline floatx4 operator*(floatx4 a, float b) { return a * floatx4_set1(b); }
+inline floatx4 operator/(floatx4 a, float b) { return a / floatx4_set1(b); }
+inline floatx4& operator+=(floatx4& a, floatx4 b) { a = a + b; return a; }
+inline floatx4& operator-=(floatx4& a, floatx4 b) { a = a - b; return a; }
+inline floatx4& operator*=(floatx4& a, floatx4 b) { a = a * b; return a; }
+
+inline floatx4 lane_sqrt(floatx4 a) {
+	floatx4 r;
+	#if defined(GAMEMATHS_SSE)
+	r.v = _mm_sqrt_ps(a.v);
+	#elif defined(GAMEMATHS_NEON)
+	r.v = vsqrtq_f32(a.v);
+	#else
+	for(int i = 0; i < 4; i++) r.v[i] = sqrtf(a.v[i]);
+	#endif
+	return r;
+}
+
+inline maskx4 operator&(maskx4 a, maskx4 b) {
+	maskx4 r;
+	#if defined(GAMEMATHS_SSE)
+	r.v = _mm_and_ps(a.v, b.v);
+	#elif defined(GAMEMATHS_NEON)
+	r.v = vandq_u32(a.v, b.v);
+	#else
+	for(int i = 0; i < 4; i++) r.v[i] = a.v[i] && b.v[i];
+	#endif
+	return r;
+}
+inline maskx4 operator|(maskx4 a, maskx4 b) {
+	maskx4 r;
+	#if defined(GAMEMATHS_SSE)
+	r.v = _mm_or_ps(a.v, b.v);
+	#elif defined(GAMEMATHS_NEON)
+	r.v = vorrq_u32(a.v, b.v);
+	#else
+	for(int i = 0; i < 4; i++) r.v[i] = a.v[i] || b.v[i];
+	#endif
+	return r;
+}
+//Returns bit i set if lane i of mask is set
+inline int lane_mask_bits(maskx4 m) {
+	#if defined(GAMEMATHS_SSE)
+	return _mm_movemask_ps(m.v);
+	#elif defined(GAMEMATHS_NEON)
+	uint32_t bits[4];
+	vst1q_u32(bits, m.v);
+	return (bits[0]&1) | (bits[1]&2) | (bits[2]&4) | (bits[3]&8);
+	#else
+	return (int)m.v[0] | (int)m.v[1]<<1 | (int)m.v[2]<<2 | (int)m.v[3]<<3;
+	#endif
+}
+inline bool lane_any(maskx4 m) { return lane_mask_bits(m) != 0; }
+inline bool lane_all(maskx4 m) { return lane_mask_bits(m) == 0xF; }
+
+//Lane-wise (m ? a : b)
+inline floatx4 lane_select(maskx4 m, floatx4 a, floatx4 b) {
+	floatx4 r;
+	#if defined(GAMEMATHS_SSE)
+	r.v = _mm_or_ps(_mm_and_ps(m.v, a.v), _mm_andnot_ps(m.v, b.v));
+	#elif defined(GAMEMATHS_NEON)
+	r.v = vbslq_f32(m.v, a.v, b.v);
+	#else
+	for(int i = 0; i < 4; i++) r.v[i] = m.v[i] ? a.v[i] : b.v[i];
+	#endif
+	return r;
+}
+
+#if defined(GAMEMATHS_AVX)
+struct alignas(32) floatx8 {
+	__m256 v;
+};
+struct alignas(32) maskx8 {
+	__m256 v;
+};
+
+inline floatx8 floatx8_set1(float f) { floatx8 r; r.v = _mm256_set1_ps(f); return r; }
+inline floatx8 floatx8_load(const float* f) { floatx8 r; r.v = _mm256_loadu_ps(f); return r; }
+inline void floatx8_store(float* f, floatx8 a) { _mm256_storeu_ps(f, a.v); }
+
+#define GM_FLOATX8_OP(name, avx) inline floatx8 name(floatx8 a, floatx8 b) { floatx8 r; r.v = avx(a.v, b.v); return r; }
+#define GM_FLOATX8_CMP(name, cmp) inline maskx8 name(floatx8 a, floatx8 b) { maskx8 r; r.v = _mm256_cmp_ps(a.v, b.v, cmp); return r; }
+GM_FLOATX8_OP(operator+, _mm256_add_ps)
+GM_FLOATX8_OP(operator-, _mm256_sub_ps)
+GM_FLOATX8_OP(operator*, _mm256_mul_ps)
+GM_FLOATX8_OP(operator/, _mm256_div_ps)
+GM_FLOATX8_OP(lane_min, _mm256_min_ps)
+GM_FLOATX8_OP(lane_max, _mm256_max_ps)
+GM_FLOATX8_CMP(operator<, _CMP_LT_OQ)
+GM_FLOATX8_CMP(operator>, _CMP_GT_OQ)
+GM_FLOATX8_CMP(operator<=, _CMP_LE_OQ)
+GM_FLOATX8_CMP(operator>=, _CMP_GE_OQ)
+
+inline floatx8 lane_sqrt(floatx8 a) { floatx8 r; r.v = _mm256_sqrt_ps(a.v); return r; }
+inline maskx8 operator&(maskx8 a, maskx8 b) { maskx8 r; r.v = _mm256_and_ps(a.v, b.v); return r; }
+inline maskx8 operator|(maskx8 a, maskx8 b) { maskx8 r; r.v = _mm256_or_ps(a.v, b.v); return r; }
+inline int lane_mask_bits(maskx8 m) { return _mm256_movemask_ps(m.v); }
+inline floatx8 lane_select(maskx8 m, floatx8 a, floatx8 b) { floatx8 r; r.v = _mm256_blendv_ps(b.v, a.v, m.v); return r; }
+
+#else
+//Two floatx4s
+struct floatx8 {
+	floatx4 lo, hi;
+};
+struct maskx8 {
+	maskx4 lo, hi;
+};
+
+inline floatx8 floatx8_set1(float f) { floatx8 r; r.lo = r.hi = floatx4_set1(f); return r; }
+inline floatx8 floatx8_load(const float* f) { floatx8 r; r.lo = floatx4_load(f); r.hi = floatx4_load(f+4); return r; }
+inline void floatx8_store(float* f, floatx8 a) { floatx4_store(f, a.lo); floatx4_store(f+4, a.hi); }
+
+#define GM_FLOATX8_OP(name) inline floatx8 name(floatx8 a, floatx8 b) { floatx8 r; r.lo = name(a.lo, b.lo); r.hi = name(a.hi, b.hi); return r; }
+#define GM_FLOATX8_CMP(name) inline maskx8 name(floatx8 a, floatx8 b) { maskx8 r; r.lo = name(a.lo, b.lo); r.hi = name(a.hi, b.hi); return r; }
+GM_FLOATX8_OP(operator+)
+GM_FLOATX8_OP(operator-)
+GM_FLOATX8_OP(operator*)
+GM_FLOATX8_OP(operator/)
+GM_FLOATX8_OP(lane_min)
+GM_FLOATX8_OP(lane_max)
+GM_FLOATX8_CMP(operator<)
+GM_FLOATX8_CMP(operator>)
+GM_FLOATX8_CMP(operator<=)
+GM_FLOATX8_CMP(operator>=)
+
+inline floatx8 lane_sqrt(floatx8 a) { floatx8 r; r.lo = lane_sqrt(a.lo); r.hi = lane_sqrt(a.hi); return r; }
+inline maskx8 operator&(maskx8 a, maskx8 b) { maskx8 r; r.lo = a.lo & b.lo; r.hi = a.hi & b.hi; return r; }
+inline maskx8 operator|(maskx8 a, maskx8 b) { maskx8 r; r.lo = a.lo | b.lo; r.hi = a.hi | b.hi; return r; }
+inline int lane_mask_bits(maskx8 m) { return lane_mask_bits(m.lo) | lane_mask_bits(m.hi)<<4; }
+inline floatx8 lane_select(maskx8 m, floatx8 a, floatx8 b) { floatx8 r; r.lo = lane_select(m.lo, a.lo, b.lo); r.hi = lane_select(m.hi, a.hi, b.hi); return r; }
+#endif
+
+inline bool lane_any(maskx8 m) { return lane_mask_bits(m) != 0; }
+inline bool lane_all(maskx8 m) { return lane_mask_bits(m) == 0xFF; }
+inline floatx8 operator-(floatx8 a) { return floatx8_set1(0.0f) - a; }
+inline floatx8 operator*(floatx8 a, float b) { return a * floatx8_set1(b); }
+inline floatx8 operator/(floatx8 a, float b) { return a / floatx8_set1(b); }
+inline floatx8& operator+=(floatx8& a, floatx8 b) { a = a + b; return a; }
+inline floatx8& operator-=(floatx8& a, floatx8 b) { a = a - b; return a; }
+inline floatx8& operator*=(floatx8& a, floatx8 b) { a = a * b; return a; }
+
+//4 vec3s in SoA form
+struct vec3x4 {
+	floatx4 x, y, z;
+
+	vec3x4() {}
+	vec3x4(floatx4 xx, floatx4 yy, floatx4 zz) {
+		x = xx;
+		y = yy;
+		z = zz;
+	}
+	//Broadcast v to every lane
+	vec3x4(const vec3& v) {
+		x = floatx4_set1(v.v[0]);
+		y = floatx4_set1(v.v[1]);
+		z = floatx4_set1(v.v[2]);
+	}
+	//Load 4 consecutive (AoS) vec3s
+	vec3x4(const vec3* v) {
+		#if defined(GAMEMATHS_SSE)
+		//Transpose (x0 y0 z0 x1)(y1 z1 x2 y2)(z2 x3 y3 z3) into xs, ys and zs
+		__m128 a = _mm_loadu_ps(&v[0].v[0]);
+		__m128 b = _mm_loadu_ps(&v[1].v[1]);
+		__m128 c = _mm_loadu_ps(&v[2].v[2]);
+		x.v = GM_SHUFFLE(a, GM_SHUFFLE(b, c, 2,2,1,1), 0,3,0,2);
+		y.v = GM_SHUFFLE(GM_SHUFFLE(a, b, 1,1,0,0), GM_SHUFFLE(b, c, 3,3,2,2), 0,2,0,2);
+		z.v = GM_SHUFFLE(GM_SHUFFLE(a, b, 2,2,1,1), GM_SHUFFLE(c, c, 0,0,3,3), 0,2,0,2);
+		#else
+		float xs[4], ys[4], zs[4];
+		for(int i = 0; i < 4; i++) {
+			xs[i] = v[i].v[0];
+			ys[i] = v[i].v[1];
+			zs[i] = v[i].v[2];
+		}
+		x = floatx4_load(xs);
+		y = floatx4_load(ys);
+		z = floatx4_load(zs);
+		#endif
+	}
+	//Store lanes back out as 4 consecutive vec3s
+	void store(vec3* v) {
+		float xs[4], ys[4], zs[4];
+		floatx4_store(xs, x);
+		floatx4_store(ys, y);
+		floatx4_store(zs, z);
+		for(int i = 0; i < 4; i++) v[i] = vec3(xs[i], ys[i], zs[i]);
+	}
+	vec3 get(int lane) {
+		vec3 v[4];
+		store(v);
+		return v[lane];
+	}
+
+	vec3x4 operator+ (const vec3x4& rhs) { return vec3x4(x + rhs.x, y + rhs.y, z + rhs.z); }
+	vec3x4 operator- (const vec3x4& rhs) { return vec3x4(x - rhs.x, y - rhs.y, z - rhs.z); }
+	vec3x4& operator+= (const vec3x4& rhs) { x += rhs.x; y += rhs.y; z += rhs.z; return *this; }
+	vec3x4& operator-= (const vec3x4& rhs) { x -= rhs.x; y -= rhs.y; z -= rhs.z; return *this; }
+	vec3x4 operator* (floatx4 rhs) { return vec3x4(x * rhs, y * rhs, z * rhs); }
+	vec3x4 operator/ (floatx4 rhs) { return vec3x4(x / rhs, y / rhs, z / rhs); }
+	vec3x4 operator* (float rhs) { return *this * floatx4_set1(rhs); }
+	vec3x4 operator/ (float rhs) { return *this / floatx4_set1(rhs); }
+	vec3x4& operator*= (float rhs) { *this = *this * rhs; return *this; }
+	//Negate
+	vec3x4 operator- () { return vec3x4(-x, -y, -z); }
+};
+
+inline floatx4 dot(const vec3x4& a, const vec3x4& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline vec3x4 cross(const vec3x4& a, const vec3x4& b) {
+	return vec3x4(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline floatx4 length2(const vec3x4& v) {
+	return dot(v, v);
+}
+inline floatx4 length(const vec3x4& v) {
+	return lane_sqrt(dot(v, v));
+}
+//Zero-length lanes stay zero, same as normalise(vec3)
+inline vec3x4 normalise(const vec3x4& v) {
+	floatx4 l = length(v);
+	floatx4 zero = floatx4_set1(0.0f);
+	floatx4 inv_l = lane_select(l > zero, floatx4_set1(1.0f) / l, zero);
+	return vec3x4(v.x * inv_l, v.y * inv_l, v.z * inv_l);
+}
+inline vec3x4 lane_min(const vec3x4& a, const vec3x4& b) {
+	return vec3x4(lane_min(a.x, b.x), lane_min(a.y, b.y), lane_min(a.z, b.z));
+}
+inline vec3x4 lane_max(const vec3x4& a, const vec3x4& b) {
+	return vec3x4(lane_max(a.x, b.x), lane_max(a.y, b.y), lane_max(a.z, b.z));
+}
+//Lane-wise (m ? a : b)
+inline vec3x4 lane_select(maskx4 m, const vec3x4& a, const vec3x4& b) {
+	return vec3x4(lane_select(m, a.x, b.x), lane_select(m, a.y, b.y), lane_select(m, a.z, b.z));
+}
+
+//8 vec3s in SoA form
+struct vec3x8 {
+	floatx8 x, y, z;
+
+	vec3x8() {}
+	vec3x8(floatx8 xx, floatx8 yy, floatx8 zz) {
+		x = xx;
+		y = yy;
+		z = zz;
+	}
+	//Broadcast v to every lane
+	vec3x8(const vec3& v) {
+		x = floatx8_set1(v.v[0]);
+		y = floatx8_set1(v.v[1]);
+		z = floatx8_set1(v.v[2]);
+	}
+	//Load 8 consecutive (AoS) vec3s
+	vec3x8(const vec3* v) {
+		float xs[8], ys[8], zs[8];
+		for(int i = 0; i < 8; i++) {
+			xs[i] = v[i].v[0];
+			ys[i] = v[i].v[1];
+			zs[i] = v[i].v[2];
+		}
+		x = floatx8_load(xs);
+		y = floatx8_load(ys);
+		z = floatx8_load(zs);
+	}
+	//Store lanes back out as 8 consecutive vec3s
+	void store(vec3* v) {
+		float xs[8], ys[8], zs[8];
+		floatx8_store(xs, x);
+		floatx8_store(ys, y);
+		floatx8_store(zs, z);
+		for(int i = 0; i < 8; i++) v[i] = vec3(xs[i], ys[i], zs[i]);
+	}
+	vec3 get(int lane) {
+		vec3 v[8];
+		store(v);
+		return v[lane];
+	}
+
+	vec3x8 operator+ (const vec3x8& rhs) { return vec3x8(x + rhs.x, y + rhs.y, z + rhs.z); }
+	vec3x8 operator- (const vec3x8& rhs) { return vec3x8(x - rhs.x, y - rhs.y, z - rhs.z); }
+	vec3x8& operator+= (const vec3x8& rhs) { x += rhs.x; y += rhs.y; z += rhs.z; return *this; }
+	vec3x8& operator-= (const vec3x8& rhs) { x -= rhs.x; y -= rhs.y; z -= rhs.z; return *this; }
+	vec3x8 operator* (floatx8 rhs) { return vec3x8(x * rhs, y * rhs, z * rhs); }
+	vec3x8 operator/ (floatx8 rhs) { return vec3x8(x / rhs, y / rhs, z / rhs); }
+	vec3x8 operator* (float rhs) { return *this * floatx8_set1(rhs); }
+	vec3x8 operator/ (float rhs) { return *this / floatx8_set1(rhs); }
+	vec3x8& operator*= (float rhs) { *this = *this * rhs; return *this; }
+	//Negate
+	vec3x8 operator- () { return vec3x8(-x, -y, -z); }
+};
+
+inline floatx8 dot(const vec3x8& a, const vec3x8& b) {
+	return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+inline vec3x8 cross(const vec3x8& a, const vec3x8& b) {
+	return vec3x8(a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x);
+}
+inline floatx8 length2(const vec3x8& v) {
+	return dot(v, v);
+}
+inline floatx8 length(const vec3x8& v) {
+	return lane_sqrt(dot(v, v));
+}
+//Zero-length lanes stay zero, same as normalise(vec3)
+inline vec3x8 normalise(const vec3x8& v) {
+	floatx8 l = length(v);
+	floatx8 zero = floatx8_set1(0.0f);
+	floatx8 inv_l = lane_select(l > zero, floatx8_set1(1.0f) / l, zero);
+	return vec3x8(v.x * inv_l, v.y * inv_l, v.z * inv_l);
+}
+inline vec3x8 lane_min(const vec3x8& a, const vec3x8& b) {
+	return vec3x8(lane_min(a.x, b.x), lane_min(a.y, b.y), lane_min(a.z, b.z));
+}
+inline vec3x8 lane_max(const vec3x8& a, const vec3x8& b) {
+	return vec3x8(lane_max(a.x, b.x), lane_max(a.y, b.y), lane_max(a.z, b.z));
+}
+//Lane-wise (m ? a : b)
+inline vec3x8 lane_select(maskx8 m, const vec3x8& a, const vec3x8& b) {
+	return vec3x8(lane_select(m, a.x, b.x), lane_select(m, a.y, b.y), lane_select(m, a.z, b.z));
+}
+
+/*------------------------------BATCH TRANSFORMS------------------------------*/
+//Transform arrays of points (w=1) or directions (w=0) 4 at a time using vec3x4
+//Matrices are treated as affine (no perspective divide). For normals under non-uniform scale
+//pass the inverse transpose. out can be the same array as in; there are in-place overloads too
+//Strided versions take byte strides (like glVertexAttribPointer) to work on interleaved vertex data
+
+//Column-major 3x4 affine matrix; 4th column is the translation
+struct gm_affine {
+	float m[12];
+};
+inline gm_affine gm_affine_from_mat4(const mat4& mm, bool translate) {
+	gm_affine a;
+	for(int col = 0; col < 3; col++) {
+		for(int row = 0; row < 3; row++) a.m[col*3 + row] = mm.m[col*4 + row];
+	}
+	for(int row = 0; row < 3; row++) a.m[9 + row] = translate ? mm.m[12 + row] : 0.0f;
+	return a;
+}
+inline gm_affine gm_affine_from_mat3(const mat3& mm, const vec3& pos) {
+	gm_affine a;
+	for(int i = 0; i < 9; i++) a.m[i] = mm.m[i];
+	for(int row = 0; row < 3; row++) a.m[9 + row] = pos.v[row];
+	return a;
+}
+
+inline vec3 gm_transform(const gm_affine& a, const vec3& p) {
+	return vec3(
+		a.m[0]*p.v[0] + a.m[3]*p.v[1] + a.m[6]*p.v[2] + a.m[9],
+		a.m[1]*p.v[0] + a.m[4]*p.v[1] + a.m[7]*p.v[2] + a.m[10],
+		a.m[2]*p.v[0] + a.m[5]*p.v[1] + a.m[8]*p.v[2] + a.m[11]
+	);
+}
+inline vec3x4 gm_transform_x4(const floatx4* a, const vec3x4& p) {
+	return vec3x4(
+		a[0]*p.x + a[3]*p.y + a[6]*p.z + a[9],
+		a[1]*p.x + a[4]*p.y + a[7]*p.z + a[10],
+		a[2]*p.x + a[5]*p.y + a[8]*p.z + a[11]
+	);
+}
+
+inline void gm_transform_batch(const gm_affine& a, const vec3* in, vec3* out, int count) {
+	floatx4 wide[12];
+	for(int i = 0; i < 12; i++) wide[i] = floatx4_set1(a.m[i]);
+	int i = 0;
+	for(; i + 4 <= count; i += 4) {
+		//all 4 are loaded before storing so in == out is fine
+		vec3x4 p(&in[i]);
+		gm_transform_x4(wide, p).store(&out[i]);
+	}
+	for(; i < count; i++) out[i] = gm_transform(a, in[i]);
+}
+
+inline void gm_transform_batch_strided(const gm_affine& a, const float* in, int in_stride, float* out, int out_stride, int count) {
+	floatx4 wide[12];
+	for(int i = 0; i < 12; i++) wide[i] = floatx4_set1(a.m[i]);
+	const char* src = (const char*)in;
+	char* dst = (char*)out;
+	int i = 0;
+	for(; i + 4 <= count; i += 4) {
+		float xs[4], ys[4], zs[4];
+		for(int j = 0; j < 4; j++) {
+			const float* p = (const float*)(src + (i+j)*in_stride);
+			xs[j] = p[0];
+			ys[j] = p[1];
+			zs[j] = p[2];
+		}
+		vec3x4 r = gm_transform_x4(wide, vec3x4(floatx4_load(xs), floatx4_load(ys), floatx4_load(zs)));
+		floatx4_store(xs, r.x);
+		floatx4_store(ys, r.y);
+		floatx4_store(zs, r.z);
+		for(int j = 0; j < 4; j++) {
+			float* p = (float*)(dst + (i+j)*out_stride);
+			p[0] = xs[j];
+			p[1] = ys[j];
+			p[2] = zs[j];
+		}
+	}
+	for(; i < count; i++) {
+		const float* p = (const float*)(src + i*in_stride);
+		vec3 r = gm_transform(a, vec3(p[0], p[1], p[2]));
+		float* q = (float*)(dst + i*out_stride);
+		q[0] = r.v[0];
+		q[1] = r.v[1];
+		q[2] = r.v[2];
+	}
+}
+
+inline void transform_points(const mat4& m, const vec3* in, vec3* out, int count) {
+	gm_transform_batch(gm_affine_from_mat4(m, true), in, out, count);
+}
+inline void transform_points(const mat4& m, vec3* points, int count) {
+	transform_points(m, points, points, count);
+}
+inline void transform_dirs(const mat4& m, const vec3* in, vec3* out, int count) {
+	gm_transform_batch(gm_affine_from_mat4(m, false), in, out, count);
+}
+inline void transform_dirs(const mat4& m, vec3* dirs, int count) {
+	transform_dirs(m, dirs, dirs, count);
+}
+//RS*p + pos
+inline void transform_points(const mat3& RS, const vec3& pos, const vec3* in, vec3* out, int count) {
+	gm_transform_batch(gm_affine_from_mat3(RS, pos), in, out, count);
+}
+inline void transform_points(const mat3& RS, const vec3& pos, vec3* points, int count) {
+	transform_points(RS, pos, points, points, count);
+}
+inline void transform_dirs(const mat3& m, const vec3* in, vec3* out, int count) {
+	gm_transform_batch(gm_affine_from_mat3(m, vec3(0,0,0)), in, out, count);
+}
+inline void transform_dirs(const mat3& m, vec3* dirs, int count) {
+	transform_dirs(m, dirs, dirs, count);
+}
+inline void transform_points(const Transform& t, const vec3* in, vec3* out, int count) {
+	mat4 m = transform_to_mat4(t);
+	transform_points(m, in, out, count);
+}
+inline void transform_points(const Transform& t, vec3* points, int count) {
+	transform_points(t, points, points, count);
+}
+inline void transform_points_strided(const mat4& m, const float* in, int in_stride, float* out, int out_stride, int count) {
+	gm_transform_batch_strided(gm_affine_from_mat4(m, true), in, in_stride, out, out_stride, count);
+}
+inline void transform_dirs_strided(const mat4& m, const float* in, int in_stride, float* out, int out_stride, int count) {
+	gm_transform_batch_strided(gm_affine_from_mat4(m, false), in, in_stride, out, out_stride, count);
+}
+
 #ifdef __clang__
 #pragma GCC diagnostic pop
 #endif
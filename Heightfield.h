@@ -0,0 +1,293 @@
+#pragma once
+#include <stdlib.h>
+#include <float.h>
+#include "GameMaths.h"
+
+//Compact collision representation for grid-structured terrain
+//Stores one float per sample; triangles are generated on the fly from the cell under a query
+//Each cell (ix,iz) is split into two CCW (seen from above) triangles:
+//	 tri 0: (x0,z0) (x0,z1) (x1,z0)		flipped_diagonal: (x0,z0) (x0,z1) (x1,z1)
+//	 tri 1: (x1,z0) (x0,z1) (x1,z1)		flipped_diagonal: (x0,z0) (x1,z1) (x1,z0)
+//Face index of a triangle is 2*(iz*(num_x-1) + ix) + tri
+
+struct Heightfield {
+	float* heights;		//num_x*num_z samples, row-major (heights[iz*num_x + ix])
+	int num_x, num_z;
+	float min_x, min_z;
+	float cell_size_x, cell_size_z;
+	float inv_cell_size_x, inv_cell_size_z;
+	bool flipped_diagonal;
+};
+
+#define HEIGHTFIELD_SPACING_TOLERANCE 0.001f //relative to cell size
+
+//Make a heightfield from explicit height data. Takes ownership of heights (must be malloc'd)
+Heightfield init_heightfield(float* heights, int num_x, int num_z, float min_x, float min_z, float cell_size_x, float cell_size_z);
+//Check if an indexed triangle mesh is a regular grid (in xz) of quads. Returns true and fills hf if it is
+bool detect_heightfield(const float* vp, const uint16_t* indices, uint32_t vert_count, uint32_t index_count, Heightfield* hf);
+void get_heightfield_face(const Heightfield &hf, int index, vec3* p0, vec3* p1, vec3* p2);
+//Returns index of face under (x,z) (or -1 if off the grid) and its height at that point
+int get_heightfield_height(const Heightfield &hf, float x, float z, float* height);
+//Möller–Trumbore ray/triangle test; returns distance along dir in *t
+bool ray_triangle(vec3 origin, vec3 dir, vec3 a, vec3 b, vec3 c, float* t);
+//Walk cells under the ray in xz. Returns face index of first hit (or -1) and distance along dir in *t
+int raycast_heightfield(const Heightfield &hf, vec3 origin, vec3 dir, float max_t, float* t);
+
+Heightfield init_heightfield(float* heights, int num_x, int num_z, float min_x, float min_z, float cell_size_x, float cell_size_z){
+	Heightfield hf;
+	hf.heights = heights;
+	hf.num_x = num_x;
+	hf.num_z = num_z;
+	hf.min_x = min_x;
+	hf.min_z = min_z;
+	hf.cell_size_x = cell_size_x;
+	hf.cell_size_z = cell_size_z;
+	hf.inv_cell_size_x = 1.0f/cell_size_x;
+	hf.inv_cell_size_z = 1.0f/cell_size_z;
+	hf.flipped_diagonal = false;
+	return hf;
+}
+
+static int cmp_float(const void* a, const void* b){
+	float fa = *(const float*)a;
+	float fb = *(const float*)b;
+	return (fa>fb) - (fa<fb);
+}
+
+//Find regularly spaced unique values in vals (sorts vals in place). Returns false if spacing isn't regular
+static bool get_regular_spacing(float* vals, uint32_t count, int* num_unique, float* spacing){
+	qsort(vals, count, sizeof(float), cmp_float);
+	float range = vals[count-1]-vals[0];
+	int n = 1;
+	for(uint32_t i=1; i<count; i++){
+		if(vals[i]-vals[n-1] > range*0.000001f) vals[n++] = vals[i];
+	}
+	if(n<2) return false;
+	*num_unique = n;
+	*spacing = range/(n-1);
+	for(int i=1; i<n; i++){
+		if(fabs(vals[i]-vals[i-1] - *spacing) > *spacing*HEIGHTFIELD_SPACING_TOLERANCE) return false;
+	}
+	return true;
+}
+
+bool detect_heightfield(const float* vp, const uint16_t* indices, uint32_t vert_count, uint32_t index_count, Heightfield* hf){
+	if(vert_count<4 || index_count<6) return false;
+
+	//Find grid dimensions from unique x and z coords
+	float* coords = (float*)malloc(vert_count*sizeof(float));
+	int num_x, num_z;
+	float cell_x, cell_z;
+	for(uint32_t i=0; i<vert_count; i++) coords[i] = vp[3*i];
+	bool is_grid = get_regular_spacing(coords, vert_count, &num_x, &cell_x);
+	float min_x = coords[0];
+	if(is_grid){
+		for(uint32_t i=0; i<vert_count; i++) coords[i] = vp[3*i+2];
+		is_grid = get_regular_spacing(coords, vert_count, &num_z, &cell_z);
+	}
+	float min_z = coords[0];
+	free(coords);
+	if(!is_grid) return false;
+
+	//Every cell must be covered by exactly two triangles
+	uint32_t num_cells = (num_x-1)*(num_z-1);
+	if(index_count/3 != 2*num_cells) return false;
+
+	//Map verts to samples; duplicated verts (e.g. split for normals) must agree on height
+	float* heights = (float*)malloc(num_x*num_z*sizeof(float));
+	int* sample = (int*)malloc(vert_count*sizeof(int));
+	for(int i=0; i<num_x*num_z; i++) heights[i] = FLT_MAX;
+	float tolerance_y = MIN(cell_x, cell_z)*HEIGHTFIELD_SPACING_TOLERANCE;
+	for(uint32_t i=0; i<vert_count && is_grid; i++){
+		int ix = (int)floor((vp[3*i]-min_x)/cell_x + 0.5f);
+		int iz = (int)floor((vp[3*i+2]-min_z)/cell_z + 0.5f);
+		sample[i] = iz*num_x + ix;
+		if(heights[sample[i]]==FLT_MAX) heights[sample[i]] = vp[3*i+1];
+		else if(fabs(heights[sample[i]]-vp[3*i+1]) > tolerance_y) is_grid = false; //overhang or wall
+	}
+	for(int i=0; i<num_x*num_z && is_grid; i++){
+		if(heights[i]==FLT_MAX) is_grid = false;
+	}
+
+	//Check triangles are half-cells, all split along the same diagonal
+	int diagonal = -1;
+	uint8_t* cell_covered = (uint8_t*)calloc(num_cells, 1);
+	for(uint32_t f=0; f<index_count/3 && is_grid; f++){
+		int ix[3], iz[3];
+		for(int i=0; i<3; i++){
+			ix[i] = sample[indices[3*f+i]]%num_x;
+			iz[i] = sample[indices[3*f+i]]/num_x;
+		}
+		//Triangle must span exactly one cell with three distinct corners, facing up
+		int cell_x = MIN(ix[0], MIN(ix[1], ix[2]));
+		int cell_z = MIN(iz[0], MIN(iz[1], iz[2]));
+		if(MAX(ix[0], MAX(ix[1], ix[2]))-cell_x != 1 || MAX(iz[0], MAX(iz[1], iz[2]))-cell_z != 1){ is_grid = false; break; }
+		int corner_mask = 0; //bit (2*dz + dx) set for each corner used
+		for(int i=0; i<3; i++) corner_mask |= 1 << (2*(iz[i]-cell_z) + (ix[i]-cell_x));
+		const float* p0 = &vp[3*indices[3*f]];
+		const float* p1 = &vp[3*indices[3*f+1]];
+		const float* p2 = &vp[3*indices[3*f+2]];
+		float norm_y = (p1[2]-p0[2])*(p2[0]-p0[0]) - (p1[0]-p0[0])*(p2[2]-p0[2]);
+		bool three_corners = (corner_mask==0x7 || corner_mask==0xB || corner_mask==0xD || corner_mask==0xE);
+		if(!three_corners || norm_y<=0){ is_grid = false; break; }
+		//Each half of a cell can only be covered once
+		uint8_t* covered = &cell_covered[cell_z*(num_x-1) + cell_x];
+		uint8_t half = (corner_mask==0x7 || corner_mask==0xD) ? 1 : 2;
+		if(*covered & half){ is_grid = false; break; }
+		*covered |= half;
+		//A triangle using both (x0,z0) and (x1,z1) is split along the flipped diagonal
+		int tri_diagonal = ((corner_mask & 0x9)==0x9) ? 1 : 0;
+		if(diagonal<0) diagonal = tri_diagonal;
+		else if(diagonal!=tri_diagonal){ is_grid = false; }
+	}
+	free(cell_covered);
+	free(sample);
+	if(!is_grid){
+		free(heights);
+		return false;
+	}
+
+	*hf = init_heightfield(heights, num_x, num_z, min_x, min_z, cell_x, cell_z);
+	hf->flipped_diagonal = (diagonal==1);
+	return true;
+}
+
+void get_heightfield_face(const Heightfield &hf, int index, vec3* p0, vec3* p1, vec3* p2){
+	int cell = index/2;
+	int ix = cell%(hf.num_x-1);
+	int iz = cell/(hf.num_x-1);
+	float x0 = hf.min_x + ix*hf.cell_size_x;
+	float z0 = hf.min_z + iz*hf.cell_size_z;
+	float x1 = x0 + hf.cell_size_x;
+	float z1 = z0 + hf.cell_size_z;
+	const float* h = &hf.heights[iz*hf.num_x + ix];
+	vec3 s00 = vec3(x0, h[0], z0);
+	vec3 s10 = vec3(x1, h[1], z0);
+	vec3 s01 = vec3(x0, h[hf.num_x], z1);
+	vec3 s11 = vec3(x1, h[hf.num_x+1], z1);
+
+	if(!hf.flipped_diagonal){
+		if(index%2==0){ *p0 = s00; *p1 = s01; *p2 = s10; }
+		else		  { *p0 = s10; *p1 = s01; *p2 = s11; }
+	}
+	else {
+		if(index%2==0){ *p0 = s00; *p1 = s01; *p2 = s11; }
+		else		  { *p0 = s00; *p1 = s11; *p2 = s10; }
+	}
+}
+
+int get_heightfield_height(const Heightfield &hf, float x, float z, float* height){
+	float fx = (x-hf.min_x)*hf.inv_cell_size_x;
+	float fz = (z-hf.min_z)*hf.inv_cell_size_z;
+	if(fx<0 || fz<0 || fx>hf.num_x-1 || fz>hf.num_z-1) return -1;
+	int ix = (int)fx;
+	int iz = (int)fz;
+	//Points on the far edges belong to the last cell
+	if(ix==hf.num_x-1) ix--;
+	if(iz==hf.num_z-1) iz--;
+	fx -= ix;
+	fz -= iz;
+
+	const float* h = &hf.heights[iz*hf.num_x + ix];
+	float h00 = h[0], h10 = h[1], h01 = h[hf.num_x], h11 = h[hf.num_x+1];
+	int face = 2*(iz*(hf.num_x-1) + ix);
+	if(!hf.flipped_diagonal){
+		if(fx+fz<=1){ *height = h00 + (h10-h00)*fx + (h01-h00)*fz; }
+		else { *height = h11 + (h01-h11)*(1-fx) + (h10-h11)*(1-fz); face++; }
+	}
+	else {
+		if(fz>=fx){ *height = h00 + (h01-h00)*fz + (h11-h01)*fx; }
+		else { *height = h00 + (h10-h00)*fx + (h11-h10)*fz; face++; }
+	}
+	return face;
+}
+
+bool ray_triangle(vec3 origin, vec3 dir, vec3 a, vec3 b, vec3 c, float* t){
+	vec3 e1 = b-a;
+	vec3 e2 = c-a;
+	vec3 p = cross(dir, e2);
+	float det = dot(e1, p);
+	if(fabs(det) < 0.0000001f) return false; //ray parallel to triangle
+	float inv_det = 1.0f/det;
+	vec3 s = origin-a;
+	float u = dot(s, p)*inv_det;
+	if(u<0 || u>1) return false;
+	vec3 q = cross(s, e1);
+	float v = dot(dir, q)*inv_det;
+	if(v<0 || u+v>1) return false;
+	*t = dot(e2, q)*inv_det;
+	return *t>=0;
+}
+
+int raycast_heightfield(const Heightfield &hf, vec3 origin, vec3 dir, float max_t, float* t){
+	//Clip ray against grid bounds in xz
+	float max_x = hf.min_x + (hf.num_x-1)*hf.cell_size_x;
+	float max_z = hf.min_z + (hf.num_z-1)*hf.cell_size_z;
+	float t0 = 0, t1 = max_t;
+	float o[2] = {origin.x, origin.z};
+	float d[2] = {dir.x, dir.z};
+	float lo[2] = {hf.min_x, hf.min_z};
+	float hi[2] = {max_x, max_z};
+	for(int i=0; i<2; i++){
+		if(fabs(d[i]) < 0.0000001f){
+			if(o[i]<lo[i] || o[i]>hi[i]) return -1;
+			continue;
+		}
+		float ta = (lo[i]-o[i])/d[i];
+		float tb = (hi[i]-o[i])/d[i];
+		t0 = MAX(t0, MIN(ta, tb));
+		t1 = MIN(t1, MAX(ta, tb));
+	}
+	if(t0>t1) return -1;
+
+	//2D DDA over cells from entry point
+	float cell_size[2] = {hf.cell_size_x, hf.cell_size_z};
+	int num_cells[2] = {hf.num_x-1, hf.num_z-1};
+	int cell[2], step[2];
+	float t_next[2], t_delta[2];
+	for(int i=0; i<2; i++){
+		float p = o[i] + d[i]*t0;
+		cell[i] = CLAMP((int)floor((p-lo[i])/cell_size[i]), 0, num_cells[i]-1);
+		if(d[i]>0){
+			step[i] = 1;
+			t_next[i] = t0 + (lo[i] + (cell[i]+1)*cell_size[i] - p)/d[i];
+			t_delta[i] = cell_size[i]/d[i];
+		}
+		else if(d[i]<0){
+			step[i] = -1;
+			t_next[i] = t0 + (lo[i] + cell[i]*cell_size[i] - p)/d[i];
+			t_delta[i] = -cell_size[i]/d[i];
+		}
+		else {
+			step[i] = 0;
+			t_next[i] = FLT_MAX;
+			t_delta[i] = FLT_MAX;
+		}
+	}
+
+	while(true){
+		int face = 2*(cell[1]*num_cells[0] + cell[0]);
+		int hit_face = -1;
+		float closest_t = max_t;
+		for(int i=0; i<2; i++){
+			vec3 a, b, c;
+			get_heightfield_face(hf, face+i, &a, &b, &c);
+			float tri_t;
+			if(ray_triangle(origin, dir, a, b, c, &tri_t) && tri_t<=closest_t){
+				closest_t = tri_t;
+				hit_face = face+i;
+			}
+		}
+		if(hit_face>=0){
+			*t = closest_t;
+			return hit_face;
+		}
+
+		//Step to next cell
+		int axis = (t_next[0]<t_next[1]) ? 0 : 1;
+		if(t_next[axis]>t1) return -1;
+		cell[axis] += step[axis];
+		if(cell[axis]<0 || cell[axis]>=num_cells[axis]) return -1;
+		t_next[axis] += t_delta[axis];
+	}
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "GameMaths.h"
+#include "Profiler.h"
+
+//Kevin's minimal job system: a fixed pool of worker threads pulling from one shared queue
+//Jobs are plain function pointers + user data, completion is tracked with a JobCounter
+//Threads waiting on a counter run queued jobs themselves instead of sleeping
+//If job_system_init() was never called (or asked for 0 workers) jobs just run inline on the calling thread
+
+#define JOB_QUEUE_SIZE 4096 //max jobs in flight, job_submit runs jobs inline if the queue is full
+
+typedef void (*JobFunction)(void* data);
+//Called with a range [begin, end) of the items passed to parallel_for
+typedef void (*ParallelForFunction)(void* data, uint32_t begin, uint32_t end);
+
+struct JobCounter {
+	std::atomic<int32_t> num_pending;
+	JobCounter(){ num_pending.store(0); }
+};
+
+//num_threads = 0: one worker per hardware thread, minus one for the main thread
+void job_system_init(int num_threads=0);
+void job_system_shutdown();
+int job_system_num_workers();
+//Counter (optional) is incremented now and decremented when the job finishes
+void job_submit(JobFunction function, void* data, JobCounter* counter=NULL);
+//Block until counter reaches zero, running other jobs in the meantime
+void job_wait(JobCounter* counter);
+//Run one queued job on the calling thread, returns false if there was nothing queued
+bool job_try_run();
+//Split [0, count) into batches of batch_size and run them across all threads, returns when all are done
+void parallel_for(uint32_t count, uint32_t batch_size, ParallelForFunction function, void* data);
+
+struct Job {
+	JobFunction function;
+	void* data;
+	JobCounter* counter;
+};
+
+//Internal data
+static std::thread* g_job_workers = NULL;
+static int g_job_num_workers = 0;
+static Job g_job_queue[JOB_QUEUE_SIZE];
+static uint32_t g_job_queue_head = 0; //next job to run
+static uint32_t g_job_queue_tail = 0; //next free slot
+static std::mutex g_job_queue_mutex;
+static std::condition_variable g_job_queue_cv;
+static bool g_job_system_quit = false;
+
+static void run_job(const Job &job){
+	job.function(job.data);
+	if(job.counter) job.counter->num_pending.fetch_sub(1, std::memory_order_release);
+}
+
+//Pops a job if one is queued
+static bool try_pop_job(Job* job){
+	std::lock_guard<std::mutex> lock(g_job_queue_mutex);
+	if(g_job_queue_head==g_job_queue_tail) return false;
+	*job = g_job_queue[g_job_queue_head%JOB_QUEUE_SIZE];
+	g_job_queue_head++;
+	return true;
+}
+
+static void job_worker_main(int index){
+	static const char* names[] = { "worker 0", "worker 1", "worker 2", "worker 3", "worker 4", "worker 5", "worker 6", "worker 7" };
+	profiler_set_thread_name(index<8 ? names[index] : "worker");
+	while(true){
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(g_job_queue_mutex);
+			g_job_queue_cv.wait(lock, []{ return g_job_system_quit || g_job_queue_head!=g_job_queue_tail; });
+			if(g_job_system_quit) return;
+			job = g_job_queue[g_job_queue_head%JOB_QUEUE_SIZE];
+			g_job_queue_head++;
+		}
+		run_job(job);
+	}
+}
+
+void job_system_init(int num_threads){
+	if(g_job_workers) return;
+	if(num_threads<=0) num_threads = (int)std::thread::hardware_concurrency()-1;
+	if(num_threads<=0) return; //single core, everything runs inline
+	g_job_system_quit = false;
+	g_job_num_workers = num_threads;
+	g_job_workers = new std::thread[num_threads];
+	for(int i=0; i<num_threads; i++) g_job_workers[i] = std::thread(job_worker_main, i);
+}
+
+void job_system_shutdown(){
+	if(!g_job_workers) return;
+	{
+		std::lock_guard<std::mutex> lock(g_job_queue_mutex);
+		g_job_system_quit = true;
+	}
+	g_job_queue_cv.notify_all();
+	for(int i=0; i<g_job_num_workers; i++) g_job_workers[i].join();
+	delete[] g_job_workers;
+	g_job_workers = NULL;
+	g_job_num_workers = 0;
+	//Anything left in the queue never ran, run it now so no one waits forever
+	Job job;
+	while(try_pop_job(&job)) run_job(job);
+}
+
+int job_system_num_workers(){ return g_job_num_workers; }
+
+void job_submit(JobFunction function, void* data, JobCounter* counter){
+	Job job = { function, data, counter };
+	if(counter) counter->num_pending.fetch_add(1, std::memory_order_relaxed);
+	if(g_job_num_workers>0){
+		std::unique_lock<std::mutex> lock(g_job_queue_mutex);
+		if(g_job_queue_tail-g_job_queue_head<JOB_QUEUE_SIZE){
+			g_job_queue[g_job_queue_tail%JOB_QUEUE_SIZE] = job;
+			g_job_queue_tail++;
+			lock.unlock();
+			g_job_queue_cv.notify_one();
+			return;
+		}
+	}
+	run_job(job); //no workers or queue full
+}
+
+void job_wait(JobCounter* counter){
+	while(counter->num_pending.load(std::memory_order_acquire)>0){
+		if(!job_try_run()) std::this_thread::yield();
+	}
+}
+
+bool job_try_run(){
+	Job job;
+	if(!try_pop_job(&job)) return false;
+	run_job(job);
+	return true;
+}
+
+struct ParallelForData {
+	ParallelForFunction function;
+	void* data;
+	uint32_t count;
+	uint32_t batch_size;
+	std::atomic<uint32_t> next_batch;
+};
+
+//Every thread that joins in grabs batches until there are none left
+static void parallel_for_job(void* data){
+	ParallelForData* pf = (ParallelForData*)data;
+	uint32_t num_batches = (pf->count+pf->batch_size-1)/pf->batch_size;
+	while(true){
+		uint32_t batch = pf->next_batch.fetch_add(1, std::memory_order_relaxed);
+		if(batch>=num_batches) return;
+		uint32_t begin = batch*pf->batch_size;
+		uint32_t end = MIN(begin+pf->batch_size, pf->count);
+		pf->function(pf->data, begin, end);
+	}
+}
+
+void parallel_for(uint32_t count, uint32_t batch_size, ParallelForFunction function, void* data){
+	if(count==0) return;
+	if(batch_size==0) batch_size = 1;
+	uint32_t num_batches = (count+batch_size-1)/batch_size;
+	if(g_job_num_workers==0 || num_batches==1){
+		function(data, 0, count);
+		return;
+	}
+	ParallelForData pf;
+	pf.function = function;
+	pf.data = data;
+	pf.count = count;
+	pf.batch_size = batch_size;
+	pf.next_batch.store(0);
+
+	JobCounter counter;
+	int num_helpers = MIN((int)num_batches-1, g_job_num_workers);
+	for(int i=0; i<num_helpers; i++) job_submit(parallel_for_job, &pf, &counter);
+	parallel_for_job(&pf); //calling thread does its share too
+	job_wait(&counter);
+}
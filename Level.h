@@ -1,23 +1,211 @@
 #pragma once
+#include <stdlib.h>
+#include <string.h>
+#include <float.h>
+#include "Heightfield.h"
+#include "MeshAdjacency.h"
+#include "Platform.h"
+#include "Profiler.h"
+
+//Upward-facing walkable face, flattened for quick height lookups
+struct GroundFace {
+	float x[3], z[3];	//verts projected onto xz plane (CCW seen from above)
+	vec3 normal;
+	float plane_d;		//plane equation: dot(normal, p) = plane_d
+	int32_t face;		//index of face in level
+};
+
+//2D (xz) grid over the level's walkable faces
+//Each cell lists the ground faces whose xz bounds overlap it
+struct GroundGrid {
+	float min_x, min_z;
+	float cell_size, inv_cell_size;
+	int num_cells_x, num_cells_z;
+	uint32_t* cell_start;	//num_cells+1 offsets into cell_faces
+	uint32_t* cell_faces;	//indices into faces
+	GroundFace* faces;
+	uint32_t num_faces;
+};
+
+//Bounds of a run of LEVEL_VERTEX_CLUSTER_SIZE consecutive (welded) vertices, for decoding quantised verts
+struct VertexCluster {
+	vec3 min;
+	vec3 scale;		//extent/65535
+};
 
 struct LevelCollider {
 	float* verts;
 	uint16_t* indices;
-	uint16_t num_faces;
+	uint32_t num_verts;
+	uint32_t num_faces;
+	GroundGrid ground;
+	bool is_heightfield;		//if set, faces come from heightfield and verts/indices are NULL
+	Heightfield heightfield;
+	MeshAdjacency adjacency;	//empty for heightfields (neighbours are implicit in the grid)
+	Platform* platforms;		//moving sub-meshes, see add_level_platform()
+	int num_platforms;
+	//Compressed vertex storage, see compress_level_verts(). If set, verts is NULL
+	uint16_t* quantised_verts;	//3 per vertex, offsets within vertex's cluster bounds
+	VertexCluster* clusters;
+	float max_quantisation_error;
+};
+
+//Result of a ground height query
+struct GroundHit {
+	float height;
+	vec3 normal;
+	int32_t face; //-1 if there's no ground under the query point
+};
+
+//Contact between player and a level face
+struct PlayerContact {
+	vec3 normal;
+	float depth;	//how far player has to move along normal to resolve contact
+	int32_t face;
+	int32_t platform;	//-1 for static level faces
+	bool is_ground;
 };
 
+#define PLAYER_MAX_CONTACTS 32
+#define PLAYER_CONTACT_MERGE_COS 0.999f				//merge contacts whose normals are closer than this
+#define PLAYER_CONTACT_SOLVER_ITERATIONS 16
+#define PLAYER_CONTACT_SOLVER_TOLERANCE 0.0001f
+#define PLAYER_PLATFORM_FACE_CHUNK 32			//platform faces near the player are gathered this many at a time
+
+struct PlayerContactSet {
+	PlayerContact contacts[PLAYER_MAX_CONTACTS];
+	int num_contacts;
+};
+
+//Faces near an agent last frame. Lets collide_player_ground walk the mesh outwards from them
+//instead of testing every face; one per agent
+#define PLAYER_GROUND_CACHE_MAX_FACES 64		//seeds kept between frames, the walk finds the rest
+#define PLAYER_GROUND_CACHE_MARGIN 0.5f		//search this far past the player's bounding sphere
+#define PLAYER_GROUND_WALK_MARGIN 1.0f		//walk crosses faces this far outside the search sphere
+#define PLAYER_GROUND_WALK_MAX_FACES 1024		//faces a walk can cross before falling back to a full search
+#define PLAYER_GROUND_WALK_MAX_VISITED (2*PLAYER_GROUND_WALK_MAX_FACES)	//faces crossed or rejected
+#define PLAYER_GROUND_WALK_HASH_SIZE (2*PLAYER_GROUND_WALK_MAX_VISITED)	//power of two
+
+struct PlayerGroundCache {
+	int32_t faces[PLAYER_GROUND_CACHE_MAX_FACES];	//seeds for the walk, at least one per patch of faces near the agent
+	int num_faces;		//0 forces a full search
+};
+
+struct RayHit {
+	float t;		//distance along ray dir
+	vec3 pos;
+	vec3 normal;
+	int32_t face;
+};
+
+#define LEVEL_VERTEX_CLUSTER_SIZE 256
+#define LEVEL_GROUND_GRID_MAX_DIM 1024
+#define LEVEL_GROUND_EDGE_EPSILON 0.00001f //so points on shared edges don't fall through the cracks
+
+void get_face(const LevelCollider &level, int index, vec3* p0, vec3* p1, vec3* p2);
+//Add a moving platform to the level (level takes ownership), returns its index
+//Move it with set_platform_transform(&level.platforms[index], xform)
+//NB: Ground height queries and raycasts only see static geometry
+int add_level_platform(LevelCollider* level, Platform platform);
+//Weld level's verts by position and replace them with 16-bit offsets within per-cluster bounds
+//(under half the memory), error per axis is at most half a step of the cluster's extent/65535
+//Shared positions decode identically, so the mesh stays watertight. Rebuilds the ground grid
+void compress_level_verts(LevelCollider* level);
+void init_ground_grid(LevelCollider* level);
+//Returns true if there's ground under (x,z), finds highest ground face at or below max_y
+bool get_ground_height(const LevelCollider &level, float x, float z, GroundHit* hit, float max_y=FLT_MAX);
+//Bulk version; points[i].y is the max_y for each query. Returns number of points with ground under them
+int get_ground_heights(const LevelCollider &level, const vec3* points, int count, GroundHit* hits);
+//Push player out of level faces it's touching and set player's ground/platform state. Pass the agent's cache to walk the mesh
+void collide_player_ground(const LevelCollider &level, Capsule* player_collider, PlayerState* player, PlayerGroundCache* cache=NULL);
+//Returns true if ray hits level within max_t (dir should be normalised for hit->t to be a distance)
+bool raycast_level(const LevelCollider &level, vec3 origin, vec3 dir, float max_t, RayHit* hit);
+//Bytes of heap memory owned by level (geometry plus acceleration data)
+size_t level_memory_usage(const LevelCollider &level);
+
 //Create a LevelCollider object from vertex data; generates a list of triangles which store their neighbours
 LevelCollider init_level(float* vp, uint16_t* indices, uint32_t vert_count, uint32_t index_count){
+    PROFILE_FUNCTION();
     LevelCollider level;
     
     level.verts = vp;
     level.indices = indices;
+    level.num_verts = vert_count;
     level.num_faces = index_count/3;
+    level.is_heightfield = false;
+    level.quantised_verts = NULL;
+    level.clusters = NULL;
+    level.max_quantisation_error = 0;
+    level.platforms = NULL;
+    level.num_platforms = 0;
+
+    //Grid terrain only needs one float per sample, drop the triangle soup
+    if(detect_heightfield(vp, indices, vert_count, index_count, &level.heightfield)){
+        free(vp);
+        free(indices);
+        level.verts = NULL;
+        level.indices = NULL;
+        level.num_verts = 0;
+        level.num_faces = 2*(level.heightfield.num_x-1)*(level.heightfield.num_z-1);
+        level.is_heightfield = true;
+        printf("Level is a %dx%d heightfield\n", level.heightfield.num_x, level.heightfield.num_z);
+        memset(&level.adjacency, 0, sizeof(MeshAdjacency));
+    }
+    else {
+        level.adjacency = build_mesh_adjacency(vp, indices, vert_count, level.num_faces);
+    }
+
+    init_ground_grid(&level);
+
+    return level;
+}
+
+//Create a LevelCollider object from explicit heightfield data. Takes ownership of heights (must be malloc'd)
+LevelCollider init_level_heightfield(float* heights, int num_x, int num_z, float min_x, float min_z, float cell_size_x, float cell_size_z){
+    LevelCollider level;
+
+    level.verts = NULL;
+    level.indices = NULL;
+    level.num_verts = 0;
+    level.num_faces = 2*(num_x-1)*(num_z-1);
+    level.is_heightfield = true;
+    level.quantised_verts = NULL;
+    level.clusters = NULL;
+    level.max_quantisation_error = 0;
+    level.platforms = NULL;
+    level.num_platforms = 0;
+    level.heightfield = init_heightfield(heights, num_x, num_z, min_x, min_z, cell_size_x, cell_size_z);
+    memset(&level.adjacency, 0, sizeof(MeshAdjacency));
+
+    init_ground_grid(&level);
 
     return level;
 }
 
+int add_level_platform(LevelCollider* level, Platform platform){
+    level->platforms = (Platform*)realloc((void*)level->platforms, (level->num_platforms+1)*sizeof(Platform));
+    level->platforms[level->num_platforms] = platform;
+    return level->num_platforms++;
+}
+
 void get_face(const LevelCollider &level, int index, vec3* p0, vec3* p1, vec3* p2){
+    if(level.is_heightfield){
+        get_heightfield_face(level.heightfield, index, p0, p1, p2);
+        return;
+    }
+
+    if(level.quantised_verts){
+        vec3* p[3] = {p0, p1, p2};
+        for(int i=0; i<3; i++){
+            uint16_t idx = level.indices[3*index+i];
+            const uint16_t* q = &level.quantised_verts[3*idx];
+            const VertexCluster &cluster = level.clusters[idx/LEVEL_VERTEX_CLUSTER_SIZE];
+            *p[i] = vec3(cluster.min.x + q[0]*cluster.scale.x,
+                         cluster.min.y + q[1]*cluster.scale.y,
+                         cluster.min.z + q[2]*cluster.scale.z);
+        }
+        return;
+    }
 
     uint16_t idx0 = level.indices[3*index];
     *p0 = vec3(level.verts[3*idx0], level.verts[3*idx0+1], level.verts[3*idx0+2]);
@@ -29,6 +217,87 @@ void get_face(const LevelCollider &level, int index, vec3* p0, vec3* p1, vec3* p
     *p2 = vec3(level.verts[3*idx2], level.verts[3*idx2+1], level.verts[3*idx2+2]);
 }
 
+void compress_level_verts(LevelCollider* level){
+    if(level->is_heightfield || level->quantised_verts || level->num_verts==0) return;
+    PROFILE_FUNCTION();
+    MeshAdjacency* adj = &level->adjacency;
+    size_t old_size = 3*level->num_verts*sizeof(float);
+
+    //Weld first: load_obj makes a copy of a position for every normal it has, and copies that land in
+    //different clusters would quantise to different points and open cracks along seams
+    //Indices then point at welded verts, so the adjacency's welded vertex map becomes the identity
+    uint32_t num_verts = adj->num_welded_verts;
+    float* verts = (float*)malloc(3*num_verts*sizeof(float));
+    for(uint32_t i=0; i<level->num_verts; i++) memcpy(&verts[3*adj->welded_vert[i]], &level->verts[3*i], 3*sizeof(float));
+    for(uint32_t i=0; i<3*level->num_faces; i++) level->indices[i] = (uint16_t)adj->welded_vert[level->indices[i]];
+    adj->welded_vert = (uint32_t*)realloc(adj->welded_vert, MAX(num_verts, 1u)*sizeof(uint32_t));
+    for(uint32_t i=0; i<num_verts; i++) adj->welded_vert[i] = i;
+    free(level->verts);
+    level->verts = NULL;
+    level->num_verts = num_verts;
+
+    uint32_t num_clusters = (num_verts+LEVEL_VERTEX_CLUSTER_SIZE-1)/LEVEL_VERTEX_CLUSTER_SIZE;
+    level->clusters = (VertexCluster*)malloc(num_clusters*sizeof(VertexCluster));
+    level->quantised_verts = (uint16_t*)malloc(3*num_verts*sizeof(uint16_t));
+    level->max_quantisation_error = 0;
+
+    for(uint32_t c=0; c<num_clusters; c++){
+        uint32_t first = c*LEVEL_VERTEX_CLUSTER_SIZE;
+        uint32_t last = MIN(first+LEVEL_VERTEX_CLUSTER_SIZE, num_verts);
+
+        //Cluster bounds
+        float min[3] = {FLT_MAX, FLT_MAX, FLT_MAX};
+        float max[3] = {-FLT_MAX, -FLT_MAX, -FLT_MAX};
+        for(uint32_t i=first; i<last; i++){
+            for(int k=0; k<3; k++){
+                min[k] = MIN(min[k], verts[3*i+k]);
+                max[k] = MAX(max[k], verts[3*i+k]);
+            }
+        }
+        VertexCluster* cluster = &level->clusters[c];
+        cluster->min = vec3(min[0], min[1], min[2]);
+        cluster->scale = vec3((max[0]-min[0])/65535, (max[1]-min[1])/65535, (max[2]-min[2])/65535);
+
+        //Quantise, measuring the actual error
+        for(uint32_t i=first; i<last; i++){
+            for(int k=0; k<3; k++){
+                float v = verts[3*i+k];
+                float s = cluster->scale.v[k];
+                uint16_t q = (s>0) ? (uint16_t)CLAMP((int)((v-min[k])/s + 0.5f), 0, 65535) : 0;
+                level->quantised_verts[3*i+k] = q;
+                float error = fabsf(min[k] + q*s - v);
+                level->max_quantisation_error = MAX(level->max_quantisation_error, error);
+            }
+        }
+    }
+    free(verts);
+
+    //Ground height queries and the component bounds the ground cache walk checks have to
+    //agree with the decoded positions collision sees, so rebuild them from those
+    free(level->ground.faces);
+    free(level->ground.cell_start);
+    free(level->ground.cell_faces);
+    init_ground_grid(level);
+    for(uint32_t c=0; c<adj->num_components; c++){
+        adj->component_min[c] = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+        adj->component_max[c] = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+    }
+    for(uint32_t i=0; i<level->num_faces; i++){
+        vec3 p[3];
+        get_face(*level, i, &p[0], &p[1], &p[2]);
+        uint32_t c = adj->face_component[i];
+        for(int j=0; j<3; j++){
+            for(int k=0; k<3; k++){
+                adj->component_min[c].v[k] = MIN(adj->component_min[c].v[k], p[j].v[k]);
+                adj->component_max[c].v[k] = MAX(adj->component_max[c].v[k], p[j].v[k]);
+            }
+        }
+    }
+
+    size_t new_size = 3*num_verts*sizeof(uint16_t) + num_clusters*sizeof(VertexCluster);
+    printf("Compressed level verts: %zu -> %zu bytes (%u welded verts), max error %g\n", old_size, new_size, num_verts, level->max_quantisation_error);
+}
+
 //Returns vector result from point p to closest point on triangle abc
 //Returns true if p's projection onto the abc's plane lies within the triangle
 bool get_vec_to_triangle(vec3 p, vec3 a, vec3 b, vec3 c, vec3* result){
@@ -81,64 +350,569 @@ bool get_vec_to_triangle(vec3 p, vec3 a, vec3 b, vec3 c, vec3* result){
     return false;
 }
 
-void collide_player_ground(const LevelCollider &level, Capsule* player_collider) {
-    bool hit_ground = false;
+//Gather contact between player and a single triangle (face of level, or of platform if platform>=0)
+//Returns true if the player is touching the face
+bool gather_player_contact_face(vec3 level_face_a, vec3 level_face_b, vec3 level_face_c, int face, int platform, Capsule* player_collider, vec3 player_sphere_center, float player_sphere_radius, PlayerContactSet* contacts){
+    //Broad phase
+    //Get face's bounding sphere
+    vec3 face_sphere_center = (level_face_a+level_face_b+level_face_c)/3;
+    float face_sphere_radius = length(level_face_a-face_sphere_center);
 
-    //Calculate bounding sphere for player
-    float player_sphere_radius = (player_collider->y_base + player_collider->y_cap)/2;
-    vec3 player_sphere_center = player_collider->pos + player_collider->matRS*vec3(0,player_sphere_radius,0);
+    //Sphere intersection test
+    COLLISION_STAT_INC(faces_considered);
+    vec3 player_to_face_vec = player_sphere_center-face_sphere_center;
+    if(length(player_to_face_vec)>face_sphere_radius + player_sphere_radius) return false;
+    COLLISION_STAT_INC(broadphase_survivors);
+
+    //Narrow phase, using GJK
+    vec3 level_face_norm = normalise(cross(level_face_b-level_face_a, level_face_c-level_face_a));
+
+    TriangleCollider triangle_collider;
+    triangle_collider.xform.pos = face_sphere_center;
+    triangle_collider.points[0] = level_face_a;
+    triangle_collider.points[1] = level_face_b;
+    triangle_collider.points[2] = level_face_c;
+    triangle_collider.normal = level_face_norm;
+
+    //Check intersection
+    if(!gjk(player_collider, &triangle_collider)) return false;
+
+    //Penetration depth of player's deepest point along face normal
+    vec3 support_point = player_collider->support(-level_face_norm);
+    float player_dist_along_norm = dot(support_point-level_face_a,level_face_norm);
+
+    PlayerContact contact;
+    contact.normal = level_face_norm;
+    contact.depth = -player_dist_along_norm;
+    contact.face = face;
+    contact.platform = platform;
+    float face_slope = RAD2DEG(acos(dot(level_face_norm, vec3(0,1,0))));
+    contact.is_ground = (face_slope<=player_max_stand_slope);
+
+    if(contacts->num_contacts<PLAYER_MAX_CONTACTS){
+        contacts->contacts[contacts->num_contacts++] = contact;
+    }
+    else { //Full, replace shallowest contact if this one is deeper
+        int shallowest = 0;
+        for(int i=1; i<PLAYER_MAX_CONTACTS; i++){
+            if(contacts->contacts[i].depth<contacts->contacts[shallowest].depth) shallowest = i;
+        }
+        if(contact.depth>contacts->contacts[shallowest].depth) contacts->contacts[shallowest] = contact;
+    }
+    return true;
+}
+
+bool gather_player_contact(const LevelCollider &level, int face, Capsule* player_collider, vec3 player_sphere_center, float player_sphere_radius, PlayerContactSet* contacts){
+    vec3 a, b, c;
+    get_face(level, face, &a, &b, &c);
+    return gather_player_contact_face(a, b, c, face, -1, player_collider, player_sphere_center, player_sphere_radius, contacts);
+}
+
+//Distance from center to the surface of a face's bounding sphere (negative inside it)
+float face_sphere_gap(const LevelCollider &level, int face, vec3 center){
+    vec3 a, b, c;
+    get_face(level, face, &a, &b, &c);
+    vec3 face_sphere_center = (a+b+c)/3;
+    float face_sphere_radius = length(a-face_sphere_center);
+    return length(center-face_sphere_center) - face_sphere_radius;
+}
+
+//Broadphase test of a face's bounding sphere against a sphere
+bool face_overlaps_sphere(const LevelCollider &level, int face, vec3 center, float radius){
+    return face_sphere_gap(level, face, center) <= radius;
+}
+
+//Faces near an agent, found by walk_player_ground() or a full search
+struct PlayerGroundFaces {
+    int32_t faces[PLAYER_GROUND_WALK_MAX_FACES];
+    int num_faces;
+};
+
+//Open addressing set of faces for the walk, slots start as -1. Returns false if face was already in it
+static bool insert_walk_face(int32_t* set, int32_t face){
+    uint32_t slot = ((uint32_t)face*2654435761u) & (PLAYER_GROUND_WALK_HASH_SIZE-1);
+    while(set[slot]>=0){
+        if(set[slot]==face) return false;
+        slot = (slot+1) & (PLAYER_GROUND_WALK_HASH_SIZE-1);
+    }
+    set[slot] = face;
+    return true;
+}
+
+static int compare_faces(const void* a, const void* b){
+    int32_t fa = *(const int32_t*)a, fb = *(const int32_t*)b;
+    return (fa>fb) - (fa<fb);
+}
+
+//Find faces overlapping the search sphere by flooding out through vertex adjacency from seeds.
+//The flood also crosses faces up to walk_margin outside the sphere, so parts of the mesh that only join up
+//just outside it (a wall and the floor it stands on) are still found. Writes the faces in the sphere (in face order)
+//and seeds for next frame: the nearest face of each separately connected patch, then as many more as fit,
+//so truncating the seeds never loses a patch (too many patches leaves next_seeds empty)
+//Returns false if a full search is needed: no seed is nearby, a mesh component near the sphere wasn't reached,
+//or the walk got too big
+//NB: Still misses faces in the sphere which only connect to the seeded ones further than walk_margin outside it
+bool walk_player_ground(const LevelCollider &level, const int32_t* seeds, int num_seeds, vec3 center, float radius, float walk_margin, PlayerGroundFaces* result, PlayerGroundCache* next_seeds){
+    const MeshAdjacency &adj = level.adjacency;
+    float walk_radius = radius + walk_margin;
+    result->num_faces = 0;
+    next_seeds->num_faces = 0; //seeds may point into next_seeds, num_seeds is already copied
 
-    for(int i=0; i<level.num_faces; i++){
-        //Get current face
-        vec3 level_face_a, level_face_b, level_face_c;
-        get_face(level, i, &level_face_a, &level_face_b, &level_face_c);
+    //Every face looked at goes in visited, faces the walk crosses also go in the queue
+    //Patches are contiguous in the queue since each is flooded from one seed before the next
+    int32_t visited[PLAYER_GROUND_WALK_HASH_SIZE];
+    memset(visited, 0xFF, sizeof(visited));
+    int num_visited = 0;
+    int32_t queue[PLAYER_GROUND_WALK_MAX_FACES];
+    float queue_gap[PLAYER_GROUND_WALK_MAX_FACES];
+    int num_queued = 0;
+    int patch_start[PLAYER_GROUND_CACHE_MAX_FACES+1];
+    int num_patches = 0;
+    bool too_many_patches = false;
 
-        //Broad phase
-        //Get face's bounding sphere
-        vec3 face_sphere_center = (level_face_a+level_face_b+level_face_c)/3;
-        float face_sphere_radius = length(level_face_a-face_sphere_center);
+    for(int s=0; s<num_seeds; s++){
+        if(!insert_walk_face(visited, seeds[s])) continue; //reached from an earlier seed
+        if(++num_visited>PLAYER_GROUND_WALK_MAX_VISITED) return false;
+        float gap = face_sphere_gap(level, seeds[s], center);
+        if(gap>walk_radius) continue;
+        if(num_queued==PLAYER_GROUND_WALK_MAX_FACES) return false;
+        if(num_patches==PLAYER_GROUND_CACHE_MAX_FACES) too_many_patches = true;
+        else patch_start[num_patches++] = num_queued;
+        queue[num_queued] = seeds[s];
+        queue_gap[num_queued++] = gap;
 
-        //Sphere intersection test
-        vec3 player_to_face_vec = player_sphere_center-face_sphere_center;
-        if(length(player_to_face_vec)>face_sphere_radius + player_sphere_radius) continue;
+        //Breadth-first flood from this seed
+        for(int head=num_queued-1; head<num_queued; head++){
+            int32_t face = queue[head];
+            for(int k=0; k<3; k++){
+                uint32_t v = adj.welded_vert[level.indices[3*face+k]];
+                for(uint32_t i=adj.vert_face_start[v]; i<adj.vert_face_start[v+1]; i++){
+                    int32_t n = adj.vert_faces[i];
+                    if(!insert_walk_face(visited, n)) continue;
+                    if(++num_visited>PLAYER_GROUND_WALK_MAX_VISITED) return false;
+                    float n_gap = face_sphere_gap(level, n, center);
+                    if(n_gap>walk_radius) continue;
+                    if(num_queued==PLAYER_GROUND_WALK_MAX_FACES) return false;
+                    queue[num_queued] = n;
+                    queue_gap[num_queued++] = n_gap;
+                }
+            }
+        }
+    }
+    if(num_queued==0) return false;
+    patch_start[num_patches] = num_queued;
+
+    //Any other component near us might have faces we can't reach
+    for(uint32_t c=0; c<adj.num_components; c++){
+        vec3 closest;
+        for(int k=0; k<3; k++) closest.v[k] = CLAMP(center.v[k], adj.component_min[c].v[k], adj.component_max[c].v[k]);
+        if(length2(closest-center) > radius*radius) continue;
+        bool reached = false;
+        for(int i=0; i<num_queued && !reached; i++){
+            if(adj.face_component[queue[i]]==c) reached = true;
+        }
+        if(!reached) return false;
+    }
+
+    for(int i=0; i<num_queued; i++){
+        if(queue_gap[i]<=radius) result->faces[result->num_faces++] = queue[i];
+    }
+    qsort(result->faces, result->num_faces, sizeof(int32_t), compare_faces);
+
+    if(too_many_patches) return true;
+    int patch_seed[PLAYER_GROUND_CACHE_MAX_FACES];
+    for(int p=0; p<num_patches; p++){
+        patch_seed[p] = patch_start[p];
+        for(int i=patch_start[p]+1; i<patch_start[p+1]; i++){
+            if(queue_gap[i]<queue_gap[patch_seed[p]]) patch_seed[p] = i;
+        }
+        next_seeds->faces[next_seeds->num_faces++] = queue[patch_seed[p]];
+    }
+    for(int p=0; p<num_patches; p++){
+        for(int i=patch_start[p]; i<patch_start[p+1] && next_seeds->num_faces<PLAYER_GROUND_CACHE_MAX_FACES; i++){
+            if(i!=patch_seed[p] && queue_gap[i]<=radius) next_seeds->faces[next_seeds->num_faces++] = queue[i];
+        }
+    }
+    return true;
+}
+
+//Merge contacts with (nearly) the same normal, e.g. coplanar faces sharing an edge,
+//so they don't correct the player twice
+void reduce_player_contacts(PlayerContactSet* contacts){
+    for(int i=0; i<contacts->num_contacts; i++){
+        PlayerContact* ci = &contacts->contacts[i];
+        for(int j=i+1; j<contacts->num_contacts; j++){
+            PlayerContact* cj = &contacts->contacts[j];
+            if(dot(ci->normal, cj->normal)<PLAYER_CONTACT_MERGE_COS) continue;
+            if(cj->depth>ci->depth){
+                ci->depth = cj->depth;
+                ci->face = cj->face;
+                ci->platform = cj->platform;
+            }
+            ci->is_ground = ci->is_ground || cj->is_ground;
+            *cj = contacts->contacts[--contacts->num_contacts];
+            j--;
+        }
+    }
+}
 
-        //Narrow phase, using GJK
-        vec3 level_face_norm = normalise(cross(level_face_b-level_face_a, level_face_c-level_face_a));
-        vec3 support_point = player_collider->support(-level_face_norm);
-        float player_dist_along_norm = dot(support_point-level_face_a,level_face_norm);
-        vec3 ground_to_player_vec = level_face_norm*player_dist_along_norm;
+//Find one displacement which resolves all contacts at once
+//Iteratively projects onto each violated contact plane (dot(d, n) >= depth) until all are satisfied
+vec3 solve_player_contacts(const PlayerContactSet &contacts){
+    vec3 displacement = vec3(0,0,0);
+    for(int iterations=0; iterations<PLAYER_CONTACT_SOLVER_ITERATIONS; iterations++){
+        bool solved = true;
+        for(int i=0; i<contacts.num_contacts; i++){
+            PlayerContact c = contacts.contacts[i];
+            float error = c.depth - dot(displacement, c.normal);
+            if(error<=PLAYER_CONTACT_SOLVER_TOLERANCE) continue;
+            displacement += c.normal*error;
+            solved = false;
+        }
+        if(solved) break;
+    }
+    return displacement;
+}
 
-        TriangleCollider triangle_collider;
-        triangle_collider.pos = face_sphere_center;
-        triangle_collider.points[0] = level_face_a;
-        triangle_collider.points[1] = level_face_b;
-        triangle_collider.points[2] = level_face_c;
-        triangle_collider.normal = level_face_norm;
+//If cache is supplied (and level isn't a heightfield) only faces near the ones found last frame are tested
+void collide_player_ground(const LevelCollider &level, Capsule* player_collider, PlayerState* player, PlayerGroundCache* cache) {
+    PROFILE_FUNCTION();
+    collision_stats_begin_query();
 
-        //Check intersection
-        if(!gjk(player_collider, &triangle_collider)) continue;
+    //Carry player along with the platform they were standing on
+    if(player->platform>=0 && player->platform<level.num_platforms){
+        const Transform &platform_xform = level.platforms[player->platform].xform;
+        vec3 local_pos = inverse_transform_point(player->platform_xform, player_collider->xform.pos);
+        player_collider->xform.pos = transform_point(platform_xform, local_pos);
+        player->platform_xform = platform_xform;
+    }
 
-        bool face_is_ground = true;
-        float face_slope = RAD2DEG(acos(dot(level_face_norm, vec3(0,1,0))));
-        if(face_slope>player_max_stand_slope) face_is_ground = false;
+    //Calculate bounding sphere for player
+    float player_sphere_radius = (player_collider->y_base + player_collider->y_cap)/2;
+    vec3 player_sphere_center = transform_point(player_collider->xform, vec3(0,player_sphere_radius,0));
 
-        player_collider->pos -= ground_to_player_vec;
+    //Gather contacts from all candidate faces before moving the player,
+    //so the result doesn't depend on face order
+    PlayerContactSet contacts;
+    contacts.num_contacts = 0;
+    if(level.is_heightfield){
+        //Only test the cells under the player's bounding sphere
+        const Heightfield &hf = level.heightfield;
+        int x0 = (int)floor((player_sphere_center.x-player_sphere_radius-hf.min_x)*hf.inv_cell_size_x);
+        int x1 = (int)floor((player_sphere_center.x+player_sphere_radius-hf.min_x)*hf.inv_cell_size_x);
+        int z0 = (int)floor((player_sphere_center.z-player_sphere_radius-hf.min_z)*hf.inv_cell_size_z);
+        int z1 = (int)floor((player_sphere_center.z+player_sphere_radius-hf.min_z)*hf.inv_cell_size_z);
+        x0 = MAX(x0, 0); x1 = MIN(x1, hf.num_x-2);
+        z0 = MAX(z0, 0); z1 = MIN(z1, hf.num_z-2);
+        for(int cz=z0; cz<=z1; cz++){
+            for(int cx=x0; cx<=x1; cx++){
+                int face = 2*(cz*(hf.num_x-1) + cx);
+                gather_player_contact(level, face, player_collider, player_sphere_center, player_sphere_radius, &contacts);
+                gather_player_contact(level, face+1, player_collider, player_sphere_center, player_sphere_radius, &contacts);
+            }
+        }
+    }
+    else if(cache){
+        float search_radius = player_sphere_radius + PLAYER_GROUND_CACHE_MARGIN;
+        PlayerGroundFaces nearby;
+        if(walk_player_ground(level, cache->faces, cache->num_faces, player_sphere_center, search_radius, PLAYER_GROUND_WALK_MARGIN, &nearby, cache)){
+            COLLISION_STAT_INC(ground_cache_hits);
+        }
+        else {
+            //Full search, then seed the cache from what it found
+            COLLISION_STAT_INC(ground_cache_misses);
+            nearby.num_faces = 0;
+            bool too_many = false;
+            for(uint32_t i=0; i<level.num_faces; i++){
+                if(!face_overlaps_sphere(level, i, player_sphere_center, search_radius)) continue;
+                if(nearby.num_faces==PLAYER_GROUND_WALK_MAX_FACES){
+                    too_many = true;
+                    break;
+                }
+                nearby.faces[nearby.num_faces++] = i;
+            }
+            //Every nearby face is a seed, so this walk only sorts them into patches to pick next frame's seeds
+            //NB: If that doesn't fit, cache is left empty; arbitrarily truncated seeds could lose a patch for good
+            PlayerGroundFaces walked;
+            if(too_many || !walk_player_ground(level, nearby.faces, nearby.num_faces, player_sphere_center, search_radius, 0, &walked, cache)){
+                cache->num_faces = 0;
+            }
+            if(too_many){ //test everything
+                nearby.num_faces = 0;
+                for(uint32_t i=0; i<level.num_faces; i++){
+                    gather_player_contact(level, i, player_collider, player_sphere_center, player_sphere_radius, &contacts);
+                }
+            }
+        }
+        //Faces are in face order like the full search, so the solver sees contacts in the same order
+        for(int i=0; i<nearby.num_faces; i++){
+            gather_player_contact(level, nearby.faces[i], player_collider, player_sphere_center, player_sphere_radius, &contacts);
+        }
+    }
+    else {
+        for(uint32_t i=0; i<level.num_faces; i++){
+            gather_player_contact(level, i, player_collider, player_sphere_center, player_sphere_radius, &contacts);
+        }
+    }
 
-        //Check if it's a ground face
-        if(face_is_ground){
-            if(!player_is_on_ground) player_vel.y = 0.0f; //only kill y velocity if falling
-            hit_ground = true;
+    //Moving platforms, a chunk of faces at a time so none get dropped
+    for(int p=0; p<level.num_platforms; p++){
+        PlatformSphereQuery query;
+        begin_platform_sphere_query(level.platforms[p], player_sphere_center, player_sphere_radius, &query);
+        int32_t faces[PLAYER_PLATFORM_FACE_CHUNK];
+        int num_faces;
+        while((num_faces = next_platform_sphere_faces(level.platforms[p], &query, faces, PLAYER_PLATFORM_FACE_CHUNK))>0){
+            for(int i=0; i<num_faces; i++){
+                vec3 a, b, c;
+                get_platform_face(level.platforms[p], faces[i], &a, &b, &c);
+                gather_player_contact_face(a, b, c, faces[i], p, player_collider, player_sphere_center, player_sphere_radius, &contacts);
+            }
         }
     }
+
+    {
+        PROFILE_SCOPE("solve_player_contacts");
+        reduce_player_contacts(&contacts);
+        player_collider->xform.pos += solve_player_contacts(contacts);
+    }
+
     //If we hit any ground faces, player is on ground
-    player_is_on_ground = hit_ground;
+    //Player rides the platform of their deepest ground contact, if it's a platform
+    bool hit_ground = false;
+    float ground_depth = -FLT_MAX;
+    int ground_platform = -1;
+    for(int i=0; i<contacts.num_contacts; i++){
+        const PlayerContact &c = contacts.contacts[i];
+        if(!c.is_ground) continue;
+        hit_ground = true;
+        if(c.depth>ground_depth){
+            ground_depth = c.depth;
+            ground_platform = c.platform;
+        }
+    }
+    if(ground_platform>=0 && ground_platform!=player->platform){
+        player->platform_xform = level.platforms[ground_platform].xform;
+    }
+    player->platform = ground_platform;
+    if(hit_ground && !player->is_on_ground) player->vel.y = 0.0f; //only kill y velocity if falling
+    player->is_on_ground = hit_ground;
     if(hit_ground){ 
-        player_is_jumping = false;
+        player->is_jumping = false;
+    }
+}
+
+inline int get_ground_cell_x(const GroundGrid &grid, float x){
+    return CLAMP((int)((x-grid.min_x)*grid.inv_cell_size), 0, grid.num_cells_x-1);
+}
+inline int get_ground_cell_z(const GroundGrid &grid, float z){
+    return CLAMP((int)((z-grid.min_z)*grid.inv_cell_size), 0, grid.num_cells_z-1);
+}
+
+//Build xz grid of walkable faces for get_ground_height()
+void init_ground_grid(LevelCollider* level){
+    PROFILE_FUNCTION();
+    GroundGrid* grid = &level->ground;
+    if(level->is_heightfield){ //heightfield can look up ground directly
+        memset(grid, 0, sizeof(GroundGrid));
+        return;
+    }
+    float min_ground_normal_y = cos(DEG2RAD(player_max_stand_slope));
+
+    //Gather upward-facing walkable faces
+    grid->faces = (GroundFace*)malloc(MAX(level->num_faces, 1u)*sizeof(GroundFace));
+    grid->num_faces = 0;
+    float min_x = FLT_MAX, min_z = FLT_MAX, max_x = -FLT_MAX, max_z = -FLT_MAX;
+    for(uint32_t i=0; i<level->num_faces; i++){
+        vec3 a, b, c;
+        get_face(*level, i, &a, &b, &c);
+        vec3 norm = normalise(cross(b-a, c-a));
+        if(norm.y < min_ground_normal_y) continue;
+
+        GroundFace* gf = &grid->faces[grid->num_faces++];
+        gf->x[0] = a.x; gf->x[1] = b.x; gf->x[2] = c.x;
+        gf->z[0] = a.z; gf->z[1] = b.z; gf->z[2] = c.z;
+        gf->normal = norm;
+        gf->plane_d = dot(norm, a);
+        gf->face = i;
+
+        min_x = MIN(min_x, MIN(a.x, MIN(b.x, c.x)));
+        min_z = MIN(min_z, MIN(a.z, MIN(b.z, c.z)));
+        max_x = MAX(max_x, MAX(a.x, MAX(b.x, c.x)));
+        max_z = MAX(max_z, MAX(a.z, MAX(b.z, c.z)));
+    }
+    if(grid->num_faces==0){ min_x = min_z = max_x = max_z = 0; }
+
+    //Pick a cell size that gives roughly one face per cell
+    float extent_x = MAX(max_x-min_x, 0.001f);
+    float extent_z = MAX(max_z-min_z, 0.001f);
+    grid->cell_size = sqrt(extent_x*extent_z/MAX(grid->num_faces, 1u));
+    grid->cell_size = MAX(grid->cell_size, MAX(extent_x, extent_z)/LEVEL_GROUND_GRID_MAX_DIM);
+    grid->inv_cell_size = 1.0f/grid->cell_size;
+    grid->min_x = min_x;
+    grid->min_z = min_z;
+    grid->num_cells_x = MIN((int)(extent_x*grid->inv_cell_size)+1, LEVEL_GROUND_GRID_MAX_DIM);
+    grid->num_cells_z = MIN((int)(extent_z*grid->inv_cell_size)+1, LEVEL_GROUND_GRID_MAX_DIM);
+    int num_cells = grid->num_cells_x*grid->num_cells_z;
+
+    //Two passes: count faces per cell, then fill in face lists
+    grid->cell_start = (uint32_t*)calloc(num_cells+1, sizeof(uint32_t));
+    grid->cell_faces = NULL;
+    uint32_t* cell_fill = NULL;
+    for(int pass=0; pass<2; pass++){
+        if(pass==1){
+            for(int i=0; i<num_cells; i++) grid->cell_start[i+1] += grid->cell_start[i];
+            grid->cell_faces = (uint32_t*)malloc(MAX(grid->cell_start[num_cells], 1u)*sizeof(uint32_t));
+            cell_fill = (uint32_t*)malloc(num_cells*sizeof(uint32_t));
+            memcpy(cell_fill, grid->cell_start, num_cells*sizeof(uint32_t));
+        }
+        for(uint32_t i=0; i<grid->num_faces; i++){
+            const GroundFace &gf = grid->faces[i];
+            int x0 = get_ground_cell_x(*grid, MIN(gf.x[0], MIN(gf.x[1], gf.x[2])));
+            int x1 = get_ground_cell_x(*grid, MAX(gf.x[0], MAX(gf.x[1], gf.x[2])));
+            int z0 = get_ground_cell_z(*grid, MIN(gf.z[0], MIN(gf.z[1], gf.z[2])));
+            int z1 = get_ground_cell_z(*grid, MAX(gf.z[0], MAX(gf.z[1], gf.z[2])));
+            for(int cz=z0; cz<=z1; cz++){
+                for(int cx=x0; cx<=x1; cx++){
+                    int cell = cz*grid->num_cells_x + cx;
+                    if(pass==0) grid->cell_start[cell+1]++;
+                    else grid->cell_faces[cell_fill[cell]++] = i;
+                }
+            }
+        }
+    }
+    free(cell_fill);
+}
+
+bool get_ground_height(const LevelCollider &level, float x, float z, GroundHit* hit, float max_y){
+    const GroundGrid &grid = level.ground;
+    hit->face = -1;
+    hit->height = -FLT_MAX;
+
+    if(level.is_heightfield){
+        float height;
+        int face = get_heightfield_height(level.heightfield, x, z, &height);
+        if(face<0 || height>max_y) return false;
+        vec3 a, b, c;
+        get_heightfield_face(level.heightfield, face, &a, &b, &c);
+        vec3 norm = normalise(cross(b-a, c-a));
+        if(norm.y < cos(DEG2RAD(player_max_stand_slope))) return false;
+        hit->height = height;
+        hit->normal = norm;
+        hit->face = face;
+        return true;
+    }
+
+    if(x<grid.min_x || z<grid.min_z) return false;
+    int cx = (int)((x-grid.min_x)*grid.inv_cell_size);
+    int cz = (int)((z-grid.min_z)*grid.inv_cell_size);
+    if(cx>=grid.num_cells_x || cz>=grid.num_cells_z) return false;
+
+    int cell = cz*grid.num_cells_x + cx;
+    for(uint32_t i=grid.cell_start[cell]; i<grid.cell_start[cell+1]; i++){
+        const GroundFace &gf = grid.faces[grid.cell_faces[i]];
+
+        //2D point in triangle test
+        bool inside = true;
+        for(int e=0; e<3; e++){
+            int n = (e+1)%3;
+            float edge_x = gf.x[n]-gf.x[e];
+            float edge_z = gf.z[n]-gf.z[e];
+            if(edge_z*(x-gf.x[e]) - edge_x*(z-gf.z[e]) < -LEVEL_GROUND_EDGE_EPSILON){
+                inside = false;
+                break;
+            }
+        }
+        if(!inside) continue;
+
+        //Solve face's plane equation for y
+        float height = (gf.plane_d - gf.normal.x*x - gf.normal.z*z)/gf.normal.y;
+        if(height>max_y || height<=hit->height) continue;
+        hit->height = height;
+        hit->normal = gf.normal;
+        hit->face = gf.face;
+    }
+    return hit->face>=0;
+}
+
+int get_ground_heights(const LevelCollider &level, const vec3* points, int count, GroundHit* hits){
+    int num_hits = 0;
+    for(int i=0; i<count; i++){
+        if(get_ground_height(level, points[i].x, points[i].z, &hits[i], points[i].y)) num_hits++;
+    }
+    return num_hits;
+}
+
+bool raycast_level(const LevelCollider &level, vec3 origin, vec3 dir, float max_t, RayHit* hit){
+    PROFILE_FUNCTION();
+    hit->face = -1;
+    hit->t = max_t;
+    if(level.is_heightfield){
+        hit->face = raycast_heightfield(level.heightfield, origin, dir, max_t, &hit->t);
+    }
+    else {
+        for(uint32_t i=0; i<level.num_faces; i++){
+            vec3 a, b, c;
+            get_face(level, i, &a, &b, &c);
+            float t;
+            if(ray_triangle(origin, dir, a, b, c, &t) && t<=hit->t){
+                hit->t = t;
+                hit->face = i;
+            }
+        }
+    }
+    if(hit->face<0) return false;
+
+    vec3 a, b, c;
+    get_face(level, hit->face, &a, &b, &c);
+    hit->pos = origin + dir*hit->t;
+    hit->normal = normalise(cross(b-a, c-a));
+    return true;
+}
+
+size_t level_memory_usage(const LevelCollider &level){
+    size_t bytes = 0;
+    if(level.is_heightfield){
+        bytes += level.heightfield.num_x*level.heightfield.num_z*sizeof(float);
+    }
+    else {
+        if(level.verts) bytes += 3*level.num_verts*sizeof(float);
+        if(level.quantised_verts){
+            bytes += 3*level.num_verts*sizeof(uint16_t);
+            bytes += (level.num_verts+LEVEL_VERTEX_CLUSTER_SIZE-1)/LEVEL_VERTEX_CLUSTER_SIZE*sizeof(VertexCluster);
+        }
+        bytes += 3*level.num_faces*sizeof(uint16_t);
+        const MeshAdjacency &adj = level.adjacency;
+        bytes += level.num_verts*sizeof(uint32_t) + 3*level.num_faces*sizeof(int32_t);
+        bytes += (adj.num_welded_verts+1)*sizeof(uint32_t) + 3*level.num_faces*sizeof(uint32_t);
+        bytes += level.num_faces*sizeof(uint32_t) + 2*adj.num_components*sizeof(vec3);
+    }
+    const GroundGrid &grid = level.ground;
+    if(grid.cell_start){ //heightfields have no grid
+        int num_cells = grid.num_cells_x*grid.num_cells_z;
+        bytes += grid.num_faces*sizeof(GroundFace);
+        bytes += (num_cells+1)*sizeof(uint32_t) + grid.cell_start[num_cells]*sizeof(uint32_t);
+    }
+    for(int i=0; i<level.num_platforms; i++){
+        const Platform &platform = level.platforms[i];
+        bytes += platform.num_verts*(3*sizeof(float) + sizeof(vec3)) + 3*platform.num_faces*sizeof(uint16_t);
+        bytes += platform.num_nodes*sizeof(PlatformNode) + platform.num_faces*sizeof(uint32_t);
     }
+    return bytes;
 }
 
 void clear_level(LevelCollider* level){
     free(level->verts);
     free(level->indices);
+    free(level->quantised_verts);
+    free(level->clusters);
+    free_mesh_adjacency(&level->adjacency);
+    for(int i=0; i<level->num_platforms; i++) clear_platform(&level->platforms[i]);
+    free(level->platforms);
+    level->platforms = NULL;
+    level->num_platforms = 0;
+    if(level->is_heightfield) free(level->heightfield.heights);
+    free(level->ground.faces);
+    free(level->ground.cell_start);
+    free(level->ground.cell_faces);
     level->num_faces = -1;
 }
@@ -0,0 +1,284 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "GameMaths.h"
+#include "Level.h"
+#include "load_obj.h"
+#include "Profiler.h"
+
+//Level split into square tiles on the xz plane, each its own LevelCollider (in world space)
+//update_level_streaming() is called once per tick with agent positions:
+// - tiles within load_radius of an agent are requested, and loaded on a background thread
+// - finished tiles become visible to queries the next time update_level_streaming() runs
+// - while resident memory is over budget, least recently needed tiles are evicted
+//The sim thread never waits on a load; a tile that isn't in yet just isn't there (queries return NULL)
+//Loads run on their own thread rather than the job system: job_wait() runs whatever is queued,
+//so a tile load could end up blocking the sim thread inside a parallel_for
+
+#define LEVEL_STREAMING_MAX_REQUESTS 256 //pending loads, more than this are requested again next tick
+
+//Runs on the loader thread. Fill in level for tile (tile_x, tile_z), return false if it doesn't exist
+typedef bool (*TileLoadFunction)(int32_t tile_x, int32_t tile_z, LevelCollider* level, void* user_data);
+
+enum StreamTileState {
+	TILE_EMPTY,		//slot unused
+	TILE_LOADING,	//owned by loader thread
+	TILE_LOADED,
+	TILE_MISSING,	//loader returned false, kept so it isn't requested every tick
+};
+
+struct StreamTile {
+	int32_t tile_x, tile_z;
+	std::atomic<int> state;
+	LevelCollider level;
+	size_t memory;				//level_memory_usage(), set when tile is first seen loaded
+	uint64_t last_needed;		//tick an agent was last in range
+	bool counted;				//memory has been added to streamer's total
+};
+
+struct LevelStreamer {
+	float tile_size, inv_tile_size;
+	float load_radius;			//load tiles within this distance of an agent
+	size_t memory_budget;		//bytes
+	size_t memory_used;			//bytes in loaded tiles
+	StreamTile* tiles;
+	int max_tiles;
+	uint64_t tick;
+	TileLoadFunction load_function;
+	void* user_data;
+	uint64_t* needed_keys;		//scratch for update
+
+	//Loader thread and its queue of tile slots to load
+	std::thread loader;
+	std::mutex mutex;
+	std::condition_variable cv;
+	int requests[LEVEL_STREAMING_MAX_REQUESTS];
+	uint32_t request_head, request_tail;
+	bool quit;
+};
+
+//max_tiles: slots for resident + loading tiles, should comfortably exceed the tiles in range of all agents
+//load_function = NULL uses load_level_tile_obj, which loads "tile_<x>_<z>.obj"
+void init_level_streamer(LevelStreamer* streamer, float tile_size, float load_radius, size_t memory_budget, int max_tiles, TileLoadFunction load_function=NULL, void* user_data=NULL);
+//Stops loader thread (waiting for the current load) and frees every tile
+void clear_level_streamer(LevelStreamer* streamer);
+//Request tiles near agents, pick up finished loads, evict over budget. Call once per tick on the sim thread
+void update_level_streaming(LevelStreamer* streamer, const vec3* agent_positions, int num_agents);
+//Loaded tiles overlapping the xz square of half-size radius around pos, returns how many (at most max_results)
+int get_streamed_tiles(const LevelStreamer &streamer, vec3 pos, float radius, const LevelCollider** results, int max_results);
+//Default loader
+bool load_level_tile_obj(int32_t tile_x, int32_t tile_z, LevelCollider* level, void* user_data);
+
+inline int32_t get_tile_coord(const LevelStreamer &streamer, float f){
+	return (int32_t)floorf(f*streamer.inv_tile_size);
+}
+
+inline uint64_t get_tile_key(int32_t tile_x, int32_t tile_z){
+	return ((uint64_t)(uint32_t)tile_x << 32) | (uint32_t)tile_z;
+}
+
+bool load_level_tile_obj(int32_t tile_x, int32_t tile_z, LevelCollider* level, void* user_data){
+	char file_name[64];
+	snprintf(file_name, sizeof(file_name), "tile_%d_%d.obj", tile_x, tile_z);
+	float* vp;
+	uint16_t* indices;
+	uint32_t num_verts, num_indices;
+	if(!load_obj_indexed(file_name, &vp, &indices, &num_verts, &num_indices)) return false;
+	*level = init_level(vp, indices, num_verts, num_indices);
+	return true;
+}
+
+static void level_streamer_loader_main(LevelStreamer* streamer){
+	profiler_set_thread_name("tile loader");
+	while(true){
+		int slot;
+		{
+			std::unique_lock<std::mutex> lock(streamer->mutex);
+			streamer->cv.wait(lock, [streamer]{ return streamer->quit || streamer->request_head!=streamer->request_tail; });
+			if(streamer->quit) return;
+			slot = streamer->requests[streamer->request_head%LEVEL_STREAMING_MAX_REQUESTS];
+			streamer->request_head++;
+		}
+		StreamTile* tile = &streamer->tiles[slot];
+		PROFILE_SCOPE("load tile");
+		bool found = streamer->load_function(tile->tile_x, tile->tile_z, &tile->level, streamer->user_data);
+		tile->state.store(found ? TILE_LOADED : TILE_MISSING, std::memory_order_release);
+	}
+}
+
+void init_level_streamer(LevelStreamer* streamer, float tile_size, float load_radius, size_t memory_budget, int max_tiles, TileLoadFunction load_function, void* user_data){
+	streamer->tile_size = tile_size;
+	streamer->inv_tile_size = 1.0f/tile_size;
+	streamer->load_radius = load_radius;
+	streamer->memory_budget = memory_budget;
+	streamer->memory_used = 0;
+	streamer->tiles = new StreamTile[max_tiles];
+	for(int i=0; i<max_tiles; i++){
+		streamer->tiles[i].state.store(TILE_EMPTY);
+		streamer->tiles[i].last_needed = 0;
+		streamer->tiles[i].counted = false;
+	}
+	streamer->max_tiles = max_tiles;
+	streamer->tick = 0;
+	streamer->load_function = load_function ? load_function : load_level_tile_obj;
+	streamer->user_data = user_data;
+	streamer->needed_keys = NULL;
+	streamer->request_head = streamer->request_tail = 0;
+	streamer->quit = false;
+	streamer->loader = std::thread(level_streamer_loader_main, streamer);
+}
+
+void clear_level_streamer(LevelStreamer* streamer){
+	{
+		std::lock_guard<std::mutex> lock(streamer->mutex);
+		streamer->quit = true;
+	}
+	streamer->cv.notify_all();
+	streamer->loader.join();
+	for(int i=0; i<streamer->max_tiles; i++){
+		if(streamer->tiles[i].state.load()==TILE_LOADED) clear_level(&streamer->tiles[i].level);
+	}
+	delete[] streamer->tiles;
+	free(streamer->needed_keys);
+	streamer->tiles = NULL;
+	streamer->needed_keys = NULL;
+	streamer->max_tiles = 0;
+	streamer->memory_used = 0;
+}
+
+static int compare_tile_keys(const void* a, const void* b){
+	uint64_t ka = *(const uint64_t*)a, kb = *(const uint64_t*)b;
+	return (ka>kb) - (ka<kb);
+}
+
+static int find_stream_tile(const LevelStreamer &streamer, int32_t tile_x, int32_t tile_z){
+	for(int i=0; i<streamer.max_tiles; i++){
+		const StreamTile &tile = streamer.tiles[i];
+		if(tile.state.load(std::memory_order_relaxed)!=TILE_EMPTY && tile.tile_x==tile_x && tile.tile_z==tile_z) return i;
+	}
+	return -1;
+}
+
+//Slot for a new tile: an empty one, or failing that the least recently needed tile that isn't needed this tick
+static int get_free_stream_tile(LevelStreamer* streamer){
+	int oldest = -1;
+	for(int i=0; i<streamer->max_tiles; i++){
+		StreamTile* tile = &streamer->tiles[i];
+		int state = tile->state.load(std::memory_order_acquire);
+		if(state==TILE_EMPTY) return i;
+		if(state==TILE_LOADING || tile->last_needed==streamer->tick) continue;
+		if(oldest<0 || tile->last_needed<streamer->tiles[oldest].last_needed) oldest = i;
+	}
+	return oldest;
+}
+
+static void evict_stream_tile(LevelStreamer* streamer, StreamTile* tile){
+	if(tile->state.load(std::memory_order_acquire)==TILE_LOADED) clear_level(&tile->level);
+	if(tile->counted) streamer->memory_used -= tile->memory;
+	tile->counted = false;
+	tile->state.store(TILE_EMPTY, std::memory_order_relaxed);
+}
+
+void update_level_streaming(LevelStreamer* streamer, const vec3* agent_positions, int num_agents){
+	PROFILE_FUNCTION();
+	streamer->tick++;
+
+	//Pick up tiles the loader finished since last tick
+	for(int i=0; i<streamer->max_tiles; i++){
+		StreamTile* tile = &streamer->tiles[i];
+		if(tile->counted || tile->state.load(std::memory_order_acquire)!=TILE_LOADED) continue;
+		tile->memory = level_memory_usage(tile->level);
+		tile->counted = true;
+		streamer->memory_used += tile->memory;
+	}
+
+	//Tiles in range of each agent, sorted so each is handled once however many agents need it
+	int tiles_per_agent = (int)(2*streamer->load_radius*streamer->inv_tile_size) + 2;
+	tiles_per_agent *= tiles_per_agent;
+	streamer->needed_keys = (uint64_t*)realloc(streamer->needed_keys, MAX(num_agents*tiles_per_agent, 1)*sizeof(uint64_t));
+	int num_keys = 0;
+	for(int a=0; a<num_agents; a++){
+		const vec3 &p = agent_positions[a];
+		int32_t x0 = get_tile_coord(*streamer, p.v[0]-streamer->load_radius);
+		int32_t x1 = get_tile_coord(*streamer, p.v[0]+streamer->load_radius);
+		int32_t z0 = get_tile_coord(*streamer, p.v[2]-streamer->load_radius);
+		int32_t z1 = get_tile_coord(*streamer, p.v[2]+streamer->load_radius);
+		for(int32_t z=z0; z<=z1; z++)
+		for(int32_t x=x0; x<=x1; x++){
+			streamer->needed_keys[num_keys++] = get_tile_key(x, z);
+		}
+	}
+	qsort(streamer->needed_keys, num_keys, sizeof(uint64_t), compare_tile_keys);
+
+	//Mark every needed tile first, so requesting new ones below can't evict a tile that's needed this tick
+	int num_unique = 0;
+	for(int i=0; i<num_keys; i++){
+		if(i>0 && streamer->needed_keys[i]==streamer->needed_keys[i-1]) continue;
+		uint64_t key = streamer->needed_keys[i];
+		streamer->needed_keys[num_unique++] = key;
+		int slot = find_stream_tile(*streamer, (int32_t)(key>>32), (int32_t)(uint32_t)key);
+		if(slot>=0) streamer->tiles[slot].last_needed = streamer->tick;
+	}
+
+	for(int i=0; i<num_unique; i++){
+		int32_t tile_x = (int32_t)(streamer->needed_keys[i]>>32);
+		int32_t tile_z = (int32_t)(uint32_t)streamer->needed_keys[i];
+		if(find_stream_tile(*streamer, tile_x, tile_z)>=0) continue;
+
+		std::unique_lock<std::mutex> lock(streamer->mutex);
+		if(streamer->request_tail-streamer->request_head==LEVEL_STREAMING_MAX_REQUESTS) break; //try again next tick
+		lock.unlock();
+
+		int slot = get_free_stream_tile(streamer);
+		if(slot<0){
+			printf("Warning: level streamer has no free tile slots, %d tiles needed\n", num_unique);
+			break;
+		}
+		StreamTile* tile = &streamer->tiles[slot];
+		evict_stream_tile(streamer, tile);
+		tile->tile_x = tile_x;
+		tile->tile_z = tile_z;
+		tile->last_needed = streamer->tick;
+		tile->memory = 0;
+		tile->state.store(TILE_LOADING, std::memory_order_relaxed);
+
+		lock.lock();
+		streamer->requests[streamer->request_tail%LEVEL_STREAMING_MAX_REQUESTS] = slot;
+		streamer->request_tail++;
+		lock.unlock();
+		streamer->cv.notify_one();
+	}
+
+	//Over budget: evict least recently needed tiles, never ones needed this tick
+	while(streamer->memory_used>streamer->memory_budget){
+		int oldest = -1;
+		for(int i=0; i<streamer->max_tiles; i++){
+			const StreamTile &tile = streamer->tiles[i];
+			if(!tile.counted || tile.last_needed==streamer->tick) continue;
+			if(oldest<0 || tile.last_needed<streamer->tiles[oldest].last_needed) oldest = i;
+		}
+		if(oldest<0) break; //everything resident is in use, budget is too small for the agents' spread
+		evict_stream_tile(streamer, &streamer->tiles[oldest]);
+	}
+}
+
+int get_streamed_tiles(const LevelStreamer &streamer, vec3 pos, float radius, const LevelCollider** results, int max_results){
+	int num_results = 0;
+	int32_t x0 = get_tile_coord(streamer, pos.v[0]-radius);
+	int32_t x1 = get_tile_coord(streamer, pos.v[0]+radius);
+	int32_t z0 = get_tile_coord(streamer, pos.v[2]-radius);
+	int32_t z1 = get_tile_coord(streamer, pos.v[2]+radius);
+	for(int i=0; i<streamer.max_tiles && num_results<max_results; i++){
+		const StreamTile &tile = streamer.tiles[i];
+		//Only tiles update_level_streaming() has seen finish, so results don't change between ticks
+		if(!tile.counted) continue;
+		if(tile.tile_x<x0 || tile.tile_x>x1 || tile.tile_z<z0 || tile.tile_z>z1) continue;
+		results[num_results++] = &tile.level;
+	}
+	return num_results;
+}
@@ -0,0 +1,184 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include "GameMaths.h"
+
+//Topology of a triangle mesh, built in linear time with open-addressing hash tables
+//load_obj splits vertices that have different normals, so vertices are welded by position first
+//Edge e of a face runs from its vertex e to vertex (e+1)%3
+
+struct MeshAdjacency {
+	uint32_t num_welded_verts;
+	uint32_t* welded_vert;		//vertex index -> welded vertex index (verts at the same position share one)
+	int32_t* face_neighbours;	//3 per face: face across edge e, -1 for boundary edges
+	uint32_t* vert_face_start;	//num_welded_verts+1 offsets into vert_faces
+	uint32_t* vert_faces;		//faces touching each welded vertex
+	uint32_t num_components;
+	uint32_t* face_component;	//connected component of each face (faces sharing a vertex are connected)
+	vec3* component_min;		//bounds of each component
+	vec3* component_max;
+};
+
+MeshAdjacency build_mesh_adjacency(const float* verts, const uint16_t* indices, uint32_t num_verts, uint32_t num_faces);
+void free_mesh_adjacency(MeshAdjacency* adjacency);
+
+#define MESH_HASH_EMPTY 0xFFFFFFFF
+
+inline uint32_t hash_u32(uint32_t x){
+	//lowbias32 by Chris Wellons
+	x ^= x >> 16;
+	x *= 0x7feb352d;
+	x ^= x >> 15;
+	x *= 0x846ca68b;
+	x ^= x >> 16;
+	return x;
+}
+
+//Smallest power of two >= 2*n, so tables stay at most half full
+static uint32_t mesh_hash_table_size(uint32_t n){
+	uint32_t size = 16;
+	while(size < 2*n) size *= 2;
+	return size;
+}
+
+static uint32_t float_bits(float f){
+	if(f == 0.0f) f = 0.0f; //-0 and 0 should weld
+	uint32_t bits;
+	memcpy(&bits, &f, sizeof(bits));
+	return bits;
+}
+
+static uint32_t find_root(uint32_t* parent, uint32_t i){
+	while(parent[i] != i){
+		parent[i] = parent[parent[i]]; //path halving
+		i = parent[i];
+	}
+	return i;
+}
+
+MeshAdjacency build_mesh_adjacency(const float* verts, const uint16_t* indices, uint32_t num_verts, uint32_t num_faces){
+	MeshAdjacency adj;
+
+	//Weld vertices by exact position
+	adj.welded_vert = (uint32_t*)malloc(MAX(num_verts, 1u)*sizeof(uint32_t));
+	adj.num_welded_verts = 0;
+	{
+		uint32_t table_size = mesh_hash_table_size(num_verts);
+		uint32_t* table = (uint32_t*)malloc(table_size*sizeof(uint32_t)); //stores a vertex index
+		memset(table, 0xFF, table_size*sizeof(uint32_t));
+		for(uint32_t i=0; i<num_verts; i++){
+			const float* p = &verts[3*i];
+			uint32_t h = hash_u32(float_bits(p[0]) ^ hash_u32(float_bits(p[1]) ^ hash_u32(float_bits(p[2]))));
+			uint32_t slot = h & (table_size-1);
+			while(table[slot] != MESH_HASH_EMPTY){
+				const float* q = &verts[3*table[slot]];
+				if(p[0]==q[0] && p[1]==q[1] && p[2]==q[2]) break;
+				slot = (slot+1) & (table_size-1);
+			}
+			if(table[slot] == MESH_HASH_EMPTY){
+				table[slot] = i;
+				adj.welded_vert[i] = adj.num_welded_verts++;
+			}
+			else adj.welded_vert[i] = adj.welded_vert[table[slot]];
+		}
+		free(table);
+	}
+
+	//Edge adjacency: insert every directed edge (a,b), then pair it with its twin (b,a)
+	adj.face_neighbours = (int32_t*)malloc(MAX(3*num_faces, 1u)*sizeof(int32_t));
+	for(uint32_t i=0; i<3*num_faces; i++) adj.face_neighbours[i] = -1;
+	{
+		uint32_t table_size = mesh_hash_table_size(3*num_faces);
+		uint32_t* table = (uint32_t*)malloc(table_size*sizeof(uint32_t)); //stores face*3+edge
+		memset(table, 0xFF, table_size*sizeof(uint32_t));
+		#define EDGE_VERT(half_edge, k) adj.welded_vert[indices[3*((half_edge)/3) + ((half_edge)%3 + (k))%3]]
+		for(uint32_t he=0; he<3*num_faces; he++){
+			uint32_t a = EDGE_VERT(he, 0), b = EDGE_VERT(he, 1);
+			if(a == b) continue; //degenerate
+			uint32_t slot = hash_u32(a*0x9E3779B1u ^ b) & (table_size-1);
+			while(table[slot] != MESH_HASH_EMPTY) slot = (slot+1) & (table_size-1);
+			table[slot] = he;
+		}
+		for(uint32_t he=0; he<3*num_faces; he++){
+			if(adj.face_neighbours[he] >= 0) continue;
+			uint32_t a = EDGE_VERT(he, 0), b = EDGE_VERT(he, 1);
+			if(a == b) continue;
+			//Look for an unpaired twin on another face (non-manifold edges pair up first come first served)
+			uint32_t slot = hash_u32(b*0x9E3779B1u ^ a) & (table_size-1);
+			while(table[slot] != MESH_HASH_EMPTY){
+				uint32_t twin = table[slot];
+				if(EDGE_VERT(twin, 0)==b && EDGE_VERT(twin, 1)==a && twin/3 != he/3 && adj.face_neighbours[twin] < 0){
+					adj.face_neighbours[he] = twin/3;
+					adj.face_neighbours[twin] = he/3;
+					break;
+				}
+				slot = (slot+1) & (table_size-1);
+			}
+		}
+		#undef EDGE_VERT
+		free(table);
+	}
+
+	//Vertex adjacency: faces touching each welded vertex, counted then filled
+	adj.vert_face_start = (uint32_t*)calloc(adj.num_welded_verts+1, sizeof(uint32_t));
+	for(uint32_t i=0; i<3*num_faces; i++) adj.vert_face_start[adj.welded_vert[indices[i]]+1]++;
+	for(uint32_t i=0; i<adj.num_welded_verts; i++) adj.vert_face_start[i+1] += adj.vert_face_start[i];
+	adj.vert_faces = (uint32_t*)malloc(MAX(3*num_faces, 1u)*sizeof(uint32_t));
+	{
+		uint32_t* fill = (uint32_t*)malloc(MAX(adj.num_welded_verts, 1u)*sizeof(uint32_t));
+		memcpy(fill, adj.vert_face_start, adj.num_welded_verts*sizeof(uint32_t));
+		for(uint32_t i=0; i<3*num_faces; i++) adj.vert_faces[fill[adj.welded_vert[indices[i]]]++] = i/3;
+		free(fill);
+	}
+
+	//Connected components: union faces that share a vertex
+	adj.face_component = (uint32_t*)malloc(MAX(num_faces, 1u)*sizeof(uint32_t));
+	adj.num_components = 0;
+	{
+		uint32_t* parent = (uint32_t*)malloc(MAX(num_faces, 1u)*sizeof(uint32_t));
+		for(uint32_t i=0; i<num_faces; i++) parent[i] = i;
+		for(uint32_t v=0; v<adj.num_welded_verts; v++){
+			for(uint32_t i=adj.vert_face_start[v]+1; i<adj.vert_face_start[v+1]; i++){
+				uint32_t r0 = find_root(parent, adj.vert_faces[adj.vert_face_start[v]]);
+				uint32_t r1 = find_root(parent, adj.vert_faces[i]);
+				if(r0 != r1) parent[r1] = r0;
+			}
+		}
+		//Number roots in face order, then give every face its root's number
+		for(uint32_t i=0; i<num_faces; i++){
+			if(parent[i] == i) adj.face_component[i] = adj.num_components++;
+		}
+		for(uint32_t i=0; i<num_faces; i++) adj.face_component[i] = adj.face_component[find_root(parent, i)];
+		free(parent);
+	}
+
+	adj.component_min = (vec3*)malloc(MAX(adj.num_components, 1u)*sizeof(vec3));
+	adj.component_max = (vec3*)malloc(MAX(adj.num_components, 1u)*sizeof(vec3));
+	for(uint32_t c=0; c<adj.num_components; c++){
+		adj.component_min[c] = vec3(FLT_MAX, FLT_MAX, FLT_MAX);
+		adj.component_max[c] = vec3(-FLT_MAX, -FLT_MAX, -FLT_MAX);
+	}
+	for(uint32_t i=0; i<3*num_faces; i++){
+		uint32_t c = adj.face_component[i/3];
+		const float* p = &verts[3*indices[i]];
+		for(int k=0; k<3; k++){
+			adj.component_min[c].v[k] = MIN(adj.component_min[c].v[k], p[k]);
+			adj.component_max[c].v[k] = MAX(adj.component_max[c].v[k], p[k]);
+		}
+	}
+
+	return adj;
+}
+
+void free_mesh_adjacency(MeshAdjacency* adj){
+	free(adj->welded_vert);
+	free(adj->face_neighbours);
+	free(adj->vert_face_start);
+	free(adj->vert_faces);
+	free(adj->face_component);
+	free(adj->component_min);
+	free(adj->component_max);
+	memset(adj, 0, sizeof(MeshAdjacency));
+}
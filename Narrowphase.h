@@ -0,0 +1,155 @@
+#pragma once
+#include <math.h>
+#include <float.h>
+#include "GameMaths.h"
+#include "Collider.h"
+#include "CollisionStats.h"
+#include "GJK.h"
+
+//Picks the cheapest test for a pair of colliders by their types:
+//closed-form tests for sphere-sphere, sphere-triangle and box-triangle, GJK (+EPA) for everything else
+//mtv follows gjk()'s convention: move coll1 by mtv to separate it from coll2
+
+bool collide(Collider* coll1, Collider* coll2, vec3* mtv=NULL);
+//Closest point to p on triangle abc
+vec3 closest_point_on_triangle(vec3 p, vec3 a, vec3 b, vec3 c);
+
+#define COLLIDER_PAIR(type1, type2) ((type1)*NUM_COLLIDER_TYPES + (type2))
+
+//Sphere tests only work on actual spheres
+inline bool has_uniform_scale(const Collider* coll){
+    return coll->xform.scale.x==coll->xform.scale.y && coll->xform.scale.y==coll->xform.scale.z;
+}
+
+//From Real-Time Collision Detection (Ericson) 5.1.5
+vec3 closest_point_on_triangle(vec3 p, vec3 a, vec3 b, vec3 c){
+    vec3 ab = b-a, ac = c-a, ap = p-a;
+    float d1 = dot(ab, ap), d2 = dot(ac, ap);
+    if(d1<=0 && d2<=0) return a;
+
+    vec3 bp = p-b;
+    float d3 = dot(ab, bp), d4 = dot(ac, bp);
+    if(d3>=0 && d4<=d3) return b;
+
+    float vc = d1*d4 - d3*d2;
+    if(vc<=0 && d1>=0 && d3<=0) return a + ab*(d1/(d1-d3));
+
+    vec3 cp = p-c;
+    float d5 = dot(ab, cp), d6 = dot(ac, cp);
+    if(d6>=0 && d5<=d6) return c;
+
+    float vb = d5*d2 - d1*d6;
+    if(vb<=0 && d2>=0 && d6<=0) return a + ac*(d2/(d2-d6));
+
+    float va = d3*d6 - d5*d4;
+    if(va<=0 && (d4-d3)>=0 && (d5-d6)>=0) return b + (c-b)*((d4-d3)/((d4-d3)+(d5-d6)));
+
+    float denom = 1/(va+vb+vc);
+    return a + ab*(vb*denom) + ac*(vc*denom);
+}
+
+static bool collide_sphere_sphere(Sphere* s1, Sphere* s2, vec3* mtv){
+    vec3 d = s1->xform.pos - s2->xform.pos;
+    float r = s1->r*s1->xform.scale.x + s2->r*s2->xform.scale.x;
+    float dist2 = dot(d, d);
+    if(dist2>r*r) return false;
+    if(mtv){
+        float dist = sqrtf(dist2);
+        *mtv = (dist>0) ? d*((r-dist)/dist) : vec3(0, r, 0); //concentric, any direction will do
+    }
+    return true;
+}
+
+static bool collide_sphere_triangle(Sphere* sphere, TriangleCollider* triangle, vec3* mtv){
+    vec3 center = sphere->xform.pos;
+    float r = sphere->r*sphere->xform.scale.x;
+    vec3 closest = closest_point_on_triangle(center, triangle->points[0], triangle->points[1], triangle->points[2]);
+    vec3 d = center - closest;
+    float dist2 = dot(d, d);
+    if(dist2>r*r) return false;
+    if(mtv){
+        float dist = sqrtf(dist2);
+        if(dist>0) *mtv = d*((r-dist)/dist);
+        else *mtv = triangle->normal*r; //centre on triangle, push out along normal
+    }
+    return true;
+}
+
+//Separating axis test with the triangle moved into box space, where the box is an AABB
+//13 axes: 3 box faces, triangle normal, 9 edge-edge cross products
+static bool collide_box_triangle(Box* box, TriangleCollider* triangle, vec3* mtv){
+    vec3 h = vec3(box->half_extents.x*box->xform.scale.x, box->half_extents.y*box->xform.scale.y, box->half_extents.z*box->xform.scale.z);
+    versor inv_rot = conjugate(box->xform.rot);
+    vec3 v[3];
+    for(int i=0; i<3; i++) v[i] = rotate(inv_rot, triangle->points[i] - box->xform.pos);
+    vec3 e[3] = { v[1]-v[0], v[2]-v[1], v[0]-v[2] };
+
+    vec3 axes[13];
+    int num_axes = 0;
+    axes[num_axes++] = vec3(1,0,0);
+    axes[num_axes++] = vec3(0,1,0);
+    axes[num_axes++] = vec3(0,0,1);
+    axes[num_axes++] = cross(e[0], e[1]);
+    for(int i=0; i<3; i++){
+        vec3 box_axis = vec3(0,0,0);
+        box_axis.v[i] = 1;
+        for(int j=0; j<3; j++) axes[num_axes++] = cross(box_axis, e[j]);
+    }
+
+    float min_overlap = FLT_MAX;
+    vec3 min_axis = vec3(0,0,0);
+    for(int i=0; i<num_axes; i++){
+        float len2 = dot(axes[i], axes[i]);
+        if(len2<1e-12f) continue; //parallel edges, covered by another axis
+        vec3 axis = axes[i]/sqrtf(len2);
+        float box_radius = h.x*fabsf(axis.x) + h.y*fabsf(axis.y) + h.z*fabsf(axis.z);
+        float p0 = dot(v[0], axis), p1 = dot(v[1], axis), p2 = dot(v[2], axis);
+        float tri_min = MIN(p0, MIN(p1, p2));
+        float tri_max = MAX(p0, MAX(p1, p2));
+        if(tri_min>box_radius || tri_max<-box_radius) return false;
+
+        //Push box whichever way along the axis is shorter
+        float push_neg = box_radius - tri_min; //move box by -axis*push_neg
+        float push_pos = tri_max + box_radius; //move box by +axis*push_pos
+        if(push_neg<min_overlap){
+            min_overlap = push_neg;
+            min_axis = -axis;
+        }
+        if(push_pos<min_overlap){
+            min_overlap = push_pos;
+            min_axis = axis;
+        }
+    }
+    if(mtv) *mtv = rotate(box->xform.rot, min_axis*min_overlap);
+    return true;
+}
+
+bool collide(Collider* coll1, Collider* coll2, vec3* mtv){
+    bool hit;
+    switch(COLLIDER_PAIR(coll1->type, coll2->type)){
+        case COLLIDER_PAIR(COLLIDER_SPHERE, COLLIDER_SPHERE):
+            if(!has_uniform_scale(coll1) || !has_uniform_scale(coll2)) break;
+            COLLISION_STAT_INC(closed_form_tests);
+            return collide_sphere_sphere((Sphere*)coll1, (Sphere*)coll2, mtv);
+        case COLLIDER_PAIR(COLLIDER_SPHERE, COLLIDER_TRIANGLE):
+            if(!has_uniform_scale(coll1)) break;
+            COLLISION_STAT_INC(closed_form_tests);
+            return collide_sphere_triangle((Sphere*)coll1, (TriangleCollider*)coll2, mtv);
+        case COLLIDER_PAIR(COLLIDER_TRIANGLE, COLLIDER_SPHERE):
+            if(!has_uniform_scale(coll2)) break;
+            COLLISION_STAT_INC(closed_form_tests);
+            hit = collide_sphere_triangle((Sphere*)coll2, (TriangleCollider*)coll1, mtv);
+            if(hit && mtv) *mtv = -*mtv;
+            return hit;
+        case COLLIDER_PAIR(COLLIDER_BOX, COLLIDER_TRIANGLE):
+            COLLISION_STAT_INC(closed_form_tests);
+            return collide_box_triangle((Box*)coll1, (TriangleCollider*)coll2, mtv);
+        case COLLIDER_PAIR(COLLIDER_TRIANGLE, COLLIDER_BOX):
+            COLLISION_STAT_INC(closed_form_tests);
+            hit = collide_box_triangle((Box*)coll2, (TriangleCollider*)coll1, mtv);
+            if(hit && mtv) *mtv = -*mtv;
+            return hit;
+        default: break;
+    }
+    return gjk(coll1, coll2, mtv);
+}
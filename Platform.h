@@ -0,0 +1,220 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include "GameMaths.h"
+#include "Collider.h"
+
+//Moving level geometry (lifts, rotating platforms): a triangle mesh with its own transform
+//The BVH is built once over the mesh; when the platform moves its verts are re-transformed
+//and node bounds are refitted bottom-up in O(n), without rebuilding the tree
+
+#define PLATFORM_BVH_MAX_LEAF_FACES 4
+#define PLATFORM_BVH_MAX_DEPTH 64
+
+struct PlatformNode {
+	AABB bounds;		//world space
+	uint32_t first;		//leaf: first index into face_order, internal: index of left child (right is first+1)
+	uint32_t count;		//number of faces in leaf, 0 for internal nodes
+};
+
+struct Platform {
+	float* local_verts;		//model space, 3 floats per vertex
+	vec3* world_verts;		//local_verts transformed by xform
+	uint16_t* indices;
+	uint32_t num_verts;
+	uint32_t num_faces;
+	Transform xform;
+	PlatformNode* nodes;	//children are always stored after their parent
+	uint32_t num_nodes;
+	uint32_t* face_order;	//faces sorted so each leaf's faces are contiguous
+};
+
+//Sphere query in progress, so faces can be gathered a chunk at a time into a small buffer
+struct PlatformSphereQuery {
+	vec3 center;
+	float radius;
+	uint32_t stack[PLATFORM_BVH_MAX_DEPTH+2];
+	int stack_size;
+	uint32_t leaf_first;	//faces of the current leaf still to write out
+	uint32_t leaf_count;
+};
+
+//Create a platform from model-space vertex data. Takes ownership of vp and indices (must be malloc'd)
+Platform init_platform(float* vp, uint16_t* indices, uint32_t vert_count, uint32_t index_count, Transform xform);
+//Move platform: re-transforms verts and refits BVH
+void set_platform_transform(Platform* platform, Transform xform);
+void get_platform_face(const Platform &platform, int face, vec3* p0, vec3* p1, vec3* p2);
+void begin_platform_sphere_query(const Platform &platform, vec3 center, float radius, PlatformSphereQuery* query);
+//Writes up to max_faces more faces whose bounds overlap the query's sphere, returns how many (0 once there are none left)
+int next_platform_sphere_faces(const Platform &platform, PlatformSphereQuery* query, int32_t* faces, int max_faces);
+//Writes faces whose bounds overlap sphere, returns how many (at most max_faces, use the functions above for the rest)
+int query_platform_sphere(const Platform &platform, vec3 center, float radius, int32_t* faces, int max_faces);
+void clear_platform(Platform* platform);
+
+static AABB get_platform_face_bounds(const Platform &platform, uint32_t face){
+    AABB box;
+    box.min = box.max = platform.world_verts[platform.indices[3*face]];
+    for(int k=1; k<3; k++){
+        const vec3 &p = platform.world_verts[platform.indices[3*face+k]];
+        for(int a=0; a<3; a++){
+            box.min.v[a] = MIN(box.min.v[a], p.v[a]);
+            box.max.v[a] = MAX(box.max.v[a], p.v[a]);
+        }
+    }
+    return box;
+}
+
+//qsort has no context pointer
+static thread_local const vec3* g_platform_sort_centroids;
+static thread_local int g_platform_sort_axis;
+static int compare_platform_centroids(const void* a, const void* b){
+    float ca = g_platform_sort_centroids[*(const uint32_t*)a].v[g_platform_sort_axis];
+    float cb = g_platform_sort_centroids[*(const uint32_t*)b].v[g_platform_sort_axis];
+    return (ca>cb) - (ca<cb);
+}
+
+//Median split on the longest axis of the face centroids
+static void build_platform_node(Platform* platform, uint32_t node_index, uint32_t first, uint32_t count, const vec3* centroids, int depth){
+    PlatformNode* node = &platform->nodes[node_index];
+    if(count<=PLATFORM_BVH_MAX_LEAF_FACES || depth>=PLATFORM_BVH_MAX_DEPTH){
+        node->first = first;
+        node->count = count;
+        return;
+    }
+
+    vec3 cmin = centroids[platform->face_order[first]];
+    vec3 cmax = cmin;
+    for(uint32_t i=first+1; i<first+count; i++){
+        const vec3 &c = centroids[platform->face_order[i]];
+        for(int a=0; a<3; a++){
+            cmin.v[a] = MIN(cmin.v[a], c.v[a]);
+            cmax.v[a] = MAX(cmax.v[a], c.v[a]);
+        }
+    }
+    int axis = 0;
+    if(cmax.y-cmin.y > cmax.v[axis]-cmin.v[axis]) axis = 1;
+    if(cmax.z-cmin.z > cmax.v[axis]-cmin.v[axis]) axis = 2;
+
+    g_platform_sort_centroids = centroids;
+    g_platform_sort_axis = axis;
+    qsort(&platform->face_order[first], count, sizeof(uint32_t), compare_platform_centroids);
+
+    uint32_t left = platform->num_nodes;
+    platform->num_nodes += 2;
+    node->first = left;
+    node->count = 0;
+    build_platform_node(platform, left, first, count/2, centroids, depth+1);
+    build_platform_node(platform, left+1, first+count/2, count-count/2, centroids, depth+1);
+}
+
+//Recompute node bounds from current world verts. Children come after parents, so walk backwards
+static void refit_platform(Platform* platform){
+    for(int32_t i=platform->num_nodes-1; i>=0; i--){
+        PlatformNode* node = &platform->nodes[i];
+        if(node->count>0){
+            node->bounds = get_platform_face_bounds(*platform, platform->face_order[node->first]);
+            for(uint32_t k=1; k<node->count; k++){
+                node->bounds = aabb_union(node->bounds, get_platform_face_bounds(*platform, platform->face_order[node->first+k]));
+            }
+        }
+        else if(platform->num_faces>0){
+            node->bounds = aabb_union(platform->nodes[node->first].bounds, platform->nodes[node->first+1].bounds);
+        }
+    }
+}
+
+Platform init_platform(float* vp, uint16_t* indices, uint32_t vert_count, uint32_t index_count, Transform xform){
+    Platform platform;
+    platform.local_verts = vp;
+    platform.indices = indices;
+    platform.num_verts = vert_count;
+    platform.num_faces = index_count/3;
+    platform.xform = xform;
+    platform.world_verts = (vec3*)malloc(MAX(vert_count, 1u)*sizeof(vec3));
+    transform_points(xform, (const vec3*)vp, platform.world_verts, vert_count);
+
+    //Build tree once over model-space centroids; its topology never changes
+    platform.nodes = (PlatformNode*)malloc(MAX(2*platform.num_faces, 1u)*sizeof(PlatformNode));
+    platform.face_order = (uint32_t*)malloc(MAX(platform.num_faces, 1u)*sizeof(uint32_t));
+    vec3* centroids = (vec3*)malloc(MAX(platform.num_faces, 1u)*sizeof(vec3));
+    for(uint32_t i=0; i<platform.num_faces; i++){
+        platform.face_order[i] = i;
+        vec3 c = vec3(0,0,0);
+        for(int k=0; k<3; k++){
+            const float* p = &vp[3*indices[3*i+k]];
+            c += vec3(p[0], p[1], p[2]);
+        }
+        centroids[i] = c/3;
+    }
+    platform.num_nodes = 1;
+    build_platform_node(&platform, 0, 0, platform.num_faces, centroids, 0);
+    free(centroids);
+
+    refit_platform(&platform);
+    return platform;
+}
+
+void set_platform_transform(Platform* platform, Transform xform){
+    platform->xform = xform;
+    transform_points(xform, (const vec3*)platform->local_verts, platform->world_verts, platform->num_verts);
+    refit_platform(platform);
+}
+
+void get_platform_face(const Platform &platform, int face, vec3* p0, vec3* p1, vec3* p2){
+    *p0 = platform.world_verts[platform.indices[3*face]];
+    *p1 = platform.world_verts[platform.indices[3*face+1]];
+    *p2 = platform.world_verts[platform.indices[3*face+2]];
+}
+
+void begin_platform_sphere_query(const Platform &platform, vec3 center, float radius, PlatformSphereQuery* query){
+    query->center = center;
+    query->radius = radius;
+    query->stack_size = 0;
+    query->leaf_first = query->leaf_count = 0;
+    if(platform.num_faces>0) query->stack[query->stack_size++] = 0;
+}
+
+int next_platform_sphere_faces(const Platform &platform, PlatformSphereQuery* query, int32_t* faces, int max_faces){
+    int num_faces = 0;
+    while(num_faces<max_faces){
+        if(query->leaf_count>0){
+            faces[num_faces++] = platform.face_order[query->leaf_first++];
+            query->leaf_count--;
+            continue;
+        }
+        if(query->stack_size==0) break;
+        const PlatformNode &node = platform.nodes[query->stack[--query->stack_size]];
+        if(!aabb_overlaps_sphere(node.bounds, query->center, query->radius)) continue;
+        if(node.count>0){
+            query->leaf_first = node.first;
+            query->leaf_count = node.count;
+        }
+        else {
+            query->stack[query->stack_size++] = node.first;
+            query->stack[query->stack_size++] = node.first+1;
+        }
+    }
+    return num_faces;
+}
+
+int query_platform_sphere(const Platform &platform, vec3 center, float radius, int32_t* faces, int max_faces){
+    PlatformSphereQuery query;
+    begin_platform_sphere_query(platform, center, radius, &query);
+    return next_platform_sphere_faces(platform, &query, faces, max_faces);
+}
+
+void clear_platform(Platform* platform){
+    free(platform->local_verts);
+    free(platform->world_verts);
+    free(platform->indices);
+    free(platform->nodes);
+    free(platform->face_order);
+    platform->local_verts = NULL;
+    platform->world_verts = NULL;
+    platform->indices = NULL;
+    platform->nodes = NULL;
+    platform->face_order = NULL;
+    platform->num_verts = platform->num_faces = platform->num_nodes = 0;
+}
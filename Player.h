@@ -1,13 +1,21 @@
 #pragma once
 
+//Everything about the player that changes while the game runs
+//POD so it can be copied around freely (see SimState.h for snapshots)
+struct PlayerState {
+	vec3 pos;
+	vec3 vel;
+	bool is_on_ground;
+	bool is_jumping;
+	bool jump_was_pressed;		//only jump on the frame jump is pressed
+	int32_t platform;			//moving platform player is standing on, -1 if none
+	Transform platform_xform;	//platform's transform when player last moved with it
+};
+
 //Player data
-vec3 player_pos = vec3(-15,20,0);
+vec3 player_start_pos = vec3(-15,20,0);
 vec3 player_scale = vec3(0.25, 0.5, 0.25);
-mat4 player_M = translate(scale(identity_mat4(), player_scale), player_pos);
-vec3 player_vel = vec3(0,0,0);
 vec4 player_colour = vec4(0.1f, 0.8f, 0.3f, 1.0f);
-bool player_is_on_ground = false;
-bool player_is_jumping = false;
 float player_max_stand_slope = 60;
 //Physics stuff
 //Thanks to Kyle Pittman for his GDC talk:
@@ -21,7 +29,20 @@ float player_jump_dist_to_peak = 2.0f; //how far on xz p moves before reaching p
 float g = -2*player_jump_height*player_top_speed*player_top_speed/(player_jump_dist_to_peak*player_jump_dist_to_peak);
 float jump_vel = 2*player_jump_height*player_top_speed/player_jump_dist_to_peak;
 
-void player_update(double dt){
+PlayerState init_player_state(vec3 pos){
+    PlayerState player;
+    player.pos = pos;
+    player.vel = vec3(0,0,0);
+    player.is_on_ground = false;
+    player.is_jumping = false;
+    player.jump_was_pressed = false;
+    player.platform = -1;
+    player.platform_xform = identity_transform();
+    return player;
+}
+
+//Move player from input (g_input and camera orientation)
+void player_update(PlayerState* player, double dt){
 
     bool player_moved = false;
 
@@ -32,74 +53,70 @@ void player_update(double dt){
         vec3 rgt_xz_proj = normalise(vec3(g_camera.rgt.x, 0, g_camera.rgt.z));
         
         if(g_input[MOVE_FORWARD]) {
-            player_vel += fwd_xz_proj*player_acc*dt;
+            player->vel += fwd_xz_proj*player_acc*dt;
             player_moved = true;
         }
-        else if(dot(fwd_xz_proj,player_vel)>0) player_vel -= fwd_xz_proj*player_acc*dt;
+        else if(dot(fwd_xz_proj,player->vel)>0) player->vel -= fwd_xz_proj*player_acc*dt;
 
         if(g_input[MOVE_LEFT]) {
-            player_vel += -rgt_xz_proj*player_acc*dt;
+            player->vel += -rgt_xz_proj*player_acc*dt;
             player_moved = true;
         }
-        else if(dot(-rgt_xz_proj,player_vel)>0) player_vel += rgt_xz_proj*player_acc*dt;
+        else if(dot(-rgt_xz_proj,player->vel)>0) player->vel += rgt_xz_proj*player_acc*dt;
 
         if(g_input[MOVE_BACK]) {
-            player_vel += -fwd_xz_proj*player_acc*dt;
+            player->vel += -fwd_xz_proj*player_acc*dt;
             player_moved = true;			
         }
-        else if(dot(-fwd_xz_proj,player_vel)>0) player_vel += fwd_xz_proj*player_acc*dt;
+        else if(dot(-fwd_xz_proj,player->vel)>0) player->vel += fwd_xz_proj*player_acc*dt;
 
         if(g_input[MOVE_RIGHT]) {
-            player_vel += rgt_xz_proj*player_acc*dt;
+            player->vel += rgt_xz_proj*player_acc*dt;
             player_moved = true;		
         }
-        else if(dot(rgt_xz_proj,player_vel)>0) player_vel -= rgt_xz_proj*player_acc*dt;
+        else if(dot(rgt_xz_proj,player->vel)>0) player->vel -= rgt_xz_proj*player_acc*dt;
         // NOTE about the else statements above: Checks if we aren't pressing a button 
         // but have velocity in that direction, if so slows us down faster w/ subtraction
         // This improves responsiveness and tightens up the feel of moving
         // Mult by friction_factor is good to kill speed when idle but feels drifty while moving
     }
 
-    if(player_is_on_ground){
+    if(player->is_on_ground){
         //Clamp player speed
-        if(length2(player_vel) > player_top_speed*player_top_speed) {
-            player_vel = normalise(player_vel);
-            player_vel *= player_top_speed;
+        if(length2(player->vel) > player_top_speed*player_top_speed) {
+            player->vel = normalise(player->vel);
+            player->vel *= player_top_speed;
         }
         //Deceleration
-        if(!player_moved) player_vel = player_vel*friction_factor;
+        if(!player_moved) player->vel = player->vel*friction_factor;
 
-        static bool jump_button_was_pressed = false;
         if(g_input[JUMP]){
-            if(!jump_button_was_pressed){
-                player_vel.y += jump_vel;
-                player_is_on_ground = false;
-                player_is_jumping = true;
-                jump_button_was_pressed = true;
+            if(!player->jump_was_pressed){
+                player->vel.y += jump_vel;
+                player->is_on_ground = false;
+                player->is_jumping = true;
+                player->jump_was_pressed = true;
             }
         }
-        else jump_button_was_pressed = false;
+        else player->jump_was_pressed = false;
     }
     else { //Player is not on ground
-        if(player_is_jumping){
+        if(player->is_jumping){
             //If you don't hold jump you don't jump as high
-            if(!g_input[JUMP] && player_vel.y>0) player_vel.y += 5*g*dt;
+            if(!g_input[JUMP] && player->vel.y>0) player->vel.y += 5*g*dt;
         }
 
         //Clamp player's xz speed
-        vec3 xz_vel = vec3(player_vel.x, 0, player_vel.z);
+        vec3 xz_vel = vec3(player->vel.x, 0, player->vel.z);
         if(length(xz_vel) > player_top_speed) {
             xz_vel = normalise(xz_vel);
             xz_vel *= player_top_speed;
-            player_vel.x = xz_vel.x;
-            player_vel.z = xz_vel.z;
+            player->vel.x = xz_vel.x;
+            player->vel.z = xz_vel.z;
         }
-        player_vel.y += g*dt;
+        player->vel.y += g*dt;
     }
 
     //Update player position
-    player_pos += player_vel*dt;
-
-    //Update matrices
-    player_M = translate(scale(identity_mat4(), player_scale), player_pos);
+    player->pos += player->vel*dt;
 }
@@ -0,0 +1,130 @@
+#pragma once
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+
+//Kevin's tiny scoped-timer profiler
+//Each thread records into its own ring buffer (no locks, buffers are linked into a global list with a CAS),
+//call profiler_write_trace() to dump everything as Chrome trace event JSON
+//View in chrome://tracing or https://ui.perfetto.dev
+//Compiled out unless PROFILER is defined (it's on by default in Debug builds)
+
+#if defined(DEBUG) && !defined(PROFILER)
+#define PROFILER
+#endif
+
+#define PROFILER_MAX_EVENTS_PER_THREAD 65536 //older events get overwritten
+
+//Usage: { PROFILE_SCOPE("player_update"); player_update(dt); }
+#ifdef PROFILER
+#define PROFILE_CONCAT_(a,b) a##b
+#define PROFILE_CONCAT(a,b) PROFILE_CONCAT_(a,b)
+#define PROFILE_SCOPE(name) ProfileScope PROFILE_CONCAT(_profile_scope_, __LINE__)(name)
+#else
+#define PROFILE_SCOPE(name)
+#endif
+#define PROFILE_FUNCTION() PROFILE_SCOPE(__FUNCTION__)
+
+struct ProfileEvent {
+	const char* name;	//must be a string literal (or otherwise outlive the profiler)
+	uint64_t start_ns;
+	uint64_t duration_ns;
+};
+
+struct ProfileThreadBuffer {
+	ProfileEvent events[PROFILER_MAX_EVENTS_PER_THREAD];
+	std::atomic<uint32_t> num_events;	//only written by owning thread
+	uint32_t thread_id;
+	const char* thread_name;
+	ProfileThreadBuffer* next;
+};
+
+uint64_t profiler_now_ns();
+void profiler_record(const char* name, uint64_t start_ns, uint64_t duration_ns);
+void profiler_set_thread_name(const char* name);
+//Write all recorded events to a Chrome trace JSON file. Safe to call while other threads are recording
+bool profiler_write_trace(const char* file_path);
+
+struct ProfileScope {
+	const char* name;
+	uint64_t start_ns;
+	ProfileScope(const char* scope_name){
+		name = scope_name;
+		start_ns = profiler_now_ns();
+	}
+	~ProfileScope(){
+		profiler_record(name, start_ns, profiler_now_ns()-start_ns);
+	}
+};
+
+//Internal data
+static std::atomic<ProfileThreadBuffer*> g_profiler_buffers(NULL);
+static std::atomic<uint32_t> g_profiler_num_threads(0);
+static thread_local ProfileThreadBuffer* g_profiler_thread_buffer = NULL;
+static const std::chrono::steady_clock::time_point g_profiler_epoch = std::chrono::steady_clock::now();
+
+uint64_t profiler_now_ns(){
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now()-g_profiler_epoch).count();
+}
+
+static ProfileThreadBuffer* get_profiler_thread_buffer(){
+	if(!g_profiler_thread_buffer){
+		ProfileThreadBuffer* buffer = new ProfileThreadBuffer;
+		buffer->num_events.store(0);
+		buffer->thread_id = g_profiler_num_threads.fetch_add(1);
+		buffer->thread_name = NULL;
+		//Push onto global list
+		buffer->next = g_profiler_buffers.load();
+		while(!g_profiler_buffers.compare_exchange_weak(buffer->next, buffer)){}
+		g_profiler_thread_buffer = buffer;
+	}
+	return g_profiler_thread_buffer;
+}
+
+void profiler_record(const char* name, uint64_t start_ns, uint64_t duration_ns){
+	ProfileThreadBuffer* buffer = get_profiler_thread_buffer();
+	uint32_t index = buffer->num_events.load(std::memory_order_relaxed);
+	ProfileEvent* e = &buffer->events[index%PROFILER_MAX_EVENTS_PER_THREAD];
+	e->name = name;
+	e->start_ns = start_ns;
+	e->duration_ns = duration_ns;
+	buffer->num_events.store(index+1, std::memory_order_release); //publish event
+}
+
+void profiler_set_thread_name(const char* name){
+	get_profiler_thread_buffer()->thread_name = name;
+}
+
+bool profiler_write_trace(const char* file_path){
+	FILE* fp = fopen(file_path, "w");
+	if(!fp){
+		printf("Error: Failed to open %s for writing trace\n", file_path);
+		return false;
+	}
+	fprintf(fp, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	bool first_event = true;
+	int total_events = 0;
+	for(ProfileThreadBuffer* buffer = g_profiler_buffers.load(); buffer; buffer = buffer->next){
+		if(buffer->thread_name){
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+				first_event ? "" : ",\n", buffer->thread_id, buffer->thread_name);
+			first_event = false;
+		}
+		//NB: If the owning thread laps the ring buffer while we're writing, some old events may be replaced by newer ones
+		uint32_t num_events = buffer->num_events.load(std::memory_order_acquire);
+		uint32_t first = (num_events>PROFILER_MAX_EVENTS_PER_THREAD) ? num_events-PROFILER_MAX_EVENTS_PER_THREAD : 0;
+		for(uint32_t i=first; i<num_events; i++){
+			const ProfileEvent &e = buffer->events[i%PROFILER_MAX_EVENTS_PER_THREAD];
+			fprintf(fp, "%s{\"name\":\"%s\",\"ph\":\"X\",\"pid\":0,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f}",
+				first_event ? "" : ",\n", e.name, buffer->thread_id, e.start_ns/1000.0, e.duration_ns/1000.0);
+			first_event = false;
+			total_events++;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	fclose(fp);
+	printf("Wrote %d profiler events to %s\n", total_events, file_path);
+	return true;
+}
@@ -0,0 +1,164 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include "GameMaths.h"
+#include "Player.h"
+
+//Input recording for deterministic replays
+//Each frame stores exactly what player_update and collide_player_ground consume: dt, g_input and the camera's
+//xz orientation (the only part of it player movement uses), plus any direct writes to the player (reset/teleport)
+//Every REPLAY_CHECK_INTERVAL frames the resulting player position is stored too, so a replay can report
+//the first frame where it diverged. Replays are only bit-exact on a build with the same compiler and flags
+//File layout: ReplayHeader, then per frame: dt, input bits, flags, camera, [set pos/vel], [check pos]
+//NB: Reads/writes the input and camera globals, include after Input.h, Camera3D.h and Player.h
+
+#define REPLAY_MAGIC 0x50524c4c //"LLRP"
+#define REPLAY_VERSION 2
+#define REPLAY_CHECK_INTERVAL 30
+
+enum ReplayFlags {
+	REPLAY_FREECAM		= 1<<0,	//player_update wasn't called (collision still runs)
+	REPLAY_SET_PLAYER	= 1<<1,	//player pos/vel were set directly before player_update
+	REPLAY_CHECK		= 1<<2,	//frame stores player pos after collision
+};
+
+struct ReplayFrame {
+	double dt;
+	uint16_t input_bits;	//bit i is g_input[i]
+	uint8_t flags;
+	float cam_fwd_xz[2];
+	float cam_rgt_xz[2];
+	vec3 set_pos, set_vel;	//if REPLAY_SET_PLAYER
+	vec3 check_pos;			//if REPLAY_CHECK
+};
+
+struct ReplayHeader {
+	uint32_t magic;
+	uint32_t version;
+	PlayerState player;	//when recording started
+};
+
+struct ReplayRecorder {
+	FILE* fp;
+	uint32_t num_frames;
+};
+
+struct Replay {
+	ReplayHeader header;
+	ReplayFrame* frames;
+	uint32_t num_frames;
+};
+
+bool begin_replay_recording(ReplayRecorder* recorder, const char* file_name, const PlayerState &player);
+//Fills in dt, input, camera and check pos (if due) and writes the frame. Call after collision
+//set_pos/set_vel: what reset/teleport set the player to this frame (if flags has REPLAY_SET_PLAYER)
+void record_replay_frame(ReplayRecorder* recorder, double dt, uint8_t flags, vec3 set_pos, vec3 set_vel, const PlayerState &player);
+void end_replay_recording(ReplayRecorder* recorder);
+//Reads whole replay into memory so playback doesn't touch the disk
+bool load_replay(const char* file_name, Replay* replay);
+void free_replay(Replay* replay);
+//Set g_input and camera for frame, and the player's pos/vel if the frame set them
+void apply_replay_frame(const ReplayFrame &frame, PlayerState* player);
+
+bool begin_replay_recording(ReplayRecorder* recorder, const char* file_name, const PlayerState &player){
+	recorder->fp = fopen(file_name, "wb");
+	recorder->num_frames = 0;
+	if(!recorder->fp){
+		printf("Error: couldn't open %s for writing replay\n", file_name);
+		return false;
+	}
+	ReplayHeader header;
+	memset((void*)&header, 0, sizeof(ReplayHeader)); //no uninitialised padding in the file
+	header.magic = REPLAY_MAGIC;
+	header.version = REPLAY_VERSION;
+	header.player = player;
+	fwrite(&header, sizeof(ReplayHeader), 1, recorder->fp);
+	return true;
+}
+
+void record_replay_frame(ReplayRecorder* recorder, double dt, uint8_t flags, vec3 set_pos, vec3 set_vel, const PlayerState &player){
+	if(!recorder->fp) return;
+	uint16_t input_bits = 0;
+	for(int i=0; i<NUM_INPUT_COMMANDS; i++) input_bits |= (uint16_t)g_input[i] << i;
+	float camera[4] = { g_camera.fwd.x, g_camera.fwd.z, g_camera.rgt.x, g_camera.rgt.z };
+	recorder->num_frames++;
+	if(recorder->num_frames%REPLAY_CHECK_INTERVAL==0) flags |= REPLAY_CHECK;
+
+	fwrite(&dt, sizeof(double), 1, recorder->fp);
+	fwrite(&input_bits, sizeof(uint16_t), 1, recorder->fp);
+	fwrite(&flags, sizeof(uint8_t), 1, recorder->fp);
+	fwrite(camera, sizeof(float), 4, recorder->fp);
+	if(flags & REPLAY_SET_PLAYER){
+		fwrite(set_pos.v, sizeof(float), 3, recorder->fp);
+		fwrite(set_vel.v, sizeof(float), 3, recorder->fp);
+	}
+	if(flags & REPLAY_CHECK) fwrite(player.pos.v, sizeof(float), 3, recorder->fp);
+}
+
+void end_replay_recording(ReplayRecorder* recorder){
+	if(!recorder->fp) return;
+	fclose(recorder->fp);
+	recorder->fp = NULL;
+	printf("Recorded %u frames\n", recorder->num_frames);
+}
+
+bool load_replay(const char* file_name, Replay* replay){
+	replay->frames = NULL;
+	replay->num_frames = 0;
+	FILE* fp = fopen(file_name, "rb");
+	if(!fp){
+		printf("Error: couldn't open replay %s\n", file_name);
+		return false;
+	}
+	if(fread(&replay->header, sizeof(ReplayHeader), 1, fp)!=1 || replay->header.magic!=REPLAY_MAGIC || replay->header.version!=REPLAY_VERSION){
+		printf("Error: %s is not a version %d replay\n", file_name, REPLAY_VERSION);
+		fclose(fp);
+		return false;
+	}
+	uint32_t capacity = 1024;
+	replay->frames = (ReplayFrame*)malloc(capacity*sizeof(ReplayFrame));
+	while(true){
+		ReplayFrame frame;
+		if(fread(&frame.dt, sizeof(double), 1, fp)!=1) break;
+		bool ok = fread(&frame.input_bits, sizeof(uint16_t), 1, fp)==1;
+		ok = ok && fread(&frame.flags, sizeof(uint8_t), 1, fp)==1;
+		ok = ok && fread(frame.cam_fwd_xz, sizeof(float), 2, fp)==2;
+		ok = ok && fread(frame.cam_rgt_xz, sizeof(float), 2, fp)==2;
+		if(ok && (frame.flags & REPLAY_SET_PLAYER)){
+			ok = fread(frame.set_pos.v, sizeof(float), 3, fp)==3;
+			ok = ok && fread(frame.set_vel.v, sizeof(float), 3, fp)==3;
+		}
+		if(ok && (frame.flags & REPLAY_CHECK)) ok = fread(frame.check_pos.v, sizeof(float), 3, fp)==3;
+		if(!ok){
+			printf("Warning: replay %s is truncated after %u frames\n", file_name, replay->num_frames);
+			break;
+		}
+		if(replay->num_frames==capacity){
+			capacity *= 2;
+			replay->frames = (ReplayFrame*)realloc((void*)replay->frames, capacity*sizeof(ReplayFrame));
+		}
+		replay->frames[replay->num_frames++] = frame;
+	}
+	fclose(fp);
+	return true;
+}
+
+void free_replay(Replay* replay){
+	free(replay->frames);
+	replay->frames = NULL;
+	replay->num_frames = 0;
+}
+
+void apply_replay_frame(const ReplayFrame &frame, PlayerState* player){
+	for(int i=0; i<NUM_INPUT_COMMANDS; i++) g_input[i] = (frame.input_bits >> i) & 1;
+	g_camera.fwd.x = frame.cam_fwd_xz[0];
+	g_camera.fwd.z = frame.cam_fwd_xz[1];
+	g_camera.rgt.x = frame.cam_rgt_xz[0];
+	g_camera.rgt.z = frame.cam_rgt_xz[1];
+	if(frame.flags & REPLAY_SET_PLAYER){
+		player->pos = frame.set_pos;
+		player->vel = frame.set_vel;
+	}
+}
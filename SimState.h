@@ -0,0 +1,86 @@
+#pragma once
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <type_traits>
+#include "Player.h"
+#include "Level.h"
+
+//All mutable simulation state in one POD, so a tick can be saved/restored with a memcpy
+//(rollback netcode, replay seeking). Things that aren't here:
+// - the camera: it's presentation, its orientation reaches the sim as input (see Replay.h)
+// - the player's collider: rebuilt from player.pos every tick
+// - the level, including moving platforms: their transforms live in LevelCollider and are shared by every agent,
+//   so a snapshot doesn't restore them. Whoever moves platforms has to put them back when rolling back
+//   (player.platform_xform is here, so once they are, a restored player is carried from the right place)
+struct SimState {
+	PlayerState player;
+	PlayerGroundCache ground_cache;
+};
+//vec3's hand-written operator= stops this being trivially copyable on paper, but it's all plain floats and ints
+static_assert(std::is_standard_layout<SimState>::value, "SimState must stay memcpy-able");
+
+SimState init_sim_state(vec3 player_pos){
+	SimState sim;
+	sim.player = init_player_state(player_pos);
+	sim.ground_cache.num_faces = 0;
+	return sim;
+}
+
+//Ring buffer of the last capacity snapshots, indexed by tick
+//Stores raw bytes so callers can snapshot a whole array of states (e.g. one per agent) in one go
+//Each snapshot starts on its own cache line
+#define SNAPSHOT_ALIGNMENT 64
+
+struct SnapshotRing {
+	uint8_t* data;			//capacity*stride, aligned to SNAPSHOT_ALIGNMENT
+	void* allocation;		//what to free
+	int64_t* ticks;			//tick stored in each slot, -1 if empty
+	uint32_t capacity;
+	size_t state_size;
+	size_t stride;			//state_size rounded up to SNAPSHOT_ALIGNMENT
+};
+
+SnapshotRing init_snapshot_ring(uint32_t capacity, size_t state_size);
+void clear_snapshot_ring(SnapshotRing* ring);
+//Overwrites whatever was saved capacity ticks ago. Negative ticks are ignored
+void save_snapshot(SnapshotRing* ring, int64_t tick, const void* state);
+//Returns false if tick was never saved or has been overwritten
+bool load_snapshot(const SnapshotRing &ring, int64_t tick, void* state);
+
+SnapshotRing init_snapshot_ring(uint32_t capacity, size_t state_size){
+	SnapshotRing ring;
+	ring.capacity = MAX(capacity, 1u);
+	ring.state_size = state_size;
+	ring.stride = (state_size + SNAPSHOT_ALIGNMENT-1) & ~(size_t)(SNAPSHOT_ALIGNMENT-1);
+	ring.allocation = malloc(ring.capacity*ring.stride + SNAPSHOT_ALIGNMENT-1);
+	ring.data = (uint8_t*)(((uintptr_t)ring.allocation + SNAPSHOT_ALIGNMENT-1) & ~(uintptr_t)(SNAPSHOT_ALIGNMENT-1));
+	ring.ticks = (int64_t*)malloc(ring.capacity*sizeof(int64_t));
+	for(uint32_t i=0; i<ring.capacity; i++) ring.ticks[i] = -1;
+	return ring;
+}
+
+void clear_snapshot_ring(SnapshotRing* ring){
+	free(ring->allocation);
+	free(ring->ticks);
+	ring->allocation = NULL;
+	ring->data = NULL;
+	ring->ticks = NULL;
+	ring->capacity = 0;
+}
+
+void save_snapshot(SnapshotRing* ring, int64_t tick, const void* state){
+	if(tick<0) return; //-1 marks an empty slot, and % would give a negative slot
+	uint32_t slot = (uint32_t)(tick % ring->capacity);
+	memcpy(ring->data + slot*ring->stride, state, ring->state_size);
+	ring->ticks[slot] = tick;
+}
+
+bool load_snapshot(const SnapshotRing &ring, int64_t tick, void* state){
+	if(tick<0) return false;
+	uint32_t slot = (uint32_t)(tick % ring.capacity);
+	if(ring.ticks[slot]!=tick) return false;
+	memcpy(state, ring.data + slot*ring.stride, ring.state_size);
+	return true;
+}
@@ -0,0 +1,193 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <atomic>
+#include "GameMaths.h"
+#include "JobSystem.h"
+#include "Profiler.h"
+
+//Spatial hash of points (agent positions), rebuilt from scratch every tick with a parallel counting sort:
+// 1. count points per bucket with atomic increments, remembering each point's slot within its bucket
+// 2. prefix sum of counts gives each bucket's start
+// 3. scatter points to start+slot
+//No locks anywhere, and the result is one flat array of points sorted by bucket, so queries read memory in order
+//Serves agent-agent collision, avoidance and interest management with one "points within radius" query
+//Cell size should be about the typical query radius
+
+#define SPATIAL_HASH_BATCH_SIZE 4096	//points per parallel_for batch
+
+struct SpatialHash {
+	float cell_size;
+	float inv_cell_size;
+	uint32_t num_buckets;		//power of two
+	uint32_t max_points;
+	uint32_t num_points;
+	std::atomic<uint32_t>* bucket_counts;
+	uint32_t* bucket_start;		//num_buckets+1 offsets into points/ids
+	uint32_t* point_bucket;		//per input point, bucket it landed in
+	uint32_t* point_slot;		//per input point, index within its bucket
+	vec3* points;			//sorted by bucket
+	uint32_t* ids;			//index of each sorted point in the array passed to build_spatial_hash
+};
+
+SpatialHash init_spatial_hash(uint32_t max_points, float cell_size);
+void clear_spatial_hash(SpatialHash* hash);
+//Rebuild from positions (num_points <= max_points), spread across the job system
+void build_spatial_hash(SpatialHash* hash, const vec3* positions, uint32_t num_points);
+//Writes ids of points within radius of center, each once, returns how many (at most max_results)
+//NB: Cost grows with the number of cells covered, so radius should be on the order of cell_size
+int query_spatial_hash(const SpatialHash &hash, vec3 center, float radius, uint32_t* results, int max_results);
+
+inline uint32_t spatial_hash_bucket(const SpatialHash &hash, int32_t x, int32_t y, int32_t z){
+	//Teschner et al. 2003, "Optimized Spatial Hashing for Collision Detection of Deformable Objects"
+	uint32_t h = ((uint32_t)x*73856093u) ^ ((uint32_t)y*19349663u) ^ ((uint32_t)z*83492791u);
+	return h & (hash.num_buckets-1);
+}
+
+inline int32_t spatial_hash_cell(const SpatialHash &hash, float f){
+	//floorf is a libm call without SSE4.1, and this runs for every point every tick
+	f *= hash.inv_cell_size;
+	int32_t i = (int32_t)f;
+	return i - (f<(float)i);
+}
+
+SpatialHash init_spatial_hash(uint32_t max_points, float cell_size){
+	SpatialHash hash;
+	hash.cell_size = cell_size;
+	hash.inv_cell_size = 1.0f/cell_size;
+	hash.num_buckets = 16;
+	while(hash.num_buckets < 2*max_points) hash.num_buckets *= 2; //at most half full
+	hash.max_points = max_points;
+	hash.num_points = 0;
+	hash.bucket_counts = new std::atomic<uint32_t>[hash.num_buckets];
+	hash.bucket_start = (uint32_t*)calloc(hash.num_buckets+1, sizeof(uint32_t));
+	hash.point_bucket = (uint32_t*)malloc(MAX(max_points, 1u)*sizeof(uint32_t));
+	hash.point_slot = (uint32_t*)malloc(MAX(max_points, 1u)*sizeof(uint32_t));
+	hash.points = (vec3*)malloc(MAX(max_points, 1u)*sizeof(vec3));
+	hash.ids = (uint32_t*)malloc(MAX(max_points, 1u)*sizeof(uint32_t));
+	return hash;
+}
+
+void clear_spatial_hash(SpatialHash* hash){
+	delete[] hash->bucket_counts;
+	free(hash->bucket_start);
+	free(hash->point_bucket);
+	free(hash->point_slot);
+	free(hash->points);
+	free(hash->ids);
+	memset(hash, 0, sizeof(SpatialHash));
+}
+
+struct SpatialHashBuild {
+	SpatialHash* hash;
+	const vec3* positions;
+	uint32_t* block_sums;
+};
+
+static void spatial_hash_reset_job(void* data, uint32_t begin, uint32_t end){
+	SpatialHashBuild* build = (SpatialHashBuild*)data;
+	for(uint32_t i=begin; i<end; i++) build->hash->bucket_counts[i].store(0, std::memory_order_relaxed);
+}
+
+static void spatial_hash_count_job(void* data, uint32_t begin, uint32_t end){
+	SpatialHashBuild* build = (SpatialHashBuild*)data;
+	SpatialHash* hash = build->hash;
+	for(uint32_t i=begin; i<end; i++){
+		const vec3 &p = build->positions[i];
+		uint32_t bucket = spatial_hash_bucket(*hash, spatial_hash_cell(*hash, p.v[0]), spatial_hash_cell(*hash, p.v[1]), spatial_hash_cell(*hash, p.v[2]));
+		hash->point_bucket[i] = bucket;
+		hash->point_slot[i] = hash->bucket_counts[bucket].fetch_add(1, std::memory_order_relaxed);
+	}
+}
+
+//Prefix sum in two passes over blocks of buckets: sum each block, scan block sums (serially, there are few), then scan within blocks
+static void spatial_hash_block_sum_job(void* data, uint32_t begin, uint32_t end){
+	SpatialHashBuild* build = (SpatialHashBuild*)data;
+	for(uint32_t block=begin; block<end; block++){
+		uint32_t sum = 0;
+		uint32_t first = block*SPATIAL_HASH_BATCH_SIZE;
+		uint32_t last = MIN(first+SPATIAL_HASH_BATCH_SIZE, build->hash->num_buckets);
+		for(uint32_t i=first; i<last; i++) sum += build->hash->bucket_counts[i].load(std::memory_order_relaxed);
+		build->block_sums[block] = sum;
+	}
+}
+
+static void spatial_hash_block_scan_job(void* data, uint32_t begin, uint32_t end){
+	SpatialHashBuild* build = (SpatialHashBuild*)data;
+	SpatialHash* hash = build->hash;
+	for(uint32_t block=begin; block<end; block++){
+		uint32_t offset = build->block_sums[block];
+		uint32_t first = block*SPATIAL_HASH_BATCH_SIZE;
+		uint32_t last = MIN(first+SPATIAL_HASH_BATCH_SIZE, hash->num_buckets);
+		for(uint32_t i=first; i<last; i++){
+			hash->bucket_start[i] = offset;
+			offset += hash->bucket_counts[i].load(std::memory_order_relaxed);
+		}
+	}
+}
+
+static void spatial_hash_scatter_job(void* data, uint32_t begin, uint32_t end){
+	SpatialHashBuild* build = (SpatialHashBuild*)data;
+	SpatialHash* hash = build->hash;
+	for(uint32_t i=begin; i<end; i++){
+		uint32_t index = hash->bucket_start[hash->point_bucket[i]] + hash->point_slot[i];
+		hash->points[index] = build->positions[i];
+		hash->ids[index] = i;
+	}
+}
+
+void build_spatial_hash(SpatialHash* hash, const vec3* positions, uint32_t num_points){
+	PROFILE_FUNCTION();
+	if(num_points>hash->max_points){
+		printf("Error: build_spatial_hash got %u points, hash only has room for %u\n", num_points, hash->max_points);
+		num_points = hash->max_points;
+	}
+	hash->num_points = num_points;
+
+	uint32_t num_blocks = (hash->num_buckets+SPATIAL_HASH_BATCH_SIZE-1)/SPATIAL_HASH_BATCH_SIZE;
+	uint32_t* block_sums = (uint32_t*)malloc(num_blocks*sizeof(uint32_t));
+	SpatialHashBuild build = { hash, positions, block_sums };
+
+	parallel_for(hash->num_buckets, SPATIAL_HASH_BATCH_SIZE, spatial_hash_reset_job, &build);
+	parallel_for(num_points, SPATIAL_HASH_BATCH_SIZE, spatial_hash_count_job, &build);
+	parallel_for(num_blocks, 1, spatial_hash_block_sum_job, &build);
+	uint32_t offset = 0;
+	for(uint32_t block=0; block<num_blocks; block++){
+		uint32_t sum = block_sums[block];
+		block_sums[block] = offset;
+		offset += sum;
+	}
+	parallel_for(num_blocks, 1, spatial_hash_block_scan_job, &build);
+	hash->bucket_start[hash->num_buckets] = num_points;
+	parallel_for(num_points, SPATIAL_HASH_BATCH_SIZE, spatial_hash_scatter_job, &build);
+
+	free(block_sums);
+}
+
+int query_spatial_hash(const SpatialHash &hash, vec3 center, float radius, uint32_t* results, int max_results){
+	int32_t min_cell[3], max_cell[3];
+	for(int k=0; k<3; k++){
+		min_cell[k] = spatial_hash_cell(hash, center.v[k]-radius);
+		max_cell[k] = spatial_hash_cell(hash, center.v[k]+radius);
+	}
+	float radius2 = radius*radius;
+	int num_results = 0;
+	for(int32_t z=min_cell[2]; z<=max_cell[2]; z++)
+	for(int32_t y=min_cell[1]; y<=max_cell[1]; y++)
+	for(int32_t x=min_cell[0]; x<=max_cell[0]; x++){
+		uint32_t bucket = spatial_hash_bucket(hash, x, y, z);
+		for(uint32_t i=hash.bucket_start[bucket]; i<hash.bucket_start[bucket+1]; i++){
+			const vec3 &p = hash.points[i];
+			float dx = p.v[0]-center.v[0], dy = p.v[1]-center.v[1], dz = p.v[2]-center.v[2];
+			if(dx*dx + dy*dy + dz*dz > radius2) continue;
+			//Other cells can share this bucket; only report points from this cell, so each is reported
+			//once (when we reach its own cell) however many cells the query covers
+			if(spatial_hash_cell(hash, p.v[0])!=x || spatial_hash_cell(hash, p.v[1])!=y || spatial_hash_cell(hash, p.v[2])!=z) continue;
+			if(num_results==max_results) return num_results;
+			results[num_results++] = hash.ids[i];
+		}
+	}
+	return num_results;
+}
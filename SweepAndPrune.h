@@ -0,0 +1,169 @@
+#pragma once
+#include <stdlib.h>
+#include <stdint.h>
+#include "GameMaths.h"
+#include "Collider.h"
+#include "Profiler.h"
+
+//Sort-and-sweep broadphase for lots of moving agents
+//Proxies are kept sorted by the min of their bounds along one axis; agents barely move between frames,
+//so an insertion sort on last frame's order is close to O(n). The sweep then only compares proxies whose
+//intervals overlap on that axis, and checks the other two axes before emitting a pair for narrowphase
+//The sort axis is re-picked when the spread of agents changes a lot (e.g. a crowd forms a long line)
+//NB: Agents spread over a plane still overlap ~sqrt(n) others on the sort axis, so the sweep is O(n*sqrt(n))
+
+#define SAP_AXIS_CHECK_INTERVAL 60	//updates between checking for a better sort axis
+#define SAP_MAX_INSERTED_PROXIES 32	//more proxies added since the last update than this get a full sort instead
+
+struct SAPProxy {
+	AABB bounds;
+	Collider* collider;
+};
+
+struct ColliderPair {
+	Collider* a;
+	Collider* b;
+};
+
+struct SweepAndPrune {
+	SAPProxy* proxies;	//sorted by bounds.min[axis] after each update
+	int num_proxies;
+	int capacity;
+	int axis;
+	int updates_until_axis_check;
+	int num_added;		//proxies appended since the last update, still unsorted at the end
+};
+
+SweepAndPrune init_sweep_and_prune(int initial_capacity=64);
+void clear_sweep_and_prune(SweepAndPrune* sap);
+void sap_add(SweepAndPrune* sap, Collider* collider);
+void sap_remove(SweepAndPrune* sap, Collider* collider);
+//Recompute bounds of all colliders, re-sort and write overlapping pairs. Returns number of pairs (at most max_pairs)
+int sap_update(SweepAndPrune* sap, ColliderPair* pairs, int max_pairs);
+
+SweepAndPrune init_sweep_and_prune(int initial_capacity){
+    SweepAndPrune sap;
+    sap.capacity = MAX(initial_capacity, 1);
+    sap.proxies = (SAPProxy*)malloc(sap.capacity*sizeof(SAPProxy));
+    sap.num_proxies = 0;
+    sap.axis = 0;
+    sap.updates_until_axis_check = 0;
+    sap.num_added = 0;
+    return sap;
+}
+
+void clear_sweep_and_prune(SweepAndPrune* sap){
+    free(sap->proxies);
+    sap->proxies = NULL;
+    sap->num_proxies = sap->capacity = 0;
+    sap->num_added = 0;
+}
+
+void sap_add(SweepAndPrune* sap, Collider* collider){
+    if(sap->num_proxies==sap->capacity){
+        sap->capacity *= 2;
+        sap->proxies = (SAPProxy*)realloc((void*)sap->proxies, sap->capacity*sizeof(SAPProxy));
+    }
+    //Append at the end, insertion sort moves it into place on next update
+    SAPProxy* proxy = &sap->proxies[sap->num_proxies++];
+    proxy->collider = collider;
+    proxy->bounds = collider_aabb(collider);
+    sap->num_added++;
+}
+
+void sap_remove(SweepAndPrune* sap, Collider* collider){
+    for(int i=0; i<sap->num_proxies; i++){
+        if(sap->proxies[i].collider!=collider) continue;
+        //Shift down to keep the order
+        for(int j=i+1; j<sap->num_proxies; j++) sap->proxies[j-1] = sap->proxies[j];
+        sap->num_proxies--;
+        return;
+    }
+}
+
+//Axis along which centres of bounds are most spread out (fewest overlapping intervals)
+static int sap_best_axis(const SweepAndPrune &sap){
+    vec3 sum = vec3(0,0,0), sum2 = vec3(0,0,0);
+    for(int i=0; i<sap.num_proxies; i++){
+        for(int k=0; k<3; k++){
+            float c = 0.5f*(sap.proxies[i].bounds.min.v[k] + sap.proxies[i].bounds.max.v[k]);
+            sum.v[k] += c;
+            sum2.v[k] += c*c;
+        }
+    }
+    int axis = 0;
+    float best_variance = -1;
+    for(int k=0; k<3; k++){
+        float variance = sum2.v[k] - sum.v[k]*sum.v[k]/MAX(sap.num_proxies, 1);
+        if(variance>best_variance){
+            best_variance = variance;
+            axis = k;
+        }
+    }
+    return axis;
+}
+
+//qsort has no context pointer
+static thread_local int g_sap_sort_axis;
+static int compare_sap_proxies(const void* a, const void* b){
+    float ma = ((const SAPProxy*)a)->bounds.min.v[g_sap_sort_axis];
+    float mb = ((const SAPProxy*)b)->bounds.min.v[g_sap_sort_axis];
+    return (ma>mb) - (ma<mb);
+}
+
+int sap_update(SweepAndPrune* sap, ColliderPair* pairs, int max_pairs){
+    PROFILE_FUNCTION();
+    for(int i=0; i<sap->num_proxies; i++){
+        sap->proxies[i].bounds = collider_aabb(sap->proxies[i].collider);
+    }
+
+    bool axis_changed = false;
+    if(--sap->updates_until_axis_check<=0){
+        int best_axis = sap_best_axis(*sap);
+        axis_changed = (best_axis!=sap->axis);
+        sap->axis = best_axis;
+        sap->updates_until_axis_check = SAP_AXIS_CHECK_INTERVAL;
+    }
+    const int axis = sap->axis;
+
+    {
+        PROFILE_SCOPE("sap_sort");
+        //Order along new axis is unrelated to the old one, do a full sort
+        //Same for lots of new proxies (e.g. the first update): each one can insertion sort across the whole list
+        if(axis_changed || sap->num_added>SAP_MAX_INSERTED_PROXIES){
+            g_sap_sort_axis = axis;
+            qsort(sap->proxies, sap->num_proxies, sizeof(SAPProxy), compare_sap_proxies);
+        }
+        //Insertion sort, nearly sorted from last frame
+        for(int i=1; i<sap->num_proxies; i++){
+            SAPProxy proxy = sap->proxies[i];
+            float key = proxy.bounds.min.v[axis];
+            int j = i-1;
+            while(j>=0 && sap->proxies[j].bounds.min.v[axis]>key){
+                sap->proxies[j+1] = sap->proxies[j];
+                j--;
+            }
+            sap->proxies[j+1] = proxy;
+        }
+        sap->num_added = 0;
+    }
+
+    //Sweep
+    PROFILE_SCOPE("sap_sweep");
+    const int axis1 = (axis+1)%3, axis2 = (axis+2)%3;
+    int num_pairs = 0;
+    for(int i=0; i<sap->num_proxies; i++){
+        const AABB &a = sap->proxies[i].bounds;
+        for(int j=i+1; j<sap->num_proxies; j++){
+            const AABB &b = sap->proxies[j].bounds;
+            if(b.min.v[axis]>a.max.v[axis]) break; //sorted, nothing further along can overlap
+            if(b.min.v[axis1]>a.max.v[axis1] || a.min.v[axis1]>b.max.v[axis1]) continue;
+            if(b.min.v[axis2]>a.max.v[axis2] || a.min.v[axis2]>b.max.v[axis2]) continue;
+            if(num_pairs==max_pairs) return num_pairs;
+            pairs[num_pairs].a = sap->proxies[i].collider;
+            pairs[num_pairs].b = sap->proxies[j].collider;
+            num_pairs++;
+        }
+    }
+    return num_pairs;
+}
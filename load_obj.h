@@ -2,6 +2,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#include <assert.h>
 
 //****************************************
 //Kevin's wavefront obj loading functions
@@ -52,7 +53,6 @@ bool load_obj(const char* file_name, float** vp, uint32_t* vert_count){
 	FILE* fp = fopen(obj_file_path, "r");
 	if(!fp) {
 		printf("Error: Failed to open %s\n", file_name);
-		fclose(fp);
 		return false;
 	}
 	printf("Loading obj: '%s'\n", file_name);
@@ -163,7 +163,6 @@ bool load_obj(const char* file_name, float** vp, float** vt, float** vn, uint32_
 	FILE* fp = fopen(obj_file_path, "r");
 	if(!fp) {
 		printf("Error: Failed to open %s\n", file_name);
-		fclose(fp);
 		return false;
 	}
 	printf("Loading obj: '%s'\n", file_name);
@@ -358,7 +357,6 @@ bool load_obj_indexed(const char* file_name, float** vp, uint16_t** indices, uin
 	FILE* fp = fopen(obj_file_path, "r");
 	if(!fp) {
 		printf("Error: Failed to open %s\n", file_name);
-		fclose(fp);
 		return false;
 	}
 	printf("Loading obj: '%s'\n", file_name);
@@ -472,7 +470,6 @@ bool load_obj_indexed(const char* file_name, float** vp, float** vt, float** vn,
 	FILE* fp = fopen(obj_file_path, "r");
 	if(!fp) {
 		printf("Error: Failed to open %s\n", file_name);
-		fclose(fp);
 		return false;
 	}
 	printf("Loading obj: '%s'\n", file_name);
@@ -1,5 +1,10 @@
+//HEADLESS builds replay a recorded input log with no window or GL (see Replay.h)
+#ifndef HEADLESS
 #define GL_LITE_IMPLEMENTATION
 #include "gl_lite.h"
+#else
+#define GLFW_INCLUDE_NONE //only want GLFW's types and key codes, nothing gets linked
+#endif
 #include <GLFW/glfw3.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -12,110 +17,183 @@ float gl_aspect_ratio = (float)gl_width/gl_height;
 bool gl_fullscreen = false;
 
 #include "GameMaths.h"
+#include "Profiler.h"
 #include "Input.h"
 #include "Camera3D.h"
+#ifndef HEADLESS
 #include "init_gl.h"
-#include "load_obj.h"
 #include "Shader.h"
 #include "DebugDrawing.h"
+#endif
+#include "load_obj.h"
 #include "Player.h"
 #include "GJK.h"
 #include "Level.h"
+#include "JobSystem.h"
+#include "AssetLoading.h"
+#include "Replay.h"
+#include "SimState.h"
+
+#ifdef HEADLESS
+static int compare_frame_times(const void* a, const void* b){
+	double da = *(const double*)a, db = *(const double*)b;
+	return (da>db) - (da<db);
+}
 
-int main(){
-	if(!init_gl(window, "Level Collision", gl_width, gl_height)){ return 1; }
-
-	//Load player mesh
-	GLuint player_vao;
-	unsigned int player_num_indices = 0;
+//One tick of the sim driven by a replay frame
+static void replay_tick(const LevelCollider &level, Capsule* player_collider, SimState* sim, const ReplayFrame &frame){
+	apply_replay_frame(frame, &sim->player);
+	if(!(frame.flags & REPLAY_FREECAM)){
+		PROFILE_SCOPE("player_update");
+		player_update(&sim->player, frame.dt);
+	}
 	{
-		float* vp = NULL;
-		float* vn = NULL;
-		float* vt = NULL;
-		uint16_t* indices = NULL;
-		unsigned int num_verts = 0;
-		load_obj_indexed("capsule.obj", &vp, &vt, &vn, &indices, &num_verts, &player_num_indices);
+		PROFILE_SCOPE("collision");
+		player_collider->xform = make_transform(sim->player.pos, identity_quat(), player_scale);
+		collide_player_ground(level, player_collider, &sim->player, &sim->ground_cache);
+		sim->player.pos = player_collider->xform.pos;
+	}
+}
 
-		glGenVertexArrays(1, &player_vao);
-		glBindVertexArray(player_vao);
-		
-		GLuint points_vbo;
-		glGenBuffers(1, &points_vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-		glBufferData(GL_ARRAY_BUFFER, num_verts*3*sizeof(float), vp, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(VP_ATTRIB_LOC);
-		glVertexAttribPointer(VP_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-		free(vp);
-
-		free(vt);
-
-		GLuint normals_vbo;
-		glGenBuffers(1, &normals_vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, normals_vbo);
-		glBufferData(GL_ARRAY_BUFFER, num_verts*3*sizeof(float), vn, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(VN_ATTRIB_LOC);
-		glVertexAttribPointer(VN_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-		free(vn);
-
-		GLuint index_vbo;
-		glGenBuffers(1, &index_vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, player_num_indices*sizeof(unsigned short), indices, GL_STATIC_DRAW);
-		free(indices);
+#define HEADLESS_ROLLBACK_FRAMES 120 //snapshots kept while replaying, the rollback check rewinds this far
+
+//Usage: levelcollision_headless replay.bin [repeats]
+//Replays the log through player_update + collide_player_ground, checks the trajectory against
+//the recorded positions and reports how long each frame took. Then rolls back to a snapshot and
+//re-simulates to check restoring a snapshot reproduces the same end state
+//Returns 1 if the trajectory diverged or the rollback didn't match
+int main(int argc, char** argv){
+	if(argc<2){
+		printf("Usage: %s replay.bin [repeats]\n", argv[0]);
+		return 1;
+	}
+	int num_repeats = (argc>2) ? atoi(argv[2]) : 1;
+	if(num_repeats<1) num_repeats = 1;
+	profiler_set_thread_name("main");
+
+	Replay replay;
+	if(!load_replay(argv[1], &replay)) return 1;
+	if(replay.num_frames==0){
+		printf("Error: replay %s has no frames\n", argv[1]);
+		return 1;
 	}
 
-	//Load ground mesh
-	GLuint ground_vao;
-	unsigned int ground_num_indices = 0;
 	LevelCollider level;
 	{
 		float* vp = NULL;
-		float* vn = NULL;
-		float* vt = NULL;
 		uint16_t* indices = NULL;
-		unsigned int num_verts = 0;
-		load_obj_indexed("ground.obj", &vp, &vt, &vn, &indices, &num_verts, &ground_num_indices);
-
-		level = init_level(vp, indices, num_verts, ground_num_indices);
-
-		glGenVertexArrays(1, &ground_vao);
-		glBindVertexArray(ground_vao);
-		
-		GLuint points_vbo;
-		glGenBuffers(1, &points_vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-		glBufferData(GL_ARRAY_BUFFER, num_verts*3*sizeof(float), vp, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(VP_ATTRIB_LOC);
-		glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
-		glVertexAttribPointer(VP_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-		// free(vp);
-
-		free(vt);
-
-		GLuint normals_vbo;
-		glGenBuffers(1, &normals_vbo);
-		glBindBuffer(GL_ARRAY_BUFFER, normals_vbo);
-		glBufferData(GL_ARRAY_BUFFER, num_verts*3*sizeof(float), vn, GL_STATIC_DRAW);
-		glEnableVertexAttribArray(VN_ATTRIB_LOC);
-		glVertexAttribPointer(VN_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
-		free(vn);
-
-		GLuint index_vbo;
-		glGenBuffers(1, &index_vbo);
-		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
-		glBufferData(GL_ELEMENT_ARRAY_BUFFER, ground_num_indices*sizeof(unsigned short), indices, GL_STATIC_DRAW);
-		// free(indices);
+		uint32_t num_verts = 0, num_indices = 0;
+		if(!load_obj_indexed("ground.obj", &vp, &indices, &num_verts, &num_indices)) return 1;
+		level = init_level(vp, indices, num_verts, num_indices);
 	}
 
-	//Player collision mesh
 	Capsule player_collider;
-	{
-		player_collider.r = 1; 		//NB: these are the dimensions of the collider mesh (capsule.obj),
-		player_collider.y_base = 1; //they will be scaled using the player's model matrix!
-		player_collider.y_cap = 2;
-		player_collider.pos = player_pos;
-		player_collider.matRS = player_M;
-		player_collider.matRS_inverse = inverse(player_M);
+	player_collider.r = 1;
+	player_collider.y_base = 1;
+	player_collider.y_cap = 2;
+
+	SimState sim;
+	SnapshotRing snapshots = init_snapshot_ring(HEADLESS_ROLLBACK_FRAMES, sizeof(SimState));
+	double snapshot_time = 0;
+
+	double* frame_times = (double*)malloc(replay.num_frames*num_repeats*sizeof(double));
+	int first_divergence = -1;
+	float max_error = 0;
+	for(int repeat=0; repeat<num_repeats; repeat++){
+		sim.player = replay.header.player;
+		sim.ground_cache.num_faces = 0;
+		for(uint32_t i=0; i<replay.num_frames; i++){
+			const ReplayFrame &frame = replay.frames[i];
+			PROFILE_SCOPE("frame");
+			collision_stats_begin_frame();
+
+			std::chrono::high_resolution_clock::time_point start = std::chrono::high_resolution_clock::now();
+			save_snapshot(&snapshots, i, &sim); //state at start of frame i
+			std::chrono::high_resolution_clock::time_point saved = std::chrono::high_resolution_clock::now();
+			replay_tick(level, &player_collider, &sim, frame);
+			std::chrono::high_resolution_clock::time_point end = std::chrono::high_resolution_clock::now();
+			snapshot_time += std::chrono::duration<double, std::milli>(saved-start).count();
+			frame_times[repeat*replay.num_frames + i] = std::chrono::duration<double, std::milli>(end-saved).count();
+
+			if(frame.flags & REPLAY_CHECK){
+				vec3 error = sim.player.pos - frame.check_pos;
+				float e = MAX(fabsf(error.x), MAX(fabsf(error.y), fabsf(error.z)));
+				max_error = MAX(max_error, e);
+				if(e>0 && first_divergence<0) first_divergence = i;
+			}
+		}
+	}
+
+	//Roll back as far as the ring goes and re-simulate, should land on exactly the same state
+	uint32_t rollback_frame = (replay.num_frames>HEADLESS_ROLLBACK_FRAMES) ? replay.num_frames-HEADLESS_ROLLBACK_FRAMES : 0;
+	SimState rolled_back;
+	load_snapshot(snapshots, rollback_frame, &rolled_back);
+	for(uint32_t i=rollback_frame; i<replay.num_frames; i++) replay_tick(level, &player_collider, &rolled_back, replay.frames[i]);
+	bool rollback_matches = memcmp(&rolled_back, &sim, sizeof(SimState))==0;
+
+	uint32_t num_times = replay.num_frames*num_repeats;
+	double total = 0;
+	for(uint32_t i=0; i<num_times; i++) total += frame_times[i];
+	qsort(frame_times, num_times, sizeof(double), compare_frame_times);
+	printf("%u frames x %d: mean %.4fms, p50 %.4fms, p99 %.4fms, max %.4fms\n", replay.num_frames, num_repeats,
+		total/num_times, frame_times[num_times/2], frame_times[(uint32_t)(num_times*0.99)], frame_times[num_times-1]);
+	printf("Snapshots: %zu bytes, mean save %.5fms\n", sizeof(SimState), snapshot_time/num_times);
+	printf("Final player pos (%.6f, %.6f, %.6f)\n", sim.player.pos.x, sim.player.pos.y, sim.player.pos.z);
+	if(first_divergence>=0) printf("Trajectory diverged by frame %d (max error %g)\n", first_divergence, max_error);
+	else printf("Trajectory matches recording\n");
+	printf("Rollback of %u frames %s\n", replay.num_frames-rollback_frame, rollback_matches ? "reproduces final state" : "DOES NOT reproduce final state");
+
+	free(frame_times);
+	clear_snapshot_ring(&snapshots);
+	free_replay(&replay);
+	clear_level(&level);
+	return (first_divergence>=0 || !rollback_matches) ? 1 : 0;
+}
+#else
+
+//Create vao from a loaded mesh's positions, normals and indices
+GLuint upload_mesh_vao(const MeshLoad &mesh){
+	GLuint vao;
+	glGenVertexArrays(1, &vao);
+	glBindVertexArray(vao);
+
+	GLuint points_vbo;
+	glGenBuffers(1, &points_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, points_vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh.num_verts*3*sizeof(float), mesh.vp, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(VP_ATTRIB_LOC);
+	glVertexAttribPointer(VP_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+
+	GLuint normals_vbo;
+	glGenBuffers(1, &normals_vbo);
+	glBindBuffer(GL_ARRAY_BUFFER, normals_vbo);
+	glBufferData(GL_ARRAY_BUFFER, mesh.num_verts*3*sizeof(float), mesh.vn, GL_STATIC_DRAW);
+	glEnableVertexAttribArray(VN_ATTRIB_LOC);
+	glVertexAttribPointer(VN_ATTRIB_LOC, 3, GL_FLOAT, GL_FALSE, 0, NULL);
+
+	GLuint index_vbo;
+	glGenBuffers(1, &index_vbo);
+	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
+	glBufferData(GL_ELEMENT_ARRAY_BUFFER, mesh.num_indices*sizeof(unsigned short), mesh.indices, GL_STATIC_DRAW);
+	return vao;
+}
+
+int main(){
+	profiler_set_thread_name("main");
+	job_system_init();
+
+	//Start parsing meshes (and building the level collider) on workers before touching GL,
+	//they load while the window opens and shaders compile
+	MeshLoad player_mesh, ground_mesh;
+	submit_mesh_load(&player_mesh, "capsule.obj");
+	submit_mesh_load(&ground_mesh, "ground.obj", true);
+
+	if(!init_gl(window, "Level Collision", gl_width, gl_height)){
+		job_system_shutdown(); //finishes the loads, they point at our stack
+		free_mesh_load(&player_mesh);
+		free_mesh_load(&ground_mesh);
+		clear_level(&ground_mesh.level);
+		return 1;
 	}
 
 	g_camera.init(vec3(0,2,35), vec3(0,-5,0));
@@ -126,14 +204,64 @@ int main(){
 	Shader basic_shader = init_shader("MVP.vert", "uniform_colour_sunlight.frag");
 	GLuint colour_loc = glGetUniformLocation(basic_shader.id, "colour");
 
+	//Upload meshes as they arrive, helping the workers in the meantime
+	GLuint player_vao = 0, ground_vao = 0;
+	unsigned int player_num_indices = 0, ground_num_indices = 0;
+	LevelCollider level;
+	{
+		PROFILE_SCOPE("wait_for_meshes");
+		bool player_done = false, ground_done = false;
+		while(!player_done || !ground_done){
+			if(!player_done && mesh_load_done(player_mesh)){
+				if(player_mesh.loaded){
+					player_vao = upload_mesh_vao(player_mesh);
+					player_num_indices = player_mesh.num_indices;
+				}
+				free_mesh_load(&player_mesh);
+				player_done = true;
+			}
+			else if(!ground_done && mesh_load_done(ground_mesh)){
+				if(ground_mesh.loaded){
+					ground_vao = upload_mesh_vao(ground_mesh);
+					ground_num_indices = ground_mesh.num_indices;
+				}
+				free_mesh_load(&ground_mesh);
+				level = ground_mesh.level;
+				ground_done = true;
+			}
+			else if(!job_try_run()) std::this_thread::yield();
+		}
+	}
+	if(!player_mesh.loaded || !ground_mesh.loaded){
+		printf("Error: Failed to load %s\n", player_mesh.loaded ? ground_mesh.file_name : player_mesh.file_name);
+		clear_level(&level);
+		job_system_shutdown();
+		return 1;
+	}
+
+	//Player collision mesh
+	Capsule player_collider;
+	SimState sim = init_sim_state(player_start_pos);
+	mat4 player_M = translate(scale(identity_mat4(), player_scale), sim.player.pos);
+	{
+		player_collider.r = 1; 		//NB: these are the dimensions of the collider mesh (capsule.obj),
+		player_collider.y_base = 1; //they will be scaled using the player's model matrix!
+		player_collider.y_cap = 2;
+		player_collider.xform = make_transform(sim.player.pos, identity_quat(), player_scale);
+	}
+
 	check_gl_error();
 
+	ReplayRecorder replay_recorder = {};
+
     double curr_time = glfwGetTime(), prev_time, dt;
 	//-------------------------------------------------------------------------------------//
 	//-------------------------------------MAIN LOOP---------------------------------------//
 	//-------------------------------------------------------------------------------------//
 	while(!glfwWindowShouldClose(window)) {
+		PROFILE_SCOPE("frame");
 		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		collision_stats_begin_frame();
 
 		//Get dt
 		prev_time = curr_time;
@@ -144,12 +272,17 @@ int main(){
 		//Get Input
 		g_mouse.prev_xpos = g_mouse.xpos;
     	g_mouse.prev_ypos = g_mouse.ypos;
-		glfwPollEvents();
+		{
+			PROFILE_SCOPE("input_poll");
+			glfwPollEvents();
+		}
 		
 		//Check button presses
 		static bool freecam_mode = true;
 		static bool draw_wireframe = true;
+		uint8_t replay_flags = 0; //direct writes to the player this frame, for the replay
 		{
+			PROFILE_SCOPE("input_keys");
 			if(glfwGetKey(window, GLFW_KEY_ESCAPE)) {
 				glfwSetWindowShouldClose(window, 1);
 			}
@@ -174,8 +307,9 @@ int main(){
 			static bool r_was_pressed = false;
 			if(glfwGetKey(window, GLFW_KEY_R)) {
 				if(!r_was_pressed) {
-					player_pos = vec3(0,2,0);
-					player_vel = vec3(0,0,0);
+					sim.player.pos = vec3(0,2,0);
+					sim.player.vel = vec3(0,0,0);
+					replay_flags |= REPLAY_SET_PLAYER;
 				 }
 				r_was_pressed = true;
 			}
@@ -185,13 +319,43 @@ int main(){
 			static bool t_was_pressed = false;
 			if(glfwGetKey(window, GLFW_KEY_T)) {
 				if(!t_was_pressed) {
-					player_pos = g_camera.pos + g_camera.fwd*5 - g_camera.up*2;
-					player_vel = vec3(0,0,0);
+					sim.player.pos = g_camera.pos + g_camera.fwd*5 - g_camera.up*2;
+					sim.player.vel = vec3(0,0,0);
+					replay_flags |= REPLAY_SET_PLAYER;
 				 }
 				t_was_pressed = true;
 			}
 			else t_was_pressed = false;
 
+			//P to write profiler trace
+			static bool p_was_pressed = false;
+			if(glfwGetKey(window, GLFW_KEY_P)) {
+				if(!p_was_pressed) { profiler_write_trace("trace.json"); }
+				p_was_pressed = true;
+			}
+			else p_was_pressed = false;
+
+			//L to start/stop recording a replay (play it back with the HEADLESS build)
+			static bool l_was_pressed = false;
+			if(glfwGetKey(window, GLFW_KEY_L)) {
+				if(!l_was_pressed) {
+					if(replay_recorder.fp) end_replay_recording(&replay_recorder);
+					else if(begin_replay_recording(&replay_recorder, "replay.bin", sim.player)) {
+						sim.ground_cache.num_faces = 0; //replay starts with an empty cache too
+					}
+				}
+				l_was_pressed = true;
+			}
+			else l_was_pressed = false;
+
+			//H to print GJK/EPA iteration histograms
+			static bool h_was_pressed = false;
+			if(glfwGetKey(window, GLFW_KEY_H)) {
+				if(!h_was_pressed) { print_collision_histograms(collision_histograms()); }
+				h_was_pressed = true;
+			}
+			else h_was_pressed = false;
+
 			//Ctrl/Command-F to toggle fullscreen
 			//Note: window_resize_callback takes care of resizing viewport/recalculating P matrix
 			static bool F_was_pressed = false;
@@ -215,52 +379,77 @@ int main(){
 			else F_was_pressed = false;
 		}
 
+		vec3 replay_set_pos = sim.player.pos, replay_set_vel = sim.player.vel; //recorded if a key above set them
+
 		//Move player
-		if(!freecam_mode) player_update(dt);
-		player_collider.pos = player_pos;
-		player_collider.matRS = player_M;
-		player_collider.matRS_inverse = inverse(player_M);
+		if(!freecam_mode) {
+			PROFILE_SCOPE("player_update");
+			player_update(&sim.player, dt);
+		}
 
 		//Do collision with ground
-		collide_player_ground(level, &player_collider);
-		player_pos = player_collider.pos;
-		player_M = translate(scale(identity_mat4(), player_scale), player_pos);
+		{
+			PROFILE_SCOPE("collision");
+			player_collider.xform = make_transform(sim.player.pos, identity_quat(), player_scale);
+
+			collide_player_ground(level, &player_collider, &sim.player, &sim.ground_cache);
+			sim.player.pos = player_collider.xform.pos;
+			player_M = translate(scale(identity_mat4(), player_scale), sim.player.pos);
+		}
+
+		if(replay_recorder.fp){
+			if(freecam_mode) replay_flags |= REPLAY_FREECAM;
+			record_replay_frame(&replay_recorder, dt, replay_flags, replay_set_pos, replay_set_vel, sim.player);
+		}
 
 		//Update camera
-		if(freecam_mode)g_camera.update_debug(dt);
-		else g_camera.update_player(player_pos, dt);
-
-		glUseProgram(basic_shader.id);
-		glUniformMatrix4fv(basic_shader.V_loc, 1, GL_FALSE, g_camera.V.m);
-		glUniformMatrix4fv(basic_shader.P_loc, 1, GL_FALSE, g_camera.P.m);
-
-		//Draw player
-		glBindVertexArray(player_vao);
-		glUniform4fv(colour_loc, 1, player_colour.v);
-		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, player_M.m);
-        glDrawElements(GL_TRIANGLES, player_num_indices, GL_UNSIGNED_SHORT, 0);
-
-		//Draw ground
-		glBindVertexArray(ground_vao);
-		glUniform4fv(colour_loc, 1, vec4(0.6,0.7,0.8,1).v);
-		glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, identity_mat4().m);
-        glDrawElements(GL_TRIANGLES, ground_num_indices, GL_UNSIGNED_SHORT, 0);
-
-		if(draw_wireframe){
-			glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
-			glUseProgram(debug_shader.id);
-			glUniform4fv(colour_loc, 1, vec4(0,0,0,1).v);
-			glUniformMatrix4fv(debug_shader.M_loc, 1, GL_FALSE, identity_mat4().m);
-			glUniformMatrix4fv(debug_shader.V_loc, 1, GL_FALSE, g_camera.V.m);
-			glUniformMatrix4fv(debug_shader.P_loc, 1, GL_FALSE, g_camera.P.m);
-			glDrawElements(GL_TRIANGLES, ground_num_indices, GL_UNSIGNED_SHORT, 0);
-			glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+		{
+			PROFILE_SCOPE("camera_update");
+			if(freecam_mode)g_camera.update_debug(dt);
+			else g_camera.update_player(sim.player.pos, dt);
+		}
+
+		//Draw
+		{
+			PROFILE_SCOPE("draw");
+			glUseProgram(basic_shader.id);
+			glUniformMatrix4fv(basic_shader.V_loc, 1, GL_FALSE, g_camera.V.m);
+			glUniformMatrix4fv(basic_shader.P_loc, 1, GL_FALSE, g_camera.P.m);
+
+			//Draw player
+			glBindVertexArray(player_vao);
+			glUniform4fv(colour_loc, 1, player_colour.v);
+			glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, player_M.m);
+	        glDrawElements(GL_TRIANGLES, player_num_indices, GL_UNSIGNED_SHORT, 0);
+
+			//Draw ground
+			glBindVertexArray(ground_vao);
+			glUniform4fv(colour_loc, 1, vec4(0.6,0.7,0.8,1).v);
+			glUniformMatrix4fv(basic_shader.M_loc, 1, GL_FALSE, identity_mat4().m);
+	        glDrawElements(GL_TRIANGLES, ground_num_indices, GL_UNSIGNED_SHORT, 0);
+
+			if(draw_wireframe){
+				glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
+				glUseProgram(debug_shader.id);
+				glUniform4fv(colour_loc, 1, vec4(0,0,0,1).v);
+				glUniformMatrix4fv(debug_shader.M_loc, 1, GL_FALSE, identity_mat4().m);
+				glUniformMatrix4fv(debug_shader.V_loc, 1, GL_FALSE, g_camera.V.m);
+				glUniformMatrix4fv(debug_shader.P_loc, 1, GL_FALSE, g_camera.P.m);
+				glDrawElements(GL_TRIANGLES, ground_num_indices, GL_UNSIGNED_SHORT, 0);
+				glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+			}
 		}
 
-		glfwSwapBuffers(window);
+		{
+			PROFILE_SCOPE("swap");
+			glfwSwapBuffers(window);
+		}
 
 		check_gl_error();
 	}//end main loop
 
+	end_replay_recording(&replay_recorder);
+	job_system_shutdown();
     return 0;
 }
+#endif
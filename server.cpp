@@ -0,0 +1,312 @@
+//Dedicated server benchmark: N characters simulated at a fixed tick rate against a level, no window or GL
+//Inputs are scripted (seeded random walks) or taken from a replay recorded in the game (see Replay.h)
+//Reports tick latency percentiles, overruns and CPU usage, and how many agents fit a 16ms/33ms tick on one core
+//Everything runs on one thread, so numbers are per core
+//Usage: levelcollision_server [--agents N] [--hz N] [--ticks N] [--level file.obj] [--replay file.bin] [--fast] [--quantise] [--agent-collision]
+//--quantise stores the level's verts compressed (see compress_level_verts()), to compare tick cost against floats
+//--agent-collision makes agents push each other apart, found with a dynamic AABB tree (see AABBTree.h)
+#ifndef HEADLESS
+#define HEADLESS
+#endif
+#define GLFW_INCLUDE_NONE //only want GLFW's types and key codes, nothing gets linked
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <thread>
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+GLFWwindow* window = NULL;
+int gl_width = 1080;
+int gl_height = 720;
+float gl_aspect_ratio = (float)gl_width/gl_height;
+bool gl_fullscreen = false;
+
+#include "GameMaths.h"
+#include "Profiler.h"
+#include "Input.h"
+#include "Camera3D.h"
+#include "load_obj.h"
+#include "Player.h"
+#include "GJK.h"
+#include "Level.h"
+#include "Replay.h"
+#include "SimState.h"
+#include "AABBTree.h"
+#include "Narrowphase.h"
+
+#define SERVER_SPAWN_RADIUS 10.0f	//agents start scattered this far around player_start_pos (xz)
+#define SERVER_KILL_Y -50.0f		//agents that fall off the level respawn
+#define SERVER_MAX_AGENT_NEIGHBOURS 64	//agents whose fat bounds overlap one agent's, per tick
+
+typedef std::chrono::steady_clock ServerClock;
+
+//Per-agent scripted input: hold a random set of buttons and a random heading for a while, then pick again
+struct AgentScript {
+	uint32_t rng;
+	int ticks_left;
+	ReplayFrame input;
+};
+
+static uint32_t next_random(uint32_t* state){
+	//xorshift32
+	uint32_t x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	*state = x;
+	return x;
+}
+
+static float random_float(uint32_t* state){
+	return (next_random(state) >> 8)*(1.0f/16777216.0f);
+}
+
+static vec3 random_spawn(uint32_t* rng){
+	float angle = (float)(random_float(rng)*TAU);
+	float r = sqrtf(random_float(rng))*SERVER_SPAWN_RADIUS;
+	return player_start_pos + vec3(r*cosf(angle), 0, r*sinf(angle));
+}
+
+static void update_agent_script(AgentScript* script, double dt){
+	if(script->ticks_left-- > 0) return;
+	uint32_t* rng = &script->rng;
+	script->ticks_left = 30 + next_random(rng)%90;
+	uint16_t bits = 0;
+	if(random_float(rng)<0.7f) bits |= 1<<MOVE_FORWARD;
+	if(random_float(rng)<0.2f) bits |= 1<<MOVE_LEFT;
+	else if(random_float(rng)<0.2f) bits |= 1<<MOVE_RIGHT;
+	if(random_float(rng)<0.3f) bits |= 1<<JUMP;
+	float yaw = (float)(random_float(rng)*TAU);
+	script->input.dt = dt;
+	script->input.input_bits = bits;
+	script->input.flags = 0;
+	script->input.cam_fwd_xz[0] = sinf(yaw);
+	script->input.cam_fwd_xz[1] = -cosf(yaw);
+	script->input.cam_rgt_xz[0] = cosf(yaw);
+	script->input.cam_rgt_xz[1] = sinf(yaw);
+}
+
+//Process CPU time (user + system) in seconds
+static double get_cpu_time(){
+#ifdef _WIN32
+	FILETIME create_time, exit_time, kernel_time, user_time;
+	GetProcessTimes(GetCurrentProcess(), &create_time, &exit_time, &kernel_time, &user_time);
+	ULARGE_INTEGER kernel, user;
+	kernel.LowPart = kernel_time.dwLowDateTime; kernel.HighPart = kernel_time.dwHighDateTime;
+	user.LowPart = user_time.dwLowDateTime; user.HighPart = user_time.dwHighDateTime;
+	return (kernel.QuadPart + user.QuadPart)*1e-7;
+#else
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_utime.tv_usec*1e-6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec*1e-6;
+#endif
+}
+
+static int compare_tick_times(const void* a, const void* b){
+	double da = *(const double*)a, db = *(const double*)b;
+	return (da>db) - (da<db);
+}
+
+int main(int argc, char** argv){
+	int num_agents = 100;
+	int tick_rate = 60;
+	int num_ticks = 600;
+	const char* level_file = "ground.obj";
+	const char* replay_file = NULL;
+	bool fast = false; //don't sleep between ticks, just measure
+	bool quantise = false;
+	bool agent_collision = false;
+	for(int i=1; i<argc; i++){
+		if(!strcmp(argv[i], "--agents") && i+1<argc) num_agents = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--hz") && i+1<argc) tick_rate = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--ticks") && i+1<argc) num_ticks = atoi(argv[++i]);
+		else if(!strcmp(argv[i], "--level") && i+1<argc) level_file = argv[++i];
+		else if(!strcmp(argv[i], "--replay") && i+1<argc) replay_file = argv[++i];
+		else if(!strcmp(argv[i], "--fast")) fast = true;
+		else if(!strcmp(argv[i], "--quantise")) quantise = true;
+		else if(!strcmp(argv[i], "--agent-collision")) agent_collision = true;
+		else {
+			printf("Usage: %s [--agents N] [--hz N] [--ticks N] [--level file.obj] [--replay file.bin] [--fast] [--quantise] [--agent-collision]\n", argv[0]);
+			return 1;
+		}
+	}
+	if(num_agents<1 || tick_rate<1 || num_ticks<1){
+		printf("Error: agents, hz and ticks must be positive\n");
+		return 1;
+	}
+	profiler_set_thread_name("server");
+
+	LevelCollider level;
+	{
+		float* vp = NULL;
+		uint16_t* indices = NULL;
+		uint32_t num_verts = 0, num_indices = 0;
+		if(!load_obj_indexed(level_file, &vp, &indices, &num_verts, &num_indices)) return 1;
+		level = init_level(vp, indices, num_verts, num_indices);
+		if(quantise) compress_level_verts(&level);
+	}
+
+	Replay replay;
+	replay.num_frames = 0;
+	if(replay_file){
+		if(!load_replay(replay_file, &replay)) return 1;
+		if(replay.num_frames==0){
+			printf("Error: replay %s has no frames\n", replay_file);
+			return 1;
+		}
+	}
+
+	double dt = 1.0/tick_rate;
+	double budget_ms = 1000.0/tick_rate;
+
+	//Agent state is contiguous so the whole server could be snapshotted with one memcpy (see SimState.h)
+	SimState* agents = (SimState*)malloc(num_agents*sizeof(SimState));
+	AgentScript* scripts = (AgentScript*)malloc(num_agents*sizeof(AgentScript));
+	for(int i=0; i<num_agents; i++){
+		scripts[i].rng = 0x9E3779B9u*(i+1);
+		scripts[i].ticks_left = 0;
+		agents[i] = init_sim_state(random_spawn(&scripts[i].rng));
+	}
+
+	Capsule collider;
+	collider.r = 1;
+	collider.y_base = 1;
+	collider.y_cap = 2;
+
+	//With agent collision each agent keeps its own capsule in the tree
+	Capsule* agent_colliders = NULL;
+	int32_t* agent_proxies = NULL;
+	AABBTree agent_tree;
+	uint64_t num_agent_pushes = 0;
+	int num_truncated_queries = 0;
+	if(agent_collision){
+		agent_colliders = new Capsule[num_agents];
+		agent_proxies = (int32_t*)malloc(num_agents*sizeof(int32_t));
+		agent_tree = init_aabb_tree(2*num_agents);
+		for(int i=0; i<num_agents; i++){
+			agent_colliders[i].r = collider.r;
+			agent_colliders[i].y_base = collider.y_base;
+			agent_colliders[i].y_cap = collider.y_cap;
+			agent_colliders[i].xform = make_transform(agents[i].player.pos, identity_quat(), player_scale);
+			agent_proxies[i] = aabb_tree_insert(&agent_tree, &agent_colliders[i]);
+		}
+	}
+
+	double* tick_times = (double*)malloc(num_ticks*sizeof(double));
+	int num_overruns = 0;
+	ServerClock::time_point start = ServerClock::now();
+	ServerClock::time_point next_tick = start;
+	double cpu_start = get_cpu_time();
+
+	for(int tick=0; tick<num_ticks; tick++){
+		ServerClock::time_point tick_start = ServerClock::now();
+		{
+			PROFILE_SCOPE("tick");
+			collision_stats_begin_frame();
+			for(int i=0; i<num_agents; i++){
+				SimState* agent = &agents[i];
+				ReplayFrame input;
+				if(replay_file){
+					//Each agent plays the recording from a different point so they don't move in lockstep
+					input = replay.frames[(tick + i*(replay.num_frames/num_agents + 1)) % replay.num_frames];
+					input.flags &= ~REPLAY_SET_PLAYER;
+				}
+				else {
+					update_agent_script(&scripts[i], dt);
+					input = scripts[i].input;
+				}
+				apply_replay_frame(input, &agent->player);
+				if(!(input.flags & REPLAY_FREECAM)) player_update(&agent->player, dt);
+
+				collider.xform = make_transform(agent->player.pos, identity_quat(), player_scale);
+				collide_player_ground(level, &collider, &agent->player, &agent->ground_cache);
+				agent->player.pos = collider.xform.pos;
+
+				if(agent->player.pos.y<SERVER_KILL_Y){
+					agent->player = init_player_state(random_spawn(&scripts[i].rng));
+					agent->ground_cache.num_faces = 0;
+				}
+			}
+
+			if(agent_collision){
+				PROFILE_SCOPE("agent_collision");
+				for(int i=0; i<num_agents; i++){
+					vec3 displacement = agents[i].player.pos - agent_colliders[i].xform.pos;
+					agent_colliders[i].xform.pos = agents[i].player.pos;
+					aabb_tree_move(&agent_tree, agent_proxies[i], displacement);
+				}
+				//Each overlapping pair is pushed apart once, half each way, in the xz plane so nobody gets pushed into the ground
+				for(int i=0; i<num_agents; i++){
+					Collider* neighbours[SERVER_MAX_AGENT_NEIGHBOURS];
+					int num_neighbours = aabb_tree_query(agent_tree, collider_aabb(&agent_colliders[i]), neighbours, SERVER_MAX_AGENT_NEIGHBOURS);
+					if(num_neighbours==SERVER_MAX_AGENT_NEIGHBOURS) num_truncated_queries++;
+					for(int k=0; k<num_neighbours; k++){
+						int j = (int)((Capsule*)neighbours[k] - agent_colliders);
+						if(j<=i) continue;
+						vec3 mtv;
+						if(!collide(&agent_colliders[i], &agent_colliders[j], &mtv)) continue;
+						mtv.y = 0;
+						agent_colliders[i].xform.pos += mtv*0.5f;
+						agent_colliders[j].xform.pos -= mtv*0.5f;
+						num_agent_pushes++;
+					}
+				}
+				for(int i=0; i<num_agents; i++) agents[i].player.pos = agent_colliders[i].xform.pos;
+			}
+		}
+		ServerClock::time_point tick_end = ServerClock::now();
+		tick_times[tick] = std::chrono::duration<double, std::milli>(tick_end-tick_start).count();
+		if(tick_times[tick]>budget_ms) num_overruns++;
+
+		if(fast) continue;
+		next_tick += std::chrono::duration_cast<ServerClock::duration>(std::chrono::duration<double>(dt));
+		if(next_tick>tick_end) std::this_thread::sleep_until(next_tick);
+		else next_tick = tick_end; //fell behind, don't try to catch up with a burst of ticks
+	}
+
+	double wall_time = std::chrono::duration<double>(ServerClock::now()-start).count();
+	double cpu_time = get_cpu_time() - cpu_start;
+
+	double total = 0;
+	for(int i=0; i<num_ticks; i++) total += tick_times[i];
+	double mean = total/num_ticks;
+	qsort(tick_times, num_ticks, sizeof(double), compare_tick_times);
+	double p50 = tick_times[num_ticks/2];
+	double p90 = tick_times[(int)(num_ticks*0.9)];
+	double p99 = tick_times[(int)(num_ticks*0.99)];
+	double p999 = tick_times[(int)(num_ticks*0.999)];
+	double max = tick_times[num_ticks-1];
+
+	printf("%d agents, %d ticks at %dHz (%.2fms budget), %s inputs%s\n", num_agents, num_ticks, tick_rate, budget_ms,
+		replay_file ? "replayed" : "scripted", fast ? ", not sleeping" : "");
+	printf("Level: %u faces, %zu bytes%s\n", level.num_faces, level_memory_usage(level), level.quantised_verts ? " (quantised verts)" : "");
+	printf("Tick latency: mean %.3fms, p50 %.3fms, p90 %.3fms, p99 %.3fms, p99.9 %.3fms, max %.3fms\n", mean, p50, p90, p99, p999, max);
+	printf("Overruns: %d (%.2f%%)\n", num_overruns, 100.0*num_overruns/num_ticks);
+	if(agent_collision){
+		printf("Agent collision: %.1f pairs pushed apart per tick, tree height %d\n", (double)num_agent_pushes/num_ticks, agent_tree.nodes[agent_tree.root].height);
+		if(num_truncated_queries) printf("Warning: %d agent queries hit SERVER_MAX_AGENT_NEIGHBOURS, some pairs were missed\n", num_truncated_queries);
+	}
+	printf("CPU: %.2fs over %.2fs wall (%.1f%% of one core)\n", cpu_time, wall_time, 100.0*cpu_time/wall_time);
+	//Linear extrapolation from p99, real scaling will be a bit worse once agents stop fitting in cache
+	double p99_per_agent = p99/num_agents;
+	printf("Per agent: %.4fms mean, %.4fms at p99 -> ~%d agents/core at 16ms, ~%d at 33ms\n", mean/num_agents, p99_per_agent,
+		(int)(16.0/p99_per_agent), (int)(33.0/p99_per_agent));
+
+	if(agent_collision){
+		clear_aabb_tree(&agent_tree);
+		free(agent_proxies);
+		delete[] agent_colliders;
+	}
+	free(tick_times);
+	free(scripts);
+	free(agents);
+	if(replay_file) free_replay(&replay);
+	clear_level(&level);
+	return 0;
+}
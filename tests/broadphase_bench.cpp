@@ -0,0 +1,122 @@
+//Broadphase cost vs agent count: sort-and-sweep (SweepAndPrune.h) against the dynamic AABB tree and brute force
+//Agents are capsules scattered over a plane at a fixed density, so each has about the same number of neighbours
+//at every size, and jitter a little every update like a crowd milling about
+//Usage: broadphase_bench [max_agents] [updates]
+#include "sim_headers.h"
+#include "AABBTree.h"
+#include "SweepAndPrune.h"
+#include "test.h"
+#include <chrono>
+
+#define BENCH_AREA_PER_AGENT 2.0f		//m^2, capsules are 0.5m wide
+#define BENCH_JITTER 0.05f				//per update
+#define BENCH_MAX_BRUTE_FORCE_AGENTS 4096	//O(n^2) gets silly past this
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ms_since(BenchClock::time_point start){
+	return std::chrono::duration<double, std::milli>(BenchClock::now()-start).count();
+}
+
+struct BenchResult {
+	double sap_us;		//per update
+	double tree_us;
+	double brute_us;
+	int sap_pairs;		//last update
+	int tree_pairs;
+	int brute_pairs;	//-1 if skipped
+};
+
+static BenchResult bench_agents(int num_agents, int updates){
+	BenchResult result;
+	float half_size = 0.5f*sqrtf(num_agents*BENCH_AREA_PER_AGENT);
+	Capsule* agents = new Capsule[num_agents];
+	for(int i=0; i<num_agents; i++){
+		agents[i].r = 1;
+		agents[i].y_base = 1;
+		agents[i].y_cap = 2;
+		agents[i].xform = make_transform(vec3(random_float(-half_size, half_size), 0, random_float(-half_size, half_size)), identity_quat(), player_scale);
+	}
+	int max_pairs = 16*num_agents;
+	ColliderPair* pairs = (ColliderPair*)malloc(max_pairs*sizeof(ColliderPair));
+	Collider** neighbours = (Collider**)malloc(num_agents*sizeof(Collider*));
+	AABB* bounds = (AABB*)malloc(num_agents*sizeof(AABB));
+	vec3* displacements = (vec3*)malloc(num_agents*sizeof(vec3));
+
+	SweepAndPrune sap = init_sweep_and_prune(num_agents);
+	AABBTree tree = init_aabb_tree(2*num_agents);
+	int32_t* proxies = (int32_t*)malloc(num_agents*sizeof(int32_t));
+	for(int i=0; i<num_agents; i++){
+		sap_add(&sap, &agents[i]);
+		proxies[i] = aabb_tree_insert(&tree, &agents[i]);
+	}
+
+	double sap_ms = 0, tree_ms = 0, brute_ms = 0;
+	bool brute_force = num_agents<=BENCH_MAX_BRUTE_FORCE_AGENTS;
+	for(int u=0; u<updates; u++){
+		for(int i=0; i<num_agents; i++){
+			displacements[i] = vec3(random_float(-BENCH_JITTER, BENCH_JITTER), 0, random_float(-BENCH_JITTER, BENCH_JITTER));
+			agents[i].xform.pos += displacements[i];
+		}
+
+		BenchClock::time_point start = BenchClock::now();
+		for(int i=0; i<num_agents; i++) aabb_tree_move(&tree, proxies[i], displacements[i]);
+		result.tree_pairs = 0;
+		for(int i=0; i<num_agents; i++){
+			AABB box = collider_aabb(&agents[i]);
+			int n = aabb_tree_query(tree, box, neighbours, num_agents);
+			for(int k=0; k<n; k++){
+				//Tree has fat bounds, count the same pairs as the others
+				if(neighbours[k]<=&agents[i]) continue;
+				if(aabb_overlaps(collider_aabb(neighbours[k]), box)) result.tree_pairs++;
+			}
+		}
+		tree_ms += ms_since(start);
+
+		start = BenchClock::now();
+		result.sap_pairs = sap_update(&sap, pairs, max_pairs);
+		sap_ms += ms_since(start);
+
+		if(brute_force){
+			start = BenchClock::now();
+			for(int i=0; i<num_agents; i++) bounds[i] = collider_aabb(&agents[i]);
+			result.brute_pairs = 0;
+			for(int i=0; i<num_agents; i++){
+				for(int j=i+1; j<num_agents; j++){
+					if(aabb_overlaps(bounds[i], bounds[j])) result.brute_pairs++;
+				}
+			}
+			brute_ms += ms_since(start);
+		}
+	}
+	result.sap_us = 1e3*sap_ms/updates;
+	result.tree_us = 1e3*tree_ms/updates;
+	result.brute_us = brute_force ? 1e3*brute_ms/updates : 0;
+	if(!brute_force) result.brute_pairs = -1;
+
+	clear_sweep_and_prune(&sap);
+	clear_aabb_tree(&tree);
+	free(proxies);
+	free(displacements);
+	free(bounds);
+	free(neighbours);
+	free(pairs);
+	delete[] agents;
+	return result;
+}
+
+int main(int argc, char** argv){
+	test_seed(2024);
+	int max_agents = (argc>1) ? atoi(argv[1]) : 32000;
+	int updates = (argc>2) ? MAX(atoi(argv[2]), 1) : 20;
+
+	printf("%d updates per size, %.1fm^2 per agent\n", updates, BENCH_AREA_PER_AGENT);
+	printf("%8s %12s %12s %12s %10s %10s %10s\n", "agents", "sap (us)", "tree (us)", "brute (us)", "sap pairs", "tree pairs", "brute pairs");
+	for(int num_agents=1000; num_agents<=max_agents; num_agents*=2){
+		BenchResult r = bench_agents(num_agents, updates);
+		printf("%8d %12.1f %12.1f ", num_agents, r.sap_us, r.tree_us);
+		if(r.brute_pairs>=0) printf("%12.1f %10d %10d %10d\n", r.brute_us, r.sap_pairs, r.tree_pairs, r.brute_pairs);
+		else printf("%12s %10d %10d %10s\n", "-", r.sap_pairs, r.tree_pairs, "-");
+	}
+	return 0;
+}
@@ -0,0 +1,204 @@
+//Broadphase structures against brute force over randomly moving colliders
+//AABB tree (AABBTree.h): queries find everything overlapping, with no duplicates, and the tree stays balanced
+//Sort-and-sweep (SweepAndPrune.h): pairs match brute force every update, including after the sort axis changes
+//Spatial hash (SpatialHash.h): built across worker threads, queries of any radius return each point within it once
+#include "sim_headers.h"
+#include "AABBTree.h"
+#include "SweepAndPrune.h"
+#include "SpatialHash.h"
+#include "test.h"
+
+#define TEST_NUM_COLLIDERS 500
+#define TEST_NUM_ROUNDS 50
+#define TEST_NUM_QUERIES 50
+#define TEST_WORLD_SIZE 50.0f
+
+static vec3 random_point(float size){
+	return vec3(random_float(-size, size), random_float(-size, size), random_float(-size, size));
+}
+
+static int find_collider(Collider* const* colliders, int count, const Collider* c){
+	for(int i=0; i<count; i++){
+		if(colliders[i]==c) return i;
+	}
+	return -1;
+}
+
+static void check_aabb_tree(){
+	Sphere* spheres = new Sphere[TEST_NUM_COLLIDERS];
+	int32_t proxies[TEST_NUM_COLLIDERS];
+	bool in_tree[TEST_NUM_COLLIDERS];
+	AABBTree tree = init_aabb_tree();
+	for(int i=0; i<TEST_NUM_COLLIDERS; i++){
+		spheres[i].r = random_float(0.2f, 2.0f);
+		spheres[i].xform.pos = random_point(TEST_WORLD_SIZE);
+		proxies[i] = aabb_tree_insert(&tree, &spheres[i]);
+		in_tree[i] = true;
+	}
+
+	int max_height = 0;
+	for(int round=0; round<TEST_NUM_ROUNDS; round++){
+		//Most colliders shuffle a little, some teleport, a few leave or come back
+		for(int i=0; i<TEST_NUM_COLLIDERS; i++){
+			float r = random_float(0, 1);
+			if(r<0.02f){
+				if(in_tree[i]) aabb_tree_remove(&tree, proxies[i]);
+				else proxies[i] = aabb_tree_insert(&tree, &spheres[i]);
+				in_tree[i] = !in_tree[i];
+				continue;
+			}
+			vec3 displacement = (r<0.1f) ? random_point(TEST_WORLD_SIZE)-spheres[i].xform.pos : random_point(0.3f);
+			spheres[i].xform.pos += displacement;
+			if(in_tree[i]) aabb_tree_move(&tree, proxies[i], displacement);
+		}
+		max_height = MAX(max_height, tree.nodes[tree.root].height);
+
+		for(int q=0; q<TEST_NUM_QUERIES; q++){
+			AABB box;
+			vec3 center = random_point(TEST_WORLD_SIZE);
+			vec3 half_size = vec3(random_float(0.1f, 8), random_float(0.1f, 8), random_float(0.1f, 8));
+			box.min = center - half_size;
+			box.max = center + half_size;
+			Collider* results[TEST_NUM_COLLIDERS];
+			int num_results = aabb_tree_query(tree, box, results, TEST_NUM_COLLIDERS);
+
+			//Every collider overlapping the box is found once; everything found has fat bounds overlapping the box
+			int missed = 0, duplicates = 0, wrong = 0;
+			for(int i=0; i<TEST_NUM_COLLIDERS; i++){
+				int found = find_collider(results, num_results, &spheres[i]);
+				if(found>=0 && find_collider(results+found+1, num_results-found-1, &spheres[i])>=0) duplicates++;
+				if(found>=0 && (!in_tree[i] || !aabb_overlaps(tree.nodes[proxies[i]].bounds, box))) wrong++;
+				if(found<0 && in_tree[i] && aabb_overlaps(collider_aabb(&spheres[i]), box)) missed++;
+			}
+			CHECK(missed==0);
+			CHECK(duplicates==0);
+			CHECK(wrong==0);
+
+			//A full results buffer stops the query, it doesn't overrun
+			if(num_results>2) CHECK(aabb_tree_query(tree, box, results, 2)==2);
+		}
+	}
+	//AVL balanced: height is at most ~1.44*log2(n)
+	CHECK(max_height<=(int)(1.45f*log2f(TEST_NUM_COLLIDERS+2.0f))+1);
+	printf("aabb tree: %d colliders, max height %d\n", TEST_NUM_COLLIDERS, max_height);
+
+	clear_aabb_tree(&tree);
+	delete[] spheres;
+}
+
+struct IndexPair {
+	int a, b;	//a<b
+};
+
+static int compare_index_pairs(const void* pa, const void* pb){
+	const IndexPair* a = (const IndexPair*)pa;
+	const IndexPair* b = (const IndexPair*)pb;
+	if(a->a!=b->a) return (a->a>b->a) - (a->a<b->a);
+	return (a->b>b->b) - (a->b<b->b);
+}
+
+static void check_sweep_and_prune(){
+	Sphere* spheres = new Sphere[TEST_NUM_COLLIDERS];
+	SweepAndPrune sap = init_sweep_and_prune();
+	for(int i=0; i<TEST_NUM_COLLIDERS; i++){
+		spheres[i].r = random_float(0.2f, 1.0f);
+		//Strung out along x at first, so the sweep sorts on x
+		spheres[i].xform.pos = vec3(random_float(-TEST_WORLD_SIZE, TEST_WORLD_SIZE), random_float(-2, 2), random_float(-2, 2));
+		sap_add(&sap, &spheres[i]);
+	}
+	int max_pairs = TEST_NUM_COLLIDERS*TEST_NUM_COLLIDERS/2;
+	ColliderPair* pairs = (ColliderPair*)malloc(max_pairs*sizeof(ColliderPair));
+	IndexPair* found = (IndexPair*)malloc(max_pairs*sizeof(IndexPair));
+	IndexPair* expected = (IndexPair*)malloc(max_pairs*sizeof(IndexPair));
+	int first_axis = -1;
+
+	for(int update=0; update<3*SAP_AXIS_CHECK_INTERVAL; update++){
+		//Halfway through the crowd turns to run along z, the next axis check has to notice and re-sort
+		bool turn = (update==3*SAP_AXIS_CHECK_INTERVAL/2);
+		for(int i=0; i<TEST_NUM_COLLIDERS; i++){
+			vec3 &pos = spheres[i].xform.pos;
+			if(turn) pos = vec3(random_float(-2, 2), random_float(-2, 2), random_float(-TEST_WORLD_SIZE, TEST_WORLD_SIZE));
+			else pos += random_point(0.2f);
+		}
+
+		int num_pairs = sap_update(&sap, pairs, max_pairs);
+		if(first_axis<0) first_axis = sap.axis;
+		for(int i=0; i<num_pairs; i++){
+			int a = (int)((Sphere*)pairs[i].a - spheres);
+			int b = (int)((Sphere*)pairs[i].b - spheres);
+			found[i].a = MIN(a, b);
+			found[i].b = MAX(a, b);
+		}
+		qsort(found, num_pairs, sizeof(IndexPair), compare_index_pairs);
+
+		int num_expected = 0;
+		for(int a=0; a<TEST_NUM_COLLIDERS; a++){
+			AABB box = collider_aabb(&spheres[a]);
+			for(int b=a+1; b<TEST_NUM_COLLIDERS; b++){
+				if(!aabb_overlaps(box, collider_aabb(&spheres[b]))) continue;
+				expected[num_expected].a = a;
+				expected[num_expected].b = b;
+				num_expected++;
+			}
+		}
+		CHECK(num_pairs==num_expected);
+		CHECK(num_pairs==num_expected && memcmp(found, expected, num_pairs*sizeof(IndexPair))==0);
+	}
+	CHECK(first_axis==0);
+	CHECK(sap.axis==2);
+	printf("sweep and prune: %d colliders, sort axis %d -> %d\n", TEST_NUM_COLLIDERS, first_axis, sap.axis);
+
+	free(expected);
+	free(found);
+	free(pairs);
+	clear_sweep_and_prune(&sap);
+	delete[] spheres;
+}
+
+static int compare_ids(const void* a, const void* b){
+	uint32_t ia = *(const uint32_t*)a, ib = *(const uint32_t*)b;
+	return (ia>ib) - (ia<ib);
+}
+
+static void check_spatial_hash(){
+	//More points than one parallel_for batch, so the build really is split across threads
+	const uint32_t num_points = 3*SPATIAL_HASH_BATCH_SIZE;
+	vec3* positions = (vec3*)malloc(num_points*sizeof(vec3));
+	for(uint32_t i=0; i<num_points; i++) positions[i] = random_point(TEST_WORLD_SIZE);
+	SpatialHash hash = init_spatial_hash(num_points, 2.0f);
+	build_spatial_hash(&hash, positions, num_points);
+
+	uint32_t* results = (uint32_t*)malloc(num_points*sizeof(uint32_t));
+	uint32_t* expected = (uint32_t*)malloc(num_points*sizeof(uint32_t));
+	int max_found = 0;
+	for(int q=0; q<TEST_NUM_QUERIES; q++){
+		//Radii up to 8 cells, so big queries cover thousands of cells and plenty of them share buckets
+		vec3 center = random_point(TEST_WORLD_SIZE);
+		float radius = (q%2) ? random_float(0.5f, 3.0f) : random_float(3.0f, 16.0f);
+		int num_results = query_spatial_hash(hash, center, radius, results, num_points);
+		int num_expected = 0;
+		for(uint32_t i=0; i<num_points; i++){
+			if(length2(positions[i]-center)<=radius*radius) expected[num_expected++] = i;
+		}
+		qsort(results, num_results, sizeof(uint32_t), compare_ids);
+		CHECK(num_results==num_expected);
+		CHECK(num_results==num_expected && memcmp(results, expected, num_results*sizeof(uint32_t))==0);
+		max_found = MAX(max_found, num_results);
+	}
+	printf("spatial hash: %u points, %d worker threads, up to %d points per query\n", num_points, job_system_num_workers(), max_found);
+
+	free(expected);
+	free(results);
+	clear_spatial_hash(&hash);
+	free(positions);
+}
+
+int main(){
+	test_seed(4321);
+	job_system_init(3);
+	check_aabb_tree();
+	check_sweep_and_prune();
+	check_spatial_hash();
+	job_system_shutdown();
+	return test_result("broadphase_test");
+}
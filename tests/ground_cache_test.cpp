@@ -0,0 +1,355 @@
+//Ground cache (walk_player_ground() in Level.h) against full searches: agents colliding with a cache have to
+//end up exactly where testing every face puts them. Covers faces near the agent outnumbering the cached seeds
+//(dense mesh) and a wall that only joins the floor outside the search sphere
+//Also checks the adjacency the walk follows (MeshAdjacency.h) against brute force on cube.obj: whole, with a side
+//missing, and as two separate copies
+//Moving platforms (Platform.h): refitted bounds hold their faces, chunked sphere queries find what brute force
+//finds, and a player standing on a lift gets carried with it
+#define COLLISION_STATS
+#include "sim_headers.h"
+#include "test.h"
+
+#define TEST_NUM_AGENTS 20
+#define TEST_NUM_STEPS 150
+#define TEST_STEP_SIZE 0.05f
+#define TEST_PLATFORM_CELLS 15		//odd, so BVH leaves hold 3 or 4 faces and don't line up with query chunks
+#define TEST_PLATFORM_CELL_SIZE 0.25f
+#define TEST_NUM_PLATFORM_MOVES 20
+#define TEST_NUM_PLATFORM_QUERIES 20
+#define TEST_NUM_LIFT_TICKS 30
+
+static float grid_jitter(int i, int j, int cells, float jitter){
+	if(i==0 || i==cells) return 0;
+	return ((hash_u32(i*7919u + j*104729u) & 0xFF)/255.0f - 0.5f)*2*jitter;
+}
+
+//Flat shaded grid like load_obj_indexed output (3 verts per face), xz jittered so it isn't detected as a heightfield
+//wall adds a panel standing at x=5 that's only connected to the floor by a sliver at its z=-3 end
+static LevelCollider make_test_level(int cells, float cell_size, float bumpiness, bool wall){
+	uint32_t num_faces = 2*cells*cells + (wall ? 3 : 0);
+	float* vp = (float*)malloc(9*num_faces*sizeof(float));
+	uint16_t* indices = (uint16_t*)malloc(3*num_faces*sizeof(uint16_t));
+	uint32_t v = 0;
+	float jitter = wall ? 0 : 0.25f*cell_size;
+	#define GRID_POINT(i, j) vec3(((i)-cells/2)*cell_size + grid_jitter(i, j, cells, jitter), 0, ((j)-cells/2)*cell_size + grid_jitter(j, i, cells, jitter))
+	for(int j=0; j<cells; j++)
+	for(int i=0; i<cells; i++){
+		//CCW seen from above
+		vec3 quad[6] = { GRID_POINT(i,j), GRID_POINT(i,j+1), GRID_POINT(i+1,j+1),
+		                 GRID_POINT(i,j), GRID_POINT(i+1,j+1), GRID_POINT(i+1,j) };
+		for(int k=0; k<6; k++){
+			quad[k].y = bumpiness*(sinf(quad[k].x*0.4f + quad[k].z*0.3f) + 4*sinf(quad[k].x*0.1f));
+			memcpy(&vp[3*v], quad[k].v, 3*sizeof(float));
+			indices[v] = (uint16_t)v;
+			v++;
+		}
+	}
+	#undef GRID_POINT
+	if(wall){
+		//Facing -x, towards the agents
+		vec3 tris[9] = { vec3(5,0.3f,-3), vec3(5,0.3f,3), vec3(5,3,3),
+		                 vec3(5,0.3f,-3), vec3(5,3,3), vec3(5,3,-3),
+		                 vec3(5,0,-4), vec3(5,0.3f,-3), vec3(6,0,-4) };
+		for(int k=0; k<9; k++){
+			memcpy(&vp[3*v], tris[k].v, 3*sizeof(float));
+			indices[v] = (uint16_t)v;
+			v++;
+		}
+	}
+	return init_level(vp, indices, v, v);
+}
+
+//Move an agent in a straight line, colliding each step. Returns its final position
+static vec3 walk_agent(const LevelCollider &level, vec3 pos, vec3 step, PlayerGroundCache* cache, vec3* path){
+	Capsule collider;
+	collider.r = 1;
+	collider.y_base = 1;
+	collider.y_cap = 2;
+	PlayerState player = init_player_state(pos);
+	if(cache) cache->num_faces = 0;
+	for(int s=0; s<TEST_NUM_STEPS; s++){
+		collider.xform = make_transform(pos + step, identity_quat(), player_scale);
+		collide_player_ground(level, &collider, &player, cache);
+		pos = collider.xform.pos;
+		path[s] = pos;
+	}
+	return pos;
+}
+
+//Same path with and without the cache. Returns how many steps were cache hits
+static uint32_t check_cached_path(const LevelCollider &level, vec3 start, vec3 step){
+	vec3 full_path[TEST_NUM_STEPS], cached_path[TEST_NUM_STEPS];
+	PlayerGroundCache cache;
+	walk_agent(level, start, step, NULL, full_path);
+	collision_stats_begin_frame();
+	walk_agent(level, start, step, &cache, cached_path);
+	float max_diff = 0;
+	for(int s=0; s<TEST_NUM_STEPS; s++) max_diff = MAX(max_diff, length(cached_path[s]-full_path[s]));
+	CHECK(max_diff==0);
+	return collision_stats_frame().ground_cache_hits;
+}
+
+//Agents on random straight paths over a bumpy grid, started just below the ground so they're always touching it
+static void check_grid_level(const char* name, int cells, float cell_size){
+	LevelCollider level = make_test_level(cells, cell_size, 0.5f, false);
+	float half_size = 0.3f*cells*cell_size;
+	uint32_t hits = 0;
+	for(int a=0; a<TEST_NUM_AGENTS; a++){
+		GroundHit ground;
+		vec3 start = vec3(random_float(-half_size, half_size), 0, random_float(-half_size, half_size));
+		if(!get_ground_height(level, start.x, start.z, &ground)) continue;
+		start.y = ground.height - 0.05f;
+		float angle = random_float(0, (float)TAU);
+		hits += check_cached_path(level, start, vec3(cosf(angle), 0, sinf(angle))*TEST_STEP_SIZE);
+	}
+	//Walking is the common case, the odd step needs a full search when the walk gets too big or leaves the mesh
+	CHECK(hits>TEST_NUM_AGENTS*TEST_NUM_STEPS*9/10);
+	printf("%s: %u faces, %u of %d steps walked the cache\n", name, level.num_faces, hits, TEST_NUM_AGENTS*TEST_NUM_STEPS);
+	clear_level(&level);
+}
+
+//Every edge's neighbour is the face with the reversed edge (-1 only if there isn't one), and each welded
+//vertex lists the faces that use it. Returns the number of boundary edges
+static int check_adjacency(const MeshAdjacency &adj, const float* vp, const uint16_t* indices, uint32_t num_verts, uint32_t num_faces){
+	for(uint32_t i=0; i<num_verts; i++)
+	for(uint32_t j=0; j<num_verts; j++){
+		bool same_pos = vp[3*i]==vp[3*j] && vp[3*i+1]==vp[3*j+1] && vp[3*i+2]==vp[3*j+2];
+		CHECK(same_pos == (adj.welded_vert[i]==adj.welded_vert[j]));
+	}
+	int num_boundary = 0;
+	for(uint32_t f=0; f<num_faces; f++)
+	for(int e=0; e<3; e++){
+		uint32_t a = adj.welded_vert[indices[3*f+e]], b = adj.welded_vert[indices[3*f+(e+1)%3]];
+		int32_t twin_face = -1, twin_edge = -1;
+		for(uint32_t g=0; g<num_faces && twin_face<0; g++)
+		for(int k=0; k<3; k++){
+			if(g!=f && adj.welded_vert[indices[3*g+k]]==b && adj.welded_vert[indices[3*g+(k+1)%3]]==a){
+				twin_face = g;
+				twin_edge = k;
+				break;
+			}
+		}
+		CHECK(adj.face_neighbours[3*f+e]==twin_face);
+		if(twin_face>=0) CHECK(adj.face_neighbours[3*twin_face+twin_edge]==(int32_t)f);
+		else num_boundary++;
+	}
+	for(uint32_t v=0; v<adj.num_welded_verts; v++){
+		uint32_t n = adj.vert_face_start[v];
+		for(uint32_t f=0; f<num_faces; f++)
+		for(int k=0; k<3; k++){
+			if(adj.welded_vert[indices[3*f+k]]!=v) continue;
+			CHECK(n<adj.vert_face_start[v+1] && adj.vert_faces[n]==f);
+			n++;
+		}
+		CHECK(n==adj.vert_face_start[v+1]);
+	}
+	return num_boundary;
+}
+
+static void check_cube_adjacency(){
+	float *vp, *vt = NULL, *vn = NULL;
+	uint16_t* indices;
+	uint32_t num_verts, num_indices;
+	//Normals split every corner into 3 verts, one per side
+	if(!load_obj_indexed("cube.obj", &vp, &vt, &vn, &indices, &num_verts, &num_indices)){
+		CHECK(!"couldn't load cube.obj");
+		return;
+	}
+	uint32_t num_faces = num_indices/3;
+	CHECK(num_verts==24 && num_faces==12);
+
+	MeshAdjacency adj = build_mesh_adjacency(vp, indices, num_verts, num_faces);
+	CHECK(adj.num_welded_verts==8);
+	CHECK(check_adjacency(adj, vp, indices, num_verts, num_faces)==0);
+	CHECK(adj.num_components==1);
+	CHECK(adj.component_min[0]==vec3(-0.5f, 0, -0.5f) && adj.component_max[0]==vec3(0.5f, 1, 0.5f));
+	free_mesh_adjacency(&adj);
+
+	//Without the last side (2 faces) the 4 edges around the hole are open
+	adj = build_mesh_adjacency(vp, indices, num_verts, num_faces-2);
+	CHECK(adj.num_welded_verts==8);
+	CHECK(check_adjacency(adj, vp, indices, num_verts, num_faces-2)==4);
+	CHECK(adj.num_components==1);
+	free_mesh_adjacency(&adj);
+
+	//A second copy 3m along x is its own component
+	float* vp2 = (float*)malloc(2*3*num_verts*sizeof(float));
+	uint16_t* indices2 = (uint16_t*)malloc(2*num_indices*sizeof(uint16_t));
+	for(uint32_t i=0; i<3*num_verts; i++){
+		vp2[i] = vp[i];
+		vp2[3*num_verts+i] = vp[i] + ((i%3==0) ? 3.0f : 0.0f);
+	}
+	for(uint32_t i=0; i<num_indices; i++){
+		indices2[i] = indices[i];
+		indices2[num_indices+i] = (uint16_t)(indices[i] + num_verts);
+	}
+	adj = build_mesh_adjacency(vp2, indices2, 2*num_verts, 2*num_faces);
+	CHECK(adj.num_welded_verts==16);
+	CHECK(check_adjacency(adj, vp2, indices2, 2*num_verts, 2*num_faces)==0);
+	CHECK(adj.num_components==2);
+	for(uint32_t f=0; f<2*num_faces; f++) CHECK(adj.face_component[f]==((f<num_faces) ? 0u : 1u));
+	CHECK(adj.component_min[1]==vec3(2.5f, 0, -0.5f) && adj.component_max[1]==vec3(3.5f, 1, 0.5f));
+	free_mesh_adjacency(&adj);
+
+	free(vp2);
+	free(indices2);
+	free(vp);
+	free(vt);
+	free(vn);
+	free(indices);
+}
+
+//Flat square deck in the platform's xz plane, CCW seen from above, verts shared between faces
+static Platform make_test_platform(Transform xform){
+	const int n = TEST_PLATFORM_CELLS+1;
+	float* vp = (float*)malloc(3*n*n*sizeof(float));
+	uint16_t* indices = (uint16_t*)malloc(6*TEST_PLATFORM_CELLS*TEST_PLATFORM_CELLS*sizeof(uint16_t));
+	for(int j=0; j<n; j++)
+	for(int i=0; i<n; i++){
+		vp[3*(j*n+i)] = (i - 0.5f*TEST_PLATFORM_CELLS)*TEST_PLATFORM_CELL_SIZE;
+		vp[3*(j*n+i)+1] = 0;
+		vp[3*(j*n+i)+2] = (j - 0.5f*TEST_PLATFORM_CELLS)*TEST_PLATFORM_CELL_SIZE;
+	}
+	uint32_t num_indices = 0;
+	for(int j=0; j<TEST_PLATFORM_CELLS; j++)
+	for(int i=0; i<TEST_PLATFORM_CELLS; i++){
+		uint16_t quad[6] = { (uint16_t)(j*n+i), (uint16_t)((j+1)*n+i), (uint16_t)((j+1)*n+i+1),
+		                     (uint16_t)(j*n+i), (uint16_t)((j+1)*n+i+1), (uint16_t)(j*n+i+1) };
+		for(int k=0; k<6; k++) indices[num_indices++] = quad[k];
+	}
+	return init_platform(vp, indices, n*n, num_indices, xform);
+}
+
+static bool aabb_contains(const AABB &outer, const AABB &inner){
+	for(int k=0; k<3; k++){
+		if(inner.min.v[k]<outer.min.v[k] || inner.max.v[k]>outer.max.v[k]) return false;
+	}
+	return true;
+}
+
+//Every node holds its faces or children, and a query gathered in chunks returns each face of every leaf
+//overlapping the sphere exactly once, which covers every face whose own bounds overlap it. Returns the hit count
+static int check_platform_query(const Platform &platform, vec3 center, float radius, const uint32_t* face_leaf){
+	PlatformSphereQuery query;
+	begin_platform_sphere_query(platform, center, radius, &query);
+	int32_t chunk[PLAYER_PLATFORM_FACE_CHUNK];
+	uint8_t* found = (uint8_t*)calloc(platform.num_faces, 1);
+	int num_found = 0, num_chunk;
+	while((num_chunk = next_platform_sphere_faces(platform, &query, chunk, PLAYER_PLATFORM_FACE_CHUNK))>0){
+		CHECK(num_chunk<=PLAYER_PLATFORM_FACE_CHUNK);
+		for(int i=0; i<num_chunk; i++){
+			CHECK(chunk[i]>=0 && (uint32_t)chunk[i]<platform.num_faces && !found[chunk[i]]);
+			found[chunk[i]] = 1;
+			num_found++;
+		}
+	}
+	for(uint32_t f=0; f<platform.num_faces; f++){
+		bool leaf_overlaps = aabb_overlaps_sphere(platform.nodes[face_leaf[f]].bounds, center, radius);
+		CHECK(found[f] == leaf_overlaps);
+		if(aabb_overlaps_sphere(get_platform_face_bounds(platform, f), center, radius)) CHECK(found[f]);
+	}
+	free(found);
+	return num_found;
+}
+
+static void check_platform_bounds(const Platform &platform){
+	for(uint32_t i=0; i<platform.num_nodes; i++){
+		const PlatformNode &node = platform.nodes[i];
+		if(node.count>0){
+			for(uint32_t k=0; k<node.count; k++){
+				CHECK(aabb_contains(node.bounds, get_platform_face_bounds(platform, platform.face_order[node.first+k])));
+			}
+		}
+		else {
+			CHECK(aabb_contains(node.bounds, platform.nodes[node.first].bounds));
+			CHECK(aabb_contains(node.bounds, platform.nodes[node.first+1].bounds));
+		}
+	}
+}
+
+//Platform moved, turned and scaled at random, then a player stands on it as a lift that rises and turns
+static void check_platform(){
+	Platform platform = make_test_platform(identity_transform());
+	uint32_t* face_leaf = (uint32_t*)malloc(platform.num_faces*sizeof(uint32_t));
+	for(uint32_t i=0; i<platform.num_nodes; i++){
+		const PlatformNode &node = platform.nodes[i];
+		for(uint32_t k=0; k<node.count; k++) face_leaf[platform.face_order[node.first+k]] = i;
+	}
+	int max_found = 0;
+	for(int m=0; m<TEST_NUM_PLATFORM_MOVES; m++){
+		vec3 axis;
+		do { axis = vec3(random_float(-1, 1), random_float(-1, 1), random_float(-1, 1)); } while(length2(axis)<0.01f);
+		axis = normalise(axis);
+		vec3 pos = vec3(random_float(-10, 10), random_float(-10, 10), random_float(-10, 10));
+		vec3 scale = vec3(random_float(0.5f, 2), random_float(0.5f, 2), random_float(0.5f, 2));
+		set_platform_transform(&platform, make_transform(pos, quat_from_axis_rad(random_float(0, (float)TAU), axis.x, axis.y, axis.z), scale));
+		check_platform_bounds(platform);
+		for(int q=0; q<TEST_NUM_PLATFORM_QUERIES; q++){
+			vec3 local = vec3(random_float(-2.5f, 2.5f), random_float(-0.5f, 0.5f), random_float(-2.5f, 2.5f));
+			int found = check_platform_query(platform, transform_point(platform.xform, local), random_float(0.1f, 1.5f), face_leaf);
+			max_found = MAX(max_found, found);
+		}
+	}
+	//Bigger queries take several chunks
+	CHECK(max_found>2*PLAYER_PLATFORM_FACE_CHUNK);
+	free(face_leaf);
+
+	//Lift next to a small floor, player standing off its centre so turning moves them too
+	LevelCollider level = make_test_level(4, 1.0f, 0, false);
+	Transform lift_xform = make_transform(vec3(20, 2, 0), identity_quat(), vec3(1, 1, 1));
+	set_platform_transform(&platform, lift_xform);
+	int lift = add_level_platform(&level, platform);
+	Capsule collider;
+	collider.r = 1;
+	collider.y_base = 1;
+	collider.y_cap = 2;
+	vec3 pos = vec3(21, 2-0.05f, 0.5f);
+	PlayerState player = init_player_state(pos);
+	collider.xform = make_transform(pos, identity_quat(), player_scale);
+	collide_player_ground(level, &collider, &player, NULL);
+	pos = collider.xform.pos;
+	CHECK(player.platform==lift);
+	vec3 lift_local = inverse_transform_point(lift_xform, pos);
+	float max_error = 0;
+	for(int t=1; t<=TEST_NUM_LIFT_TICKS; t++){
+		lift_xform = make_transform(vec3(20 + 0.02f*t, 2 + 0.05f*t, 0), quat_from_axis_deg(3.0f*t, vec3(0, 1, 0)), vec3(1, 1, 1));
+		set_platform_transform(&level.platforms[lift], lift_xform);
+		//Pulled down a little each tick like gravity in player_update(), so they stay touching the deck
+		collider.xform = make_transform(pos - vec3(0, TEST_STEP_SIZE, 0), identity_quat(), player_scale);
+		collide_player_ground(level, &collider, &player, NULL);
+		pos = collider.xform.pos;
+		CHECK(player.platform==lift);
+		max_error = MAX(max_error, length(inverse_transform_point(lift_xform, pos) - lift_local));
+	}
+	CHECK(max_error<1e-3f);
+	CHECK(length(pos - vec3(21, 2, 0.5f))>1); //actually went somewhere
+	printf("platform: %u faces, up to %d found by one query, lift carried the player to within %g\n", level.platforms[lift].num_faces, max_found, max_error);
+	clear_level(&level);
+}
+
+int main(){
+	test_seed(777);
+	check_cube_adjacency();
+	check_platform();
+
+	//2m cells: a few dozen faces near an agent. 0.25m cells: hundreds, far more than PLAYER_GROUND_CACHE_MAX_FACES
+	check_grid_level("coarse grid", 40, 2.0f);
+	check_grid_level("dense grid", 80, 0.25f);
+
+	//Agents walk into the wall a couple of metres from the sliver joining it to the floor, from far enough away
+	//that the wall isn't near them at first. The walk has to cross the sliver outside the search sphere to find it
+	LevelCollider level = make_test_level(20, 1.0f, 0, true);
+	for(int a=0; a<3; a++){
+		vec3 start = vec3(-6, -0.05f, -1 + 0.25f*a);
+		vec3 step = vec3(2*TEST_STEP_SIZE, 0, 0);
+		check_cached_path(level, start, step);
+		vec3 path[TEST_NUM_STEPS];
+		PlayerGroundCache cache;
+		vec3 end = walk_agent(level, start, step, &cache, path);
+		CHECK(end.x<5); //stopped by the wall
+	}
+	printf("wall: %u faces\n", level.num_faces);
+	clear_level(&level);
+
+	return test_result("ground_cache_test");
+}
@@ -0,0 +1,246 @@
+//Float vs quantised level verts (compress_level_verts()): memory, query speed, and checks that the
+//compressed level is within the error bound, watertight, and that ground queries agree with collision
+//Runs on ground.obj and a generated hilly mesh big enough that the verts don't sit in L1
+//Usage: level_bench [repeats]
+#include "sim_headers.h"
+#include <chrono>
+#include "test.h"
+
+#define BENCH_HILLS_CELLS 104		//104x104 quads is as big as a load_obj style mesh (3 verts per face) gets with 16-bit indices
+#define BENCH_HILLS_CELL_SIZE 2.0f
+#define BENCH_NUM_QUERIES 500
+
+typedef std::chrono::steady_clock BenchClock;
+
+static double ms_since(BenchClock::time_point start){
+	return std::chrono::duration<double, std::milli>(BenchClock::now()-start).count();
+}
+
+//Grid point (i,j) of the generated level; xz jittered so it isn't detected as a heightfield
+static vec3 hills_point(int i, int j){
+	uint32_t h = hash_u32(i*7919u + j*104729u);
+	float jx = ((h & 0xFF)/255.0f - 0.5f)*0.5f*BENCH_HILLS_CELL_SIZE;
+	float jz = (((h>>8) & 0xFF)/255.0f - 0.5f)*0.5f*BENCH_HILLS_CELL_SIZE;
+	if(i==0 || i==BENCH_HILLS_CELLS) jx = 0;
+	if(j==0 || j==BENCH_HILLS_CELLS) jz = 0;
+	float x = (i - BENCH_HILLS_CELLS/2)*BENCH_HILLS_CELL_SIZE + jx;
+	float z = (j - BENCH_HILLS_CELLS/2)*BENCH_HILLS_CELL_SIZE + jz;
+	float y = 4*sinf(x*0.05f)*cosf(z*0.07f) + 0.5f*sinf(x*0.4f + z*0.3f);
+	return vec3(x, y, z);
+}
+
+//Like load_obj_indexed output: every face has its own 3 verts (flat shaded), shared positions are repeated
+static void make_hills(float** vp, uint16_t** indices, uint32_t* num_verts, uint32_t* num_indices){
+	uint32_t num_faces = 2*BENCH_HILLS_CELLS*BENCH_HILLS_CELLS;
+	*num_verts = *num_indices = 3*num_faces;
+	*vp = (float*)malloc(3*(*num_verts)*sizeof(float));
+	*indices = (uint16_t*)malloc((*num_indices)*sizeof(uint16_t));
+	uint32_t v = 0;
+	for(int j=0; j<BENCH_HILLS_CELLS; j++)
+	for(int i=0; i<BENCH_HILLS_CELLS; i++){
+		//CCW seen from above
+		vec3 quad[6] = { hills_point(i,j), hills_point(i,j+1), hills_point(i+1,j+1),
+		                 hills_point(i,j), hills_point(i+1,j+1), hills_point(i+1,j) };
+		for(int k=0; k<6; k++){
+			memcpy(&(*vp)[3*v], quad[k].v, 3*sizeof(float));
+			(*indices)[v] = (uint16_t)v;
+			v++;
+		}
+	}
+}
+
+static LevelCollider load_bench_level(const char* name, bool quantise){
+	float* vp = NULL;
+	uint16_t* indices = NULL;
+	uint32_t num_verts = 0, num_indices = 0;
+	if(!strcmp(name, "hills")) make_hills(&vp, &indices, &num_verts, &num_indices);
+	else if(!load_obj_indexed(name, &vp, &indices, &num_verts, &num_indices)) exit(1);
+	LevelCollider level = init_level(vp, indices, num_verts, num_indices);
+	if(quantise) compress_level_verts(&level);
+	return level;
+}
+
+struct BenchQuery {
+	vec3 pos;		//player position, on the ground
+};
+
+struct BenchResult {
+	size_t memory;
+	double get_face_ns;			//per face
+	double collide_full_us;		//per query, no ground cache
+	double collide_cached_us;	//per query, agents walking with a ground cache
+	double raycast_us;			//per ray
+	double ground_height_ns;	//per query
+};
+
+static BenchResult bench_level(const LevelCollider &level, const BenchQuery* queries, int num_queries, int repeats){
+	BenchResult result;
+	result.memory = level_memory_usage(level);
+	Capsule collider;
+	collider.r = 1;
+	collider.y_base = 1;
+	collider.y_cap = 2;
+
+	BenchClock::time_point start = BenchClock::now();
+	float sum = 0;
+	for(int r=0; r<repeats; r++){
+		for(uint32_t i=0; i<level.num_faces; i++){
+			vec3 a, b, c;
+			get_face(level, i, &a, &b, &c);
+			sum += a.x + b.y + c.z;
+		}
+	}
+	result.get_face_ns = 1e6*ms_since(start)/((double)repeats*level.num_faces);
+	if(sum==1234.5f) printf(" "); //keep the loop from being optimised out
+
+	start = BenchClock::now();
+	for(int i=0; i<num_queries; i++){
+		PlayerState player = init_player_state(queries[i].pos);
+		collider.xform = make_transform(player.pos, identity_quat(), player_scale);
+		collide_player_ground(level, &collider, &player, NULL);
+	}
+	result.collide_full_us = 1e3*ms_since(start)/num_queries;
+
+	//Each query point is an agent shuffling along in small steps, so the cache gets hit like it would in game
+	int steps = 10*repeats;
+	start = BenchClock::now();
+	for(int i=0; i<num_queries; i++){
+		PlayerState player = init_player_state(queries[i].pos);
+		PlayerGroundCache cache;
+		cache.num_faces = 0;
+		for(int s=0; s<steps; s++){
+			collider.xform = make_transform(player.pos + vec3(0.05f*s, 0, 0.03f*s), identity_quat(), player_scale);
+			collide_player_ground(level, &collider, &player, &cache);
+		}
+	}
+	result.collide_cached_us = 1e3*ms_since(start)/((double)num_queries*steps);
+
+	start = BenchClock::now();
+	for(int i=0; i<num_queries; i++){
+		RayHit hit;
+		vec3 p = queries[i].pos;
+		raycast_level(level, vec3(p.x, p.y+50, p.z), vec3(0, -1, 0), 100, &hit);
+	}
+	result.raycast_us = 1e3*ms_since(start)/num_queries;
+
+	start = BenchClock::now();
+	int num_hits = 0;
+	for(int r=0; r<repeats; r++){
+		for(int i=0; i<num_queries; i++){
+			GroundHit hit;
+			num_hits += get_ground_height(level, queries[i].pos.x, queries[i].pos.z, &hit);
+		}
+	}
+	result.ground_height_ns = 1e6*ms_since(start)/((double)repeats*num_queries);
+	if(num_hits==-1) printf(" ");
+	return result;
+}
+
+struct CornerPosition {
+	vec3 original;
+	vec3 decoded;
+};
+
+static int compare_corner_positions(const void* a, const void* b){
+	const float* pa = ((const CornerPosition*)a)->original.v;
+	const float* pb = ((const CornerPosition*)b)->original.v;
+	for(int k=0; k<3; k++){
+		if(pa[k]!=pb[k]) return (pa[k]>pb[k]) - (pa[k]<pb[k]);
+	}
+	return 0;
+}
+
+static void check_quantised_level(const char* name, const LevelCollider &floats, const LevelCollider &quantised, const BenchQuery* queries, int num_queries){
+	CHECK(quantised.quantised_verts!=NULL);
+	CHECK(quantised.num_faces==floats.num_faces);
+
+	//Error is at most half a quantisation step of the cluster (plus float rounding in the decode)
+	float max_step = 0;
+	for(uint32_t c=0; c<(quantised.num_verts+LEVEL_VERTEX_CLUSTER_SIZE-1)/LEVEL_VERTEX_CLUSTER_SIZE; c++){
+		for(int k=0; k<3; k++) max_step = MAX(max_step, quantised.clusters[c].scale.v[k]);
+	}
+	float bound = 0.5f*max_step + 1e-5f;
+	CHECK(quantised.max_quantisation_error<=bound);
+
+	//Every corner decodes to within the bound of its float position, and corners at the same
+	//float position decode to exactly the same point (no cracks along seams)
+	CornerPosition* corners = (CornerPosition*)malloc(3*floats.num_faces*sizeof(CornerPosition));
+	float max_error = 0;
+	for(uint32_t i=0; i<floats.num_faces; i++){
+		vec3 f[3], q[3];
+		get_face(floats, i, &f[0], &f[1], &f[2]);
+		get_face(quantised, i, &q[0], &q[1], &q[2]);
+		for(int j=0; j<3; j++){
+			for(int k=0; k<3; k++) max_error = MAX(max_error, fabsf(f[j].v[k]-q[j].v[k]));
+			corners[3*i+j].original = f[j];
+			corners[3*i+j].decoded = q[j];
+		}
+	}
+	CHECK(max_error<=bound);
+	qsort(corners, 3*floats.num_faces, sizeof(CornerPosition), compare_corner_positions);
+	int num_cracks = 0;
+	for(uint32_t i=1; i<3*floats.num_faces; i++){
+		if(compare_corner_positions(&corners[i-1], &corners[i])!=0) continue;
+		if(memcmp(corners[i-1].decoded.v, corners[i].decoded.v, 3*sizeof(float))!=0) num_cracks++;
+	}
+	CHECK(num_cracks==0);
+	free(corners);
+
+	//Ground height from the grid matches the decoded faces collision uses (ray straight down)
+	int num_compared = 0;
+	float max_height_diff = 0;
+	for(int i=0; i<num_queries; i++){
+		GroundHit ground;
+		RayHit ray;
+		vec3 p = queries[i].pos;
+		if(!get_ground_height(quantised, p.x, p.z, &ground)) continue;
+		if(!raycast_level(quantised, vec3(p.x, ground.height+1, p.z), vec3(0,-1,0), 2, &ray)) continue;
+		max_height_diff = MAX(max_height_diff, fabsf(ray.pos.y-ground.height));
+		num_compared++;
+	}
+	CHECK(num_compared>num_queries/2);
+	CHECK(max_height_diff<1e-3f);
+	printf("%s: max error %g (bound %g), %d cracks, ground height vs decoded faces %g\n", name, max_error, bound, num_cracks, max_height_diff);
+}
+
+int main(int argc, char** argv){
+	test_seed(12345);
+	int repeats = (argc>1) ? MAX(atoi(argv[1]), 1) : 10;
+	const char* level_names[] = { "ground.obj", "hills" };
+
+	for(int l=0; l<2; l++){
+		LevelCollider floats = load_bench_level(level_names[l], false);
+		LevelCollider quantised = load_bench_level(level_names[l], true);
+
+		//Query points on the ground, spread over the level
+		BenchQuery queries[BENCH_NUM_QUERIES];
+		int num_queries = 0;
+		const GroundGrid &grid = floats.ground;
+		float max_x = grid.min_x + grid.num_cells_x*grid.cell_size;
+		float max_z = grid.min_z + grid.num_cells_z*grid.cell_size;
+		for(int attempts=0; attempts<100*BENCH_NUM_QUERIES && num_queries<BENCH_NUM_QUERIES; attempts++){
+			GroundHit hit;
+			float x = random_float(grid.min_x, max_x), z = random_float(grid.min_z, max_z);
+			if(!get_ground_height(floats, x, z, &hit)) continue;
+			queries[num_queries++].pos = vec3(x, hit.height, z);
+		}
+		CHECK(num_queries>0);
+
+		check_quantised_level(level_names[l], floats, quantised, queries, num_queries);
+
+		BenchResult f = bench_level(floats, queries, num_queries, repeats);
+		BenchResult q = bench_level(quantised, queries, num_queries, repeats);
+		printf("%s: %u faces, %u verts -> %u welded\n", level_names[l], floats.num_faces, floats.num_verts, quantised.num_verts);
+		printf("  %-28s %12s %12s\n", "", "float", "quantised");
+		printf("  %-28s %12zu %12zu\n", "level memory (bytes)", f.memory, q.memory);
+		printf("  %-28s %12.2f %12.2f\n", "get_face (ns/face)", f.get_face_ns, q.get_face_ns);
+		printf("  %-28s %12.2f %12.2f\n", "collide, full search (us)", f.collide_full_us, q.collide_full_us);
+		printf("  %-28s %12.2f %12.2f\n", "collide, ground cache (us)", f.collide_cached_us, q.collide_cached_us);
+		printf("  %-28s %12.2f %12.2f\n", "raycast down (us)", f.raycast_us, q.raycast_us);
+		printf("  %-28s %12.2f %12.2f\n", "get_ground_height (ns)", f.ground_height_ns, q.ground_height_ns);
+
+		clear_level(&floats);
+		clear_level(&quantised);
+	}
+	return test_result("level_bench");
+}
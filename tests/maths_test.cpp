@@ -0,0 +1,422 @@
+//Checks the SSE/NEON code in GameMaths.h against its scalar code (built with GAMEMATHS_NO_SIMD in maths_test_scalar.cpp)
+//SIMD paths add and multiply in a different order, so results only have to agree to within a few float ulps
+//of the magnitudes involved; transpose moves values around and has to match exactly
+//Lane types (floatx4/floatx8, vec3x4/vec3x8) are checked lane by lane against float and vec3 maths. Each lane
+//does the same single IEEE operation as the scalar code, so those match exactly apart from normalise
+//Batch transforms (transform_points/dirs and the strided versions) are checked against mat4*vec4 one point at a time,
+//for every count up to a few batches of 4 so the leftover loop runs with 0-3 points
+//Transform (transform_point/dir, their inverses, inverse(), combine()) is checked against transform_to_mat4()
+//and mat4 maths, with non-uniform scale wherever the function claims to handle it
+//Build with -mavx as well (see MathsTestAVX in the Makefile) to cover the AVX floatx8
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include "GameMaths.h"
+#include "test.h"
+
+#define MATHS_TEST_ITERATIONS 10000
+
+void scalar_mat4_mul(const float* a, const float* b, float* result);
+void scalar_mat4_mul_vec4(const float* a, const float* v, float* result);
+float scalar_determinant(const float* a);
+void scalar_inverse(const float* a, float* result);
+void scalar_transpose(const float* a, float* result);
+void scalar_versor_mul(const float* q, const float* r, float* result);
+
+static mat4 random_mat4(){
+	mat4 m;
+	for(int i=0; i<16; i++) m.m[i] = random_float(-2, 2);
+	return m;
+}
+
+//Model matrix like the ones the game builds: scale, rotate, translate
+static mat4 random_trs(){
+	vec3 axis = normalise(vec3(random_float(-1, 1), random_float(-1, 1), random_float(-1, 1)) + vec3(0, 0.01f, 0));
+	versor q = quat_from_axis_deg(random_float(-180, 180), axis);
+	mat4 S = scale(identity_mat4(), vec3(random_float(0.1f, 4), random_float(0.1f, 4), random_float(0.1f, 4)));
+	return translate(quat_to_mat4(q)*S, vec3(random_float(-50, 50), random_float(-50, 50), random_float(-50, 50)));
+}
+
+static float max_abs(const float* v, int n){
+	float m = 0;
+	for(int i=0; i<n; i++) m = MAX(m, fabsf(v[i]));
+	return m;
+}
+
+static void test_mat4_mul(const mat4 &a, const mat4 &b){
+	mat4 simd = a;
+	simd = simd*b;
+	float ref[16];
+	scalar_mat4_mul(a.m, b.m, ref);
+	//Each element sums four products of at most max|a|*max|b|
+	float tolerance = 4*4*FLT_EPSILON*max_abs(a.m, 16)*max_abs(b.m, 16);
+	for(int i=0; i<16; i++) CHECK_NEAR(simd.m[i], ref[i], tolerance);
+
+	vec4 v(random_float(-2, 2), random_float(-2, 2), random_float(-2, 2), random_float(-2, 2));
+	mat4 ma = a;
+	vec4 simd_v = ma*v;
+	float ref_v[4];
+	scalar_mat4_mul_vec4(a.m, v.v, ref_v);
+	tolerance = 4*4*FLT_EPSILON*max_abs(a.m, 16)*max_abs(v.v, 4);
+	for(int i=0; i<4; i++) CHECK_NEAR(simd_v.v[i], ref_v[i], tolerance);
+}
+
+static void test_transpose(const mat4 &a){
+	mat4 simd = transpose(a);
+	float ref[16];
+	scalar_transpose(a.m, ref);
+	for(int i=0; i<16; i++) CHECK(simd.m[i]==ref[i]);
+}
+
+static void test_inverse(const mat4 &a){
+	float ref_det = scalar_determinant(a.m);
+	if(fabsf(ref_det)<0.1f) return; //near singular, the two paths can legitimately differ a lot
+
+	float ref[16];
+	scalar_inverse(a.m, ref);
+	mat4 simd = inverse(a);
+	//Error in an inverse grows with the matrix's condition number, estimated here as |A|*|A^-1| (max norms)
+	float condition = 4*max_abs(a.m, 16)*max_abs(ref, 16);
+	CHECK_NEAR(determinant(a), ref_det, 64*FLT_EPSILON*condition*fabsf(ref_det));
+	float tolerance = 64*FLT_EPSILON*condition*max_abs(ref, 16);
+	for(int i=0; i<16; i++) CHECK_NEAR(simd.m[i], ref[i], tolerance);
+
+	//And it has to actually be an inverse
+	mat4 ma = a;
+	mat4 identity = ma*simd;
+	for(int i=0; i<16; i++) CHECK_NEAR(identity.m[i], (i%5==0) ? 1 : 0, 64*FLT_EPSILON*condition);
+}
+
+static void test_versor_mul(){
+	vec3 axis1 = normalise(vec3(random_float(-1, 1), random_float(-1, 1), random_float(-1, 1)) + vec3(0.01f, 0, 0));
+	vec3 axis2 = normalise(vec3(random_float(-1, 1), random_float(-1, 1), random_float(-1, 1)) + vec3(0.01f, 0, 0));
+	versor q = quat_from_axis_deg(random_float(-180, 180), axis1);
+	versor r = quat_from_axis_deg(random_float(-180, 180), axis2);
+	versor simd = q*r;
+	float ref[4];
+	scalar_versor_mul(q.q, r.q, ref);
+	for(int i=0; i<4; i++) CHECK_NEAR(simd.q[i], ref[i], 8*FLT_EPSILON);
+}
+
+//Overloads so the lane checks can be written once for 4 and 8 lanes
+static void lane_load(floatx4* r, const float* f){ *r = floatx4_load(f); }
+static void lane_load(floatx8* r, const float* f){ *r = floatx8_load(f); }
+static void lane_set1(floatx4* r, float f){ *r = floatx4_set1(f); }
+static void lane_set1(floatx8* r, float f){ *r = floatx8_set1(f); }
+static void lane_store(float* f, floatx4 a){ floatx4_store(f, a); }
+static void lane_store(float* f, floatx8 a){ floatx8_store(f, a); }
+
+template<typename F, typename M, int N>
+static void test_float_lanes(){
+	float a[N], b[N], r[N];
+	for(int i=0; i<N; i++){
+		a[i] = random_float(-4, 4);
+		b[i] = (i%3==0) ? a[i] : random_float(-4, 4); //some equal lanes, so < and <= differ
+	}
+	F fa, fb, f;
+	lane_load(&fa, a);
+	lane_load(&fb, b);
+	lane_store(r, fa);
+	for(int i=0; i<N; i++) CHECK(r[i]==a[i]);
+	lane_set1(&f, a[0]);
+	lane_store(r, f);
+	for(int i=0; i<N; i++) CHECK(r[i]==a[0]);
+
+	#define CHECK_LANES(expr, scalar) { \
+		lane_store(r, expr); \
+		for(int i=0; i<N; i++) CHECK(r[i]==(scalar)); \
+	}
+	CHECK_LANES(fa + fb, a[i] + b[i]);
+	CHECK_LANES(fa - fb, a[i] - b[i]);
+	CHECK_LANES(fa * fb, a[i] * b[i]);
+	CHECK_LANES(fa / fb, a[i] / b[i]);
+	CHECK_LANES(fa * 3.0f, a[i] * 3.0f);
+	CHECK_LANES(fa / 3.0f, a[i] / 3.0f);
+	CHECK_LANES(-fa, -a[i]);
+	CHECK_LANES(lane_min(fa, fb), MIN(a[i], b[i]));
+	CHECK_LANES(lane_max(fa, fb), MAX(a[i], b[i]));
+	CHECK_LANES(lane_sqrt(lane_max(fa, -fa)), sqrtf(fabsf(a[i])));
+	f = fa; f += fb;
+	CHECK_LANES(f, a[i] + b[i]);
+	f = fa; f -= fb;
+	CHECK_LANES(f, a[i] - b[i]);
+	f = fa; f *= fb;
+	CHECK_LANES(f, a[i] * b[i]);
+
+	//Comparisons, checked through lane_mask_bits, and masks combined
+	#define CHECK_MASK(mask, scalar) { \
+		int bits = 0; \
+		for(int i=0; i<N; i++) bits |= (int)(scalar) << i; \
+		CHECK(lane_mask_bits(mask)==bits); \
+	}
+	CHECK_MASK(fa < fb, a[i] < b[i]);
+	CHECK_MASK(fa > fb, a[i] > b[i]);
+	CHECK_MASK(fa <= fb, a[i] <= b[i]);
+	CHECK_MASK(fa >= fb, a[i] >= b[i]);
+	M lt = fa < fb, ge = fa >= fb, zero = fa > fa, one = fa <= fa;
+	CHECK_MASK(lt & ge, false);
+	CHECK_MASK(lt | ge, true);
+	CHECK_MASK((fa <= fb) & (fa >= fb), a[i] == b[i]);
+	CHECK(!lane_any(zero) && !lane_all(zero));
+	CHECK(lane_any(one) && lane_all(one));
+	CHECK(lane_all(lt) == false); //lane 0 has a==b
+	CHECK_LANES(lane_select(lt, fa, fb), (a[i] < b[i]) ? a[i] : b[i]);
+	CHECK_LANES(lane_select(one, fa, fb), a[i]);
+	CHECK_LANES(lane_select(zero, fa, fb), b[i]);
+	#undef CHECK_MASK
+	#undef CHECK_LANES
+}
+
+static vec3 random_vec3(float size){
+	return vec3(random_float(-size, size), random_float(-size, size), random_float(-size, size));
+}
+
+template<typename V, typename F, typename M, int N>
+static void test_vec3_lanes(){
+	//Loading from vec3s relies on them being 3 packed floats
+	CHECK(sizeof(vec3)==3*sizeof(float));
+	vec3 a[N], b[N], r[N];
+	for(int i=0; i<N; i++){
+		a[i] = random_vec3(4);
+		b[i] = random_vec3(4);
+	}
+	a[N-1] = vec3(0,0,0); //normalise leaves zero vectors alone
+	V va(a), vb(b);
+	va.store(r);
+	for(int i=0; i<N; i++) CHECK(r[i].x==a[i].x && r[i].y==a[i].y && r[i].z==a[i].z);
+	for(int i=0; i<N; i++) CHECK(va.get(i).x==a[i].x && va.get(i).y==a[i].y && va.get(i).z==a[i].z);
+	V broadcast(a[1]);
+	for(int i=0; i<N; i++) CHECK(broadcast.get(i).x==a[1].x && broadcast.get(i).y==a[1].y && broadcast.get(i).z==a[1].z);
+
+	#define CHECK_VEC3_LANES(expr, scalar) { \
+		V check_v_ = (expr); \
+		check_v_.store(r); \
+		for(int i=0; i<N; i++){ \
+			vec3 e = (scalar); \
+			CHECK(r[i].x==e.x && r[i].y==e.y && r[i].z==e.z); \
+		} \
+	}
+	#define CHECK_FLOAT_LANES(expr, scalar) { \
+		float check_f_[N]; \
+		lane_store(check_f_, (expr)); \
+		for(int i=0; i<N; i++) CHECK(check_f_[i]==(scalar)); \
+	}
+	float s[N];
+	for(int i=0; i<N; i++) s[i] = random_float(0.5f, 2);
+	F fs;
+	lane_load(&fs, s);
+	CHECK_VEC3_LANES(va + vb, a[i] + b[i]);
+	CHECK_VEC3_LANES(va - vb, a[i] - b[i]);
+	CHECK_VEC3_LANES(va * fs, a[i] * s[i]);
+	CHECK_VEC3_LANES(va / fs, a[i] / s[i]);
+	CHECK_VEC3_LANES(va * 3.0f, a[i] * 3.0f);
+	CHECK_VEC3_LANES(va / 3.0f, a[i] / 3.0f);
+	CHECK_VEC3_LANES(-va, -a[i]);
+	V v = va; v += vb;
+	CHECK_VEC3_LANES(v, a[i] + b[i]);
+	v = va; v -= vb;
+	CHECK_VEC3_LANES(v, a[i] - b[i]);
+	v = va; v *= 3.0f;
+	CHECK_VEC3_LANES(v, a[i] * 3.0f);
+	CHECK_VEC3_LANES(cross(va, vb), cross(a[i], b[i]));
+	CHECK_VEC3_LANES(lane_min(va, vb), vec3(MIN(a[i].x, b[i].x), MIN(a[i].y, b[i].y), MIN(a[i].z, b[i].z)));
+	CHECK_VEC3_LANES(lane_max(va, vb), vec3(MAX(a[i].x, b[i].x), MAX(a[i].y, b[i].y), MAX(a[i].z, b[i].z)));
+	CHECK_FLOAT_LANES(dot(va, vb), dot(a[i], b[i]));
+	CHECK_FLOAT_LANES(length2(va), length2(a[i]));
+	CHECK_FLOAT_LANES(length(va), length(a[i]));
+	M closer = length2(va) < length2(vb);
+	CHECK_VEC3_LANES(lane_select(closer, va, vb), (length2(a[i]) < length2(b[i])) ? a[i] : b[i]);
+
+	//normalise multiplies by 1/length where vec3 divides, so allow an ulp or two
+	normalise(va).store(r);
+	for(int i=0; i<N; i++){
+		vec3 e = normalise(a[i]);
+		for(int k=0; k<3; k++) CHECK_NEAR(r[i].v[k], e.v[k], 2*FLT_EPSILON);
+	}
+	CHECK(r[N-1].x==0 && r[N-1].y==0 && r[N-1].z==0);
+	#undef CHECK_FLOAT_LANES
+	#undef CHECK_VEC3_LANES
+}
+
+static Transform random_transform(bool uniform_scale){
+	vec3 axis = normalise(random_vec3(1) + vec3(0, 0.01f, 0));
+	vec3 s = vec3(random_float(0.1f, 4), random_float(0.1f, 4), random_float(0.1f, 4));
+	if(uniform_scale) s = vec3(s.x, s.x, s.x);
+	return make_transform(random_vec3(50), quat_from_axis_deg(random_float(-180, 180), axis), s);
+}
+
+static void check_near_vec3(const vec3 &a, const vec3 &b, float tolerance){
+	for(int k=0; k<3; k++) CHECK_NEAR(a.v[k], b.v[k], tolerance);
+}
+
+static void check_near_mat4(const mat4 &a, const mat4 &b, float tolerance){
+	for(int i=0; i<16; i++) CHECK_NEAR(a.m[i], b.m[i], tolerance);
+}
+
+static void test_transforms(){
+	//transform_to_mat4 is translate * rotate * scale
+	Transform t = random_transform(false);
+	mat4 M = transform_to_mat4(t);
+	mat4 trs = translate(quat_to_mat4(t.rot)*scale(identity_mat4(), t.scale), t.pos);
+	check_near_mat4(M, trs, 8*FLT_EPSILON*4);
+
+	//Forwards and backwards against the matrix and its inverse, non-uniform scale
+	mat4 M_inv = inverse(M);
+	vec3 p = random_vec3(10);
+	float tolerance = 64*FLT_EPSILON*(50 + 4*10);
+	check_near_vec3(transform_point(t, p), vec3(M*vec4(p, 1)), tolerance);
+	check_near_vec3(transform_dir(t, p), vec3(M*vec4(p, 0)), tolerance);
+	//1/scale is up to 10, so everything coming back through the inverse is up to 10x bigger
+	float inverse_tolerance = 10*64*FLT_EPSILON*(50 + 10);
+	check_near_vec3(inverse_transform_point(t, p), vec3(M_inv*vec4(p, 1)), inverse_tolerance);
+	check_near_vec3(inverse_transform_dir(t, p), vec3(M_inv*vec4(p, 0)), inverse_tolerance);
+	check_near_vec3(inverse_transform_point(t, transform_point(t, p)), p, inverse_tolerance);
+	check_near_vec3(inverse_transform_dir(t, transform_dir(t, p)), p, inverse_tolerance);
+
+	//inverse() and combine() are only exact for uniform scale
+	Transform u = random_transform(true);
+	mat4 U = transform_to_mat4(u);
+	mat4 U_inv = inverse(U);
+	check_near_mat4(transform_to_mat4(inverse(u)), U_inv, 64*FLT_EPSILON*max_abs(U_inv.m, 16));
+	check_near_vec3(transform_point(inverse(u), transform_point(u, p)), p, inverse_tolerance);
+
+	//Parent uniform, child anything
+	Transform child = random_transform(false);
+	mat4 composed = U*transform_to_mat4(child);
+	check_near_mat4(transform_to_mat4(combine(u, child)), composed, 64*FLT_EPSILON*max_abs(composed.m, 16));
+	check_near_vec3(transform_point(combine(u, child), p), transform_point(u, transform_point(child, p)), 64*FLT_EPSILON*max_abs(composed.m, 16)*10);
+}
+
+#define TEST_MAX_BATCH 19
+#define TEST_VERTEX_FLOATS 8	//interleaved position, normal and uv like a vertex buffer
+#define TEST_OUT_FLOATS 5
+
+static bool same_vec3(const vec3 &a, const vec3 &b){
+	return a.x==b.x && a.y==b.y && a.z==b.z;
+}
+
+static void check_transformed(const mat4 &m, const vec3* in, const vec3* out, int count, float w){
+	for(int i=0; i<count; i++){
+		float p[4] = { in[i].x, in[i].y, in[i].z, w };
+		float ref[4];
+		scalar_mat4_mul_vec4(m.m, p, ref);
+		float tolerance = 4*4*FLT_EPSILON*max_abs(m.m, 16)*MAX(max_abs(p, 4), 1.0f);
+		for(int k=0; k<3; k++) CHECK_NEAR(out[i].v[k], ref[k], tolerance);
+	}
+}
+
+static void test_batch_transforms(int count){
+	mat4 m = random_trs();
+	vec3 in[TEST_MAX_BATCH], out[TEST_MAX_BATCH+1], in_place[TEST_MAX_BATCH];
+	for(int i=0; i<count; i++) in[i] = random_vec3(10);
+	const vec3 sentinel(12345, 12345, 12345);
+
+	//Points and directions, out of place (not writing past count) and in place (same results)
+	out[count] = sentinel;
+	transform_points(m, in, out, count);
+	check_transformed(m, in, out, count, 1);
+	CHECK(same_vec3(out[count], sentinel));
+	for(int i=0; i<count; i++) in_place[i] = in[i];
+	transform_points(m, in_place, count);
+	for(int i=0; i<count; i++) CHECK(same_vec3(in_place[i], out[i]));
+
+	transform_dirs(m, in, out, count);
+	check_transformed(m, in, out, count, 0);
+	CHECK(same_vec3(out[count], sentinel));
+	for(int i=0; i<count; i++) in_place[i] = in[i];
+	transform_dirs(m, in_place, count);
+	for(int i=0; i<count; i++) CHECK(same_vec3(in_place[i], out[i]));
+
+	//mat3 + translation overloads are the same affine map
+	mat3 RS(m);
+	vec3 pos(m.m[12], m.m[13], m.m[14]);
+	transform_points(RS, pos, in, out, count);
+	check_transformed(m, in, out, count, 1);
+	for(int i=0; i<count; i++) in_place[i] = in[i];
+	transform_points(RS, pos, in_place, count);
+	for(int i=0; i<count; i++) CHECK(same_vec3(in_place[i], out[i]));
+	transform_dirs(RS, in, out, count);
+	check_transformed(m, in, out, count, 0);
+
+	//Transform overload against transform_point(), non-uniform scale
+	Transform t = random_transform(false);
+	transform_points(t, in, out, count);
+	for(int i=0; i<count; i++){
+		vec3 e = transform_point(t, in[i]);
+		for(int k=0; k<3; k++) CHECK_NEAR(out[i].v[k], e.v[k], 64*FLT_EPSILON*50);
+	}
+	for(int i=0; i<count; i++) in_place[i] = in[i];
+	transform_points(t, in_place, count);
+	for(int i=0; i<count; i++) CHECK(same_vec3(in_place[i], out[i]));
+
+	//Strided: positions out of an interleaved vertex buffer into a differently strided one. Only xyz of each
+	//vertex may be written, and results match the packed version
+	float vertices[TEST_MAX_BATCH*TEST_VERTEX_FLOATS], strided_out[TEST_MAX_BATCH*TEST_OUT_FLOATS+1];
+	for(int i=0; i<count*TEST_VERTEX_FLOATS; i++) vertices[i] = random_float(-10, 10);
+	for(int i=0; i<count; i++) in[i] = vec3(vertices[i*TEST_VERTEX_FLOATS], vertices[i*TEST_VERTEX_FLOATS+1], vertices[i*TEST_VERTEX_FLOATS+2]);
+	for(int i=0; i<=count*TEST_OUT_FLOATS; i++) strided_out[i] = -1;
+	for(int dirs=0; dirs<2; dirs++){
+		if(dirs) transform_dirs_strided(m, vertices, TEST_VERTEX_FLOATS*sizeof(float), strided_out, TEST_OUT_FLOATS*sizeof(float), count);
+		else transform_points_strided(m, vertices, TEST_VERTEX_FLOATS*sizeof(float), strided_out, TEST_OUT_FLOATS*sizeof(float), count);
+		for(int i=0; i<count; i++) out[i] = vec3(strided_out[i*TEST_OUT_FLOATS], strided_out[i*TEST_OUT_FLOATS+1], strided_out[i*TEST_OUT_FLOATS+2]);
+		check_transformed(m, in, out, count, dirs ? 0.0f : 1.0f);
+		for(int i=0; i<=count*TEST_OUT_FLOATS; i++){
+			if(i<count*TEST_OUT_FLOATS && i%TEST_OUT_FLOATS<3) continue;
+			CHECK(strided_out[i]==-1);
+		}
+	}
+
+	//Strided in place: normals (floats 3-5) stay put
+	float normals[TEST_MAX_BATCH*3];
+	for(int i=0; i<count; i++) memcpy(&normals[3*i], &vertices[i*TEST_VERTEX_FLOATS+3], 3*sizeof(float));
+	transform_points_strided(m, vertices, TEST_VERTEX_FLOATS*sizeof(float), vertices, TEST_VERTEX_FLOATS*sizeof(float), count);
+	for(int i=0; i<count; i++){
+		out[i] = vec3(vertices[i*TEST_VERTEX_FLOATS], vertices[i*TEST_VERTEX_FLOATS+1], vertices[i*TEST_VERTEX_FLOATS+2]);
+		CHECK(memcmp(&normals[3*i], &vertices[i*TEST_VERTEX_FLOATS+3], 3*sizeof(float))==0);
+	}
+	check_transformed(m, in, out, count, 1);
+}
+
+int main(){
+	test_seed(1);
+	#if defined(GAMEMATHS_SSE)
+	printf("Testing SSE maths against scalar\n");
+	#elif defined(GAMEMATHS_NEON)
+	printf("Testing NEON maths against scalar\n");
+	#else
+	printf("Warning: built without SIMD, only testing scalar against itself\n");
+	#endif
+	#if defined(GAMEMATHS_AVX)
+	printf("floatx8 uses AVX\n");
+	#else
+	printf("floatx8 is two floatx4s\n");
+	#endif
+
+	for(int i=0; i<MATHS_TEST_ITERATIONS; i++){
+		mat4 a = (i%2) ? random_mat4() : random_trs();
+		mat4 b = (i%3) ? random_mat4() : random_trs();
+		test_mat4_mul(a, b);
+		test_transpose(a);
+		test_inverse(a);
+		test_versor_mul();
+	}
+	for(int i=0; i<MATHS_TEST_ITERATIONS/10; i++){
+		test_float_lanes<floatx4, maskx4, 4>();
+		test_float_lanes<floatx8, maskx8, 8>();
+		test_vec3_lanes<vec3x4, floatx4, maskx4, 4>();
+		test_vec3_lanes<vec3x8, floatx8, maskx8, 8>();
+		test_batch_transforms(i%(TEST_MAX_BATCH+1));
+		test_transforms();
+	}
+
+	//Exactly singular (two equal columns, small integers so every product is exact): both paths give up and return the input
+	mat4 singular(1,2,3,4, 1,2,3,4, 0,1,0,2, 5,0,1,1);
+	CHECK(determinant(singular)==0.0f);
+	CHECK(scalar_determinant(singular.m)==0.0f);
+	mat4 not_inverted = inverse(singular);
+	for(int i=0; i<16; i++) CHECK(not_inverted.m[i]==singular.m[i]);
+
+	return test_result("maths_test");
+}
@@ -0,0 +1,54 @@
+//Scalar reference for maths_test.cpp: GameMaths.h built with GAMEMATHS_NO_SIMD inside its own namespace,
+//so it links alongside the SIMD build in maths_test.cpp. Values cross over as plain float arrays
+#include <stdio.h>
+#define _USE_MATH_DEFINES
+#include <math.h>
+
+#define GAMEMATHS_NO_SIMD
+namespace scalar {
+#include "GameMaths.h"
+}
+
+static scalar::mat4 load_mat4(const float* m){
+	scalar::mat4 r;
+	for(int i=0; i<16; i++) r.m[i] = m[i];
+	return r;
+}
+
+static scalar::versor load_versor(const float* q){
+	scalar::versor r;
+	for(int i=0; i<4; i++) r.q[i] = q[i];
+	return r;
+}
+
+void scalar_mat4_mul(const float* a, const float* b, float* result){
+	scalar::mat4 ma = load_mat4(a);
+	scalar::mat4 r = ma*load_mat4(b);
+	for(int i=0; i<16; i++) result[i] = r.m[i];
+}
+
+void scalar_mat4_mul_vec4(const float* a, const float* v, float* result){
+	scalar::mat4 ma = load_mat4(a);
+	scalar::vec4 r = ma*scalar::vec4(v[0], v[1], v[2], v[3]);
+	for(int i=0; i<4; i++) result[i] = r.v[i];
+}
+
+float scalar_determinant(const float* a){
+	return scalar::determinant(load_mat4(a));
+}
+
+void scalar_inverse(const float* a, float* result){
+	scalar::mat4 r = scalar::inverse(load_mat4(a));
+	for(int i=0; i<16; i++) result[i] = r.m[i];
+}
+
+void scalar_transpose(const float* a, float* result){
+	scalar::mat4 r = scalar::transpose(load_mat4(a));
+	for(int i=0; i<16; i++) result[i] = r.m[i];
+}
+
+void scalar_versor_mul(const float* q, const float* r, float* result){
+	scalar::versor vq = load_versor(q);
+	scalar::versor p = vq*load_versor(r);
+	for(int i=0; i<4; i++) result[i] = p.q[i];
+}
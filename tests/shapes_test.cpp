@@ -0,0 +1,313 @@
+//Collision shapes against brute force
+//Convex hull (ConvexHull.h): hull contains every input point, faces point outwards and close up,
+//and hill-climbing support() agrees with a scan over all the input points
+//Narrowphase (Narrowphase.h): closed-form tests agree with GJK away from touching, and their mtvs separate the shapes
+//Compound (Compound.h): the child BVH finds exactly the children that testing every child finds, as the compound moves
+#define COLLISION_STATS
+#include "sim_headers.h"
+#include "ConvexHull.h"
+#include "Narrowphase.h"
+#include "Compound.h"
+#include "test.h"
+
+#define TEST_NUM_DIRS 2000
+#define TEST_HULL_TOLERANCE 1e-4f
+#define TEST_NUM_PAIRS 2000
+#define TEST_NUM_CHILDREN 48	//per shape type
+#define TEST_NUM_COMPOUND_MOVES 50
+#define TEST_GJK_MARGIN 0.05f	//GJK's triangles are prisms 0.01 deep and it stops within a tolerance, so only compare clear cases
+
+static vec3 random_point(float size){
+	return vec3(random_float(-size, size), random_float(-size, size), random_float(-size, size));
+}
+
+static vec3 random_dir(){
+	vec3 d;
+	do { d = random_point(1); } while(length2(d)<0.01f || length2(d)>1);
+	return normalise(d);
+}
+
+static versor random_rotation(){
+	vec3 axis = random_dir();
+	return quat_from_axis_rad(random_float(0, (float)TAU), axis.x, axis.y, axis.z);
+}
+
+static void check_convex_hull(const char* name, const float* vp, uint32_t num_points){
+	ConvexHull hull;
+	bool ok = init_convex_hull(&hull, vp, num_points);
+	CHECK(ok);
+	if(!ok) return;
+
+	//Closed surface: every edge shared by two faces, so V - E + F = 2 with E = 3F/2
+	CHECK((int)hull.num_verts - (int)hull.num_faces/2 == 2);
+
+	//Every input point (hull verts included) is behind or on every face
+	float max_outside = 0;
+	for(uint32_t f=0; f<hull.num_faces; f++){
+		vec3 a = hull.verts[hull.indices[3*f]], b = hull.verts[hull.indices[3*f+1]], c = hull.verts[hull.indices[3*f+2]];
+		vec3 n = normalise(cross(b-a, c-a));
+		for(uint32_t i=0; i<num_points; i++){
+			vec3 p = vec3(vp[3*i], vp[3*i+1], vp[3*i+2]);
+			max_outside = MAX(max_outside, dot(p-a, n));
+		}
+	}
+	CHECK(max_outside<=TEST_HULL_TOLERANCE);
+
+	//Support in random directions with a rotated, scaled transform, in a random order (hill climbing
+	//starts from wherever the last query ended) and in small steps (like GJK)
+	//NB: Uniform scale, support() maps directions like the other colliders, which is only exact for that
+	float scale = random_float(0.5f, 2);
+	hull.xform = make_transform(random_point(5), random_rotation(), vec3(scale, scale, scale));
+	float max_error = 0;
+	vec3 dir = random_dir();
+	for(int d=0; d<TEST_NUM_DIRS; d++){
+		dir = (d%2) ? random_dir() : normalise(dir + random_point(0.1f));
+		float best = -FLT_MAX;
+		for(uint32_t i=0; i<num_points; i++){
+			best = MAX(best, dot(transform_point(hull.xform, vec3(vp[3*i], vp[3*i+1], vp[3*i+2])), dir));
+		}
+		max_error = MAX(max_error, fabsf(dot(hull.support(dir), dir) - best));
+	}
+	CHECK(max_error<=TEST_HULL_TOLERANCE*10);
+	printf("%s: %u points -> %u hull verts, %u faces, support error %g\n", name, num_points, hull.num_verts, hull.num_faces, max_error);
+	clear_convex_hull(&hull);
+}
+
+static void check_convex_hulls(){
+	//Points on and inside a sphere: lots of hull verts, so support() hill-climbs
+	const uint32_t num_points = 1000;
+	float* vp = (float*)malloc(3*num_points*sizeof(float));
+	for(uint32_t i=0; i<num_points; i++){
+		vec3 p = random_dir()*((i%4) ? 1.0f : random_float(0, 1));
+		memcpy(&vp[3*i], p.v, 3*sizeof(float));
+	}
+	check_convex_hull("sphere cloud", vp, num_points);
+
+	//Cube corners plus points inside and on its faces: only the 8 corners should survive,
+	//coplanar points on the faces mustn't become hull verts
+	for(uint32_t i=0; i<num_points; i++){
+		vec3 p = random_point(1);
+		if(i<8) p = vec3((i&1) ? 1 : -1, (i&2) ? 1 : -1, (i&4) ? 1 : -1);
+		else if(i%2) p.v[i%3] = (i%4==1) ? 1 : -1;
+		memcpy(&vp[3*i], p.v, 3*sizeof(float));
+	}
+	check_convex_hull("cube cloud", vp, num_points);
+	free(vp);
+
+	//A real mesh
+	float* mesh_vp = NULL;
+	uint32_t mesh_verts = 0;
+	if(load_obj("capsule.obj", &mesh_vp, &mesh_verts)){
+		check_convex_hull("capsule.obj", mesh_vp, mesh_verts);
+		free(mesh_vp);
+	}
+	else CHECK(!"couldn't load capsule.obj");
+
+	//Too few points is an error, not a crash
+	float tiny[9] = { 0,0,0, 1,0,0, 0,1,0 };
+	ConvexHull hull;
+	CHECK(!init_convex_hull(&hull, tiny, 3));
+}
+
+static TriangleCollider random_triangle(float size){
+	TriangleCollider triangle;
+	for(int i=0; i<3; i++) triangle.points[i] = random_point(size);
+	triangle.normal = normalise(cross(triangle.points[1]-triangle.points[0], triangle.points[2]-triangle.points[0]));
+	triangle.xform.pos = (triangle.points[0] + triangle.points[1] + triangle.points[2])/3;
+	return triangle;
+}
+
+//Distance from p to triangle abc by sampling, to check closest_point_on_triangle without using it
+static float sampled_triangle_distance(vec3 p, vec3 a, vec3 b, vec3 c){
+	const int n = 200;
+	float best = FLT_MAX;
+	for(int i=0; i<=n; i++){
+		for(int j=0; i+j<=n; j++){
+			vec3 q = a + (b-a)*((float)i/n) + (c-a)*((float)j/n);
+			best = MIN(best, length(p-q));
+		}
+	}
+	return best;
+}
+
+//GJK on a pair, or -1 if it gave up at GJK_MAX_NUM_ITERATIONS (nothing to compare against then)
+static int gjk_result(Collider* c1, Collider* c2){
+	const IterationHistogram &histogram = collision_histograms().gjk[c1->type][c2->type];
+	uint32_t num_capped = histogram.num_capped;
+	bool hit = gjk(c1, c2);
+	return (histogram.num_capped==num_capped) ? hit : -1;
+}
+
+static void check_narrowphase(){
+	collision_stats_begin_frame();
+	int gjk_compared = 0, gjk_gave_up = 0;
+	#define CHECK_GJK(c1, c2, expected) { \
+		int gjk_hit = gjk_result(c1, c2); \
+		if(gjk_hit<0) gjk_gave_up++; \
+		else { CHECK(gjk_hit==(int)(expected)); gjk_compared++; } \
+	}
+
+	//Sphere-sphere: exact, and GJK agrees on hit (EPA doesn't converge on round shapes, so no depth to compare)
+	for(int i=0; i<TEST_NUM_PAIRS; i++){
+		Sphere s1, s2;
+		s1.r = random_float(0.2f, 1);
+		s2.r = random_float(0.2f, 1);
+		float scale = random_float(0.5f, 2);
+		s1.xform = make_transform(random_point(2), random_rotation(), vec3(scale, scale, scale));
+		s2.xform.pos = random_point(2);
+		float r = s1.r*scale + s2.r;
+		float dist = length(s1.xform.pos-s2.xform.pos);
+		vec3 mtv;
+		bool hit = collide(&s1, &s2, &mtv);
+		CHECK(hit==(dist<=r));
+		if(hit) CHECK_NEAR(length((s1.xform.pos+mtv)-s2.xform.pos), r, 1e-4);
+		if(fabsf(dist-r)<TEST_GJK_MARGIN) continue;
+		CHECK_GJK(&s1, &s2, hit);
+	}
+
+	//Sphere-triangle (both argument orders)
+	float max_closest_error = 0;
+	for(int i=0; i<TEST_NUM_PAIRS; i++){
+		TriangleCollider triangle = random_triangle(2);
+		Sphere sphere;
+		sphere.r = random_float(0.2f, 1.5f);
+		sphere.xform.pos = random_point(2);
+		vec3 closest = closest_point_on_triangle(sphere.xform.pos, triangle.points[0], triangle.points[1], triangle.points[2]);
+		float dist = length(sphere.xform.pos-closest);
+		if(i<200) max_closest_error = MAX(max_closest_error, dist - sampled_triangle_distance(sphere.xform.pos, triangle.points[0], triangle.points[1], triangle.points[2]));
+		vec3 mtv, mtv_swapped;
+		bool hit = collide(&sphere, &triangle, &mtv);
+		CHECK(hit==(dist<=sphere.r));
+		CHECK(collide(&triangle, &sphere, &mtv_swapped)==hit);
+		if(hit){
+			CHECK(length(mtv+mtv_swapped)<1e-6f);
+			vec3 moved = sphere.xform.pos + mtv;
+			if(dist>0) CHECK_NEAR(length(moved - closest_point_on_triangle(moved, triangle.points[0], triangle.points[1], triangle.points[2])), sphere.r, 1e-4);
+		}
+		if(fabsf(dist-sphere.r)<TEST_GJK_MARGIN) continue;
+		CHECK_GJK(&sphere, &triangle, hit);
+	}
+	CHECK(max_closest_error<0.02f); //sampling is only so fine, closest point can't be further than a sample
+
+	//Box-triangle: anything GJK sees hitting a slightly shrunk box, SAT has to see hitting the box,
+	//and anything SAT sees hitting, GJK has to see hitting a slightly grown box
+	int num_hits = 0;
+	for(int i=0; i<TEST_NUM_PAIRS; i++){
+		TriangleCollider triangle = random_triangle(2);
+		Box box, shrunk, grown;
+		box.half_extents = vec3(random_float(0.2f, 1), random_float(0.2f, 1), random_float(0.2f, 1));
+		box.xform = make_transform(random_point(1.5f), random_rotation(), vec3(1,1,1));
+		shrunk = grown = box;
+		shrunk.half_extents -= vec3(1,1,1)*TEST_GJK_MARGIN;
+		grown.half_extents += vec3(1,1,1)*TEST_GJK_MARGIN;
+		vec3 mtv, mtv_swapped;
+		bool hit = collide(&box, &triangle, &mtv);
+		CHECK(collide(&triangle, &box, &mtv_swapped)==hit);
+		if(!hit) CHECK_GJK(&shrunk, &triangle, false);
+		if(hit) CHECK_GJK(&grown, &triangle, true);
+		if(!hit) continue;
+		num_hits++;
+		CHECK(length(mtv+mtv_swapped)<1e-6f);
+		//mtv only just separates: a bit less than it still hits, a bit more is clear
+		Box moved = box;
+		moved.xform.pos = box.xform.pos + mtv*1.001f + normalise(mtv)*1e-4f;
+		CHECK(!collide(&moved, &triangle));
+		moved.xform.pos = box.xform.pos + mtv*0.95f;
+		if(length(mtv)>1e-3f) CHECK(collide(&moved, &triangle));
+	}
+	CHECK(num_hits>TEST_NUM_PAIRS/10);
+
+	#undef CHECK_GJK
+	CHECK(gjk_gave_up<TEST_NUM_PAIRS/100);
+	printf("narrowphase: %u closed form tests, %d compared with gjk (gjk gave up on %d), closest point error %g\n",
+		collision_stats_frame().closed_form_tests, gjk_compared, gjk_gave_up, max_closest_error);
+}
+
+static int compare_contacts(const void* a, const void* b){
+	int ca = ((const CompoundContact*)a)->child, cb = ((const CompoundContact*)b)->child;
+	return (ca>cb) - (ca<cb);
+}
+
+static void check_compound(){
+	//Spheres, boxes and capsules scattered through a 10m cube, so the BVH has a few levels
+	const uint32_t num_children = 3*TEST_NUM_CHILDREN;
+	Sphere* spheres = new Sphere[TEST_NUM_CHILDREN];
+	Box* boxes = new Box[TEST_NUM_CHILDREN];
+	Capsule* capsules = new Capsule[TEST_NUM_CHILDREN];
+	Collider* children[num_children];
+	Transform child_xforms[num_children];
+	for(uint32_t i=0; i<TEST_NUM_CHILDREN; i++){
+		spheres[i].r = random_float(0.2f, 1);
+		boxes[i].half_extents = vec3(random_float(0.2f, 1), random_float(0.2f, 1), random_float(0.2f, 1));
+		capsules[i].r = random_float(0.2f, 0.5f);
+		capsules[i].y_base = capsules[i].r;
+		capsules[i].y_cap = capsules[i].r + random_float(0, 1);
+		children[i] = &spheres[i];
+		children[TEST_NUM_CHILDREN+i] = &boxes[i];
+		children[2*TEST_NUM_CHILDREN+i] = &capsules[i];
+	}
+	for(uint32_t i=0; i<num_children; i++) child_xforms[i] = make_transform(random_point(5), random_rotation(), vec3(1,1,1));
+
+	CompoundCollider compound;
+	compound.xform = make_transform(random_point(5), random_rotation(), vec3(1,1,1));
+	init_compound(&compound, children, child_xforms, num_children);
+
+	CompoundContact contacts[num_children], expected[num_children];
+	int max_contacts = 0, num_tests = 0;
+	for(int move=0; move<TEST_NUM_COMPOUND_MOVES; move++){
+		float scale = random_float(0.5f, 2);
+		compound.xform = make_transform(random_point(5), random_rotation(), vec3(scale, scale, scale));
+		update_compound(&compound);
+
+		//Children follow the compound
+		float max_child_error = 0;
+		for(uint32_t i=0; i<num_children; i++){
+			max_child_error = MAX(max_child_error, length(children[i]->xform.pos - transform_point(compound.xform, child_xforms[i].pos)));
+		}
+		CHECK(max_child_error<1e-4f);
+
+		//Against a sphere, a box and a triangle, from touching a child or two to reaching dozens
+		Sphere sphere;
+		sphere.r = random_float(0.3f, 2);
+		sphere.xform.pos = compound.xform.pos + random_point(5*scale);
+		Box box;
+		box.half_extents = vec3(random_float(0.3f, 2), random_float(0.3f, 2), random_float(0.3f, 2));
+		box.xform = make_transform(compound.xform.pos + random_point(5*scale), random_rotation(), vec3(1,1,1));
+		TriangleCollider triangle = random_triangle(5*scale);
+		Collider* others[3] = { &sphere, &box, &triangle };
+		for(int o=0; o<3; o++){
+			int num_contacts = collide_compound(&compound, others[o], contacts, num_children);
+			int num_expected = 0;
+			for(uint32_t i=0; i<num_children; i++){
+				vec3 mtv;
+				if(!collide(children[i], others[o], &mtv)) continue;
+				expected[num_expected].child = i;
+				expected[num_expected].mtv = mtv;
+				num_expected++;
+			}
+			qsort(contacts, num_contacts, sizeof(CompoundContact), compare_contacts);
+			CHECK(num_contacts==num_expected);
+			CHECK(num_contacts==num_expected && memcmp(contacts, expected, num_contacts*sizeof(CompoundContact))==0);
+			max_contacts = MAX(max_contacts, num_contacts);
+			num_tests++;
+
+			//A full contacts buffer stops the query, it doesn't overrun
+			if(num_contacts>2) CHECK(collide_compound(&compound, others[o], contacts, 2)==2);
+		}
+	}
+	CHECK(max_contacts>3);
+	printf("compound: %u children, %d nodes, %d queries, up to %d contacts\n", num_children, compound.num_nodes, num_tests, max_contacts);
+
+	clear_compound(&compound);
+	delete[] capsules;
+	delete[] boxes;
+	delete[] spheres;
+}
+
+int main(){
+	test_seed(99);
+	check_convex_hulls();
+	check_narrowphase();
+	check_compound();
+	return test_result("shapes_test");
+}
@@ -0,0 +1,25 @@
+#pragma once
+//What Player.h, Level.h and friends expect to be defined before them, with no window or GL (same as server.cpp)
+#ifndef HEADLESS
+#define HEADLESS
+#endif
+#define GLFW_INCLUDE_NONE //only want GLFW's types and key codes, nothing gets linked
+#include <GLFW/glfw3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+GLFWwindow* window = NULL;
+int gl_width = 1080;
+int gl_height = 720;
+float gl_aspect_ratio = (float)gl_width/gl_height;
+bool gl_fullscreen = false;
+
+#include "GameMaths.h"
+#include "Profiler.h"
+#include "Input.h"
+#include "Camera3D.h"
+#include "load_obj.h"
+#include "Player.h"
+#include "GJK.h"
+#include "Level.h"
@@ -0,0 +1,199 @@
+//Level streaming (LevelStreaming.h) with a procedural tile loader: agents walk out across the world and back,
+//and once loads finish every agent sees exactly the tiles in range, the right ones, each loaded once while
+//memory allows, and with a tight budget old tiles get evicted (and loaded again when they're needed again)
+#include "sim_headers.h"
+#include "LevelStreaming.h"
+#include "test.h"
+#include <chrono>
+
+#define TEST_TILE_SIZE 16.0f
+#define TEST_TILE_CELLS 8			//heightfield cells per tile side
+#define TEST_LOAD_RADIUS 20.0f
+#define TEST_MAX_TILES 128
+#define TEST_WORLD_TILES 64		//tile coords -32..31, plenty for the walk
+#define TEST_MISSING_TILE_X 2		//a column of tiles that don't exist
+#define TEST_NUM_AGENTS 4
+#define TEST_NUM_STEPS 160		//out and back, 1m per step
+#define TEST_MAX_SETTLE_TRIES 2000	//1ms apart
+
+static std::atomic<int> g_load_counts[TEST_WORLD_TILES][TEST_WORLD_TILES];
+
+//Flat tile at a height that says which tile it is
+static float tile_height(int32_t tile_x, int32_t tile_z){
+	return (float)(100*tile_x + tile_z);
+}
+
+static bool load_test_tile(int32_t tile_x, int32_t tile_z, LevelCollider* level, void* user_data){
+	(void)user_data;
+	if(tile_x>=-TEST_WORLD_TILES/2 && tile_x<TEST_WORLD_TILES/2 && tile_z>=-TEST_WORLD_TILES/2 && tile_z<TEST_WORLD_TILES/2){
+		g_load_counts[tile_x+TEST_WORLD_TILES/2][tile_z+TEST_WORLD_TILES/2]++;
+	}
+	if(tile_x==TEST_MISSING_TILE_X) return false;
+	const int n = TEST_TILE_CELLS+1;
+	float* heights = (float*)malloc(n*n*sizeof(float));
+	for(int i=0; i<n*n; i++) heights[i] = tile_height(tile_x, tile_z);
+	const float cell_size = TEST_TILE_SIZE/TEST_TILE_CELLS;
+	*level = init_level_heightfield(heights, n, n, tile_x*TEST_TILE_SIZE, tile_z*TEST_TILE_SIZE, cell_size, cell_size);
+	return true;
+}
+
+static bool any_tile_loading(const LevelStreamer &streamer){
+	for(int i=0; i<streamer.max_tiles; i++){
+		if(streamer.tiles[i].state.load()==TILE_LOADING) return true;
+	}
+	return false;
+}
+
+static bool tile_resident(const LevelStreamer &streamer, int32_t tile_x, int32_t tile_z){
+	int slot = find_stream_tile(streamer, tile_x, tile_z);
+	return slot>=0 && streamer.tiles[slot].counted;
+}
+
+//Keep updating with the same positions until nothing is loading and every finished load has been picked up
+//Returns false if the loader never caught up. Checks no update evicts a tile an agent needs
+static bool settle_streaming(LevelStreamer* streamer, const vec3* positions, int num_agents){
+	for(int tries=0; tries<TEST_MAX_SETTLE_TRIES; tries++){
+		uint64_t resident[TEST_MAX_TILES];
+		int num_resident = 0;
+		for(int a=0; a<num_agents; a++){
+			const vec3 &p = positions[a];
+			for(int32_t z=get_tile_coord(*streamer, p.z-TEST_LOAD_RADIUS); z<=get_tile_coord(*streamer, p.z+TEST_LOAD_RADIUS); z++)
+			for(int32_t x=get_tile_coord(*streamer, p.x-TEST_LOAD_RADIUS); x<=get_tile_coord(*streamer, p.x+TEST_LOAD_RADIUS); x++){
+				if(num_resident<TEST_MAX_TILES && tile_resident(*streamer, x, z)) resident[num_resident++] = get_tile_key(x, z);
+			}
+		}
+		update_level_streaming(streamer, positions, num_agents);
+		int num_evicted = 0;
+		for(int i=0; i<num_resident; i++){
+			if(!tile_resident(*streamer, (int32_t)(resident[i]>>32), (int32_t)(uint32_t)resident[i])) num_evicted++;
+		}
+		CHECK(num_evicted==0);
+
+		bool settled = !any_tile_loading(*streamer);
+		for(int i=0; i<streamer->max_tiles && settled; i++){
+			if(streamer->tiles[i].state.load()==TILE_LOADED && !streamer->tiles[i].counted) settled = false;
+		}
+		//Requests past LEVEL_STREAMING_MAX_REQUESTS wait for a later update, so that needs another go too
+		for(int a=0; a<num_agents && settled; a++){
+			const vec3 &p = positions[a];
+			for(int32_t z=get_tile_coord(*streamer, p.z-TEST_LOAD_RADIUS); z<=get_tile_coord(*streamer, p.z+TEST_LOAD_RADIUS); z++)
+			for(int32_t x=get_tile_coord(*streamer, p.x-TEST_LOAD_RADIUS); x<=get_tile_coord(*streamer, p.x+TEST_LOAD_RADIUS); x++){
+				if(find_stream_tile(*streamer, x, z)<0) settled = false;
+			}
+		}
+		if(settled) return true;
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	return false;
+}
+
+//Every agent sees exactly the existing tiles in range, each one the tile it should be
+static void check_streamed_tiles(const LevelStreamer &streamer, const vec3* positions, int num_agents){
+	for(int a=0; a<num_agents; a++){
+		const vec3 &p = positions[a];
+		const LevelCollider* results[TEST_MAX_TILES];
+		int num_results = get_streamed_tiles(streamer, p, TEST_LOAD_RADIUS, results, TEST_MAX_TILES);
+		int num_expected = 0, num_found = 0;
+		for(int32_t z=get_tile_coord(streamer, p.z-TEST_LOAD_RADIUS); z<=get_tile_coord(streamer, p.z+TEST_LOAD_RADIUS); z++)
+		for(int32_t x=get_tile_coord(streamer, p.x-TEST_LOAD_RADIUS); x<=get_tile_coord(streamer, p.x+TEST_LOAD_RADIUS); x++){
+			if(x==TEST_MISSING_TILE_X) continue;
+			num_expected++;
+			for(int r=0; r<num_results; r++){
+				GroundHit hit;
+				if(get_ground_height(*results[r], (x+0.5f)*TEST_TILE_SIZE, (z+0.5f)*TEST_TILE_SIZE, &hit) && hit.height==tile_height(x, z)){
+					num_found++;
+					break;
+				}
+			}
+		}
+		CHECK(num_results==num_expected);
+		CHECK(num_found==num_expected);
+	}
+
+	//Memory total is the sum of what's resident
+	size_t memory = 0;
+	for(int i=0; i<streamer.max_tiles; i++){
+		if(streamer.tiles[i].counted) memory += level_memory_usage(streamer.tiles[i].level);
+	}
+	CHECK(memory==streamer.memory_used);
+}
+
+struct StreamingResult {
+	int distinct_tiles;		//existing tiles loaded at least once
+	int total_loads;		//of existing tiles
+	int max_missing_loads;	//most times one missing tile was asked for
+	size_t max_memory_used;
+};
+
+//Agents in a line across z walk out along x and come back
+static StreamingResult walk_agents(size_t memory_budget){
+	for(int x=0; x<TEST_WORLD_TILES; x++)
+	for(int z=0; z<TEST_WORLD_TILES; z++) g_load_counts[x][z].store(0);
+
+	LevelStreamer streamer;
+	init_level_streamer(&streamer, TEST_TILE_SIZE, TEST_LOAD_RADIUS, memory_budget, TEST_MAX_TILES, load_test_tile, NULL);
+	vec3 positions[TEST_NUM_AGENTS];
+	for(int a=0; a<TEST_NUM_AGENTS; a++) positions[a] = vec3(0, 0, 3.0f*a - 5);
+
+	//Loads happen on the loader thread, and finished ones only show up at the next update
+	update_level_streaming(&streamer, positions, TEST_NUM_AGENTS);
+	for(int tries=0; tries<TEST_MAX_SETTLE_TRIES && any_tile_loading(streamer); tries++){
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	}
+	const LevelCollider* results[TEST_MAX_TILES];
+	CHECK(get_streamed_tiles(streamer, positions[0], TEST_LOAD_RADIUS, results, TEST_MAX_TILES)==0);
+	update_level_streaming(&streamer, positions, TEST_NUM_AGENTS);
+	CHECK(get_streamed_tiles(streamer, positions[0], TEST_LOAD_RADIUS, results, TEST_MAX_TILES)>0);
+
+	StreamingResult result = { 0, 0, 0, 0 };
+	for(int step=0; step<=TEST_NUM_STEPS; step++){
+		float x = (step<=TEST_NUM_STEPS/2) ? (float)step : (float)(TEST_NUM_STEPS-step);
+		for(int a=0; a<TEST_NUM_AGENTS; a++) positions[a].x = x;
+		bool settled = settle_streaming(&streamer, positions, TEST_NUM_AGENTS);
+		CHECK(settled);
+		if(!settled) break;
+		//Another tick with nobody moving changes nothing: tiles in use don't get evicted and loaded again
+		update_level_streaming(&streamer, positions, TEST_NUM_AGENTS);
+		CHECK(!any_tile_loading(streamer));
+		check_streamed_tiles(streamer, positions, TEST_NUM_AGENTS);
+		result.max_memory_used = MAX(result.max_memory_used, streamer.memory_used);
+	}
+	clear_level_streamer(&streamer);
+
+	for(int x=0; x<TEST_WORLD_TILES; x++)
+	for(int z=0; z<TEST_WORLD_TILES; z++){
+		int loads = g_load_counts[x][z].load();
+		if(x-TEST_WORLD_TILES/2==TEST_MISSING_TILE_X){
+			result.max_missing_loads = MAX(result.max_missing_loads, loads);
+			continue;
+		}
+		if(loads>0) result.distinct_tiles++;
+		result.total_loads += loads;
+	}
+	return result;
+}
+
+int main(){
+	//Tiles agents can see at once: load_radius either side spans 3-4 tiles, along x and across the line of agents in z
+	LevelCollider tile;
+	load_test_tile(0, 0, &tile, NULL);
+	size_t tile_memory = level_memory_usage(tile);
+	clear_level(&tile);
+	const int tiles_in_range = 4*4;
+
+	//Room for everything: each tile loads once, missing tiles are asked for once and remembered
+	StreamingResult result = walk_agents(1000*tile_memory);
+	CHECK(result.total_loads==result.distinct_tiles);
+	CHECK(result.max_missing_loads==1);
+	printf("large budget: %d tiles loaded once each, up to %zu bytes resident\n", result.distinct_tiles, result.max_memory_used);
+
+	//Budget for a few tiles more than the agents need: resident memory stays under it, so coming back loads tiles again
+	size_t budget = (tiles_in_range+4)*tile_memory;
+	result = walk_agents(budget);
+	CHECK(result.max_memory_used<=budget);
+	CHECK(result.total_loads>result.distinct_tiles);
+	CHECK(result.max_missing_loads==1);
+	printf("budget %zu bytes: %d tiles, %d loads, up to %zu bytes resident\n", budget, result.distinct_tiles, result.total_loads, result.max_memory_used);
+
+	return test_result("streaming_test");
+}
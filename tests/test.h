@@ -0,0 +1,46 @@
+#pragma once
+#include <stdio.h>
+#include <math.h>
+#include <stdint.h>
+
+//Minimal checks for the programs in tests/. A failed check prints where it was and carries on,
+//main returns test_result() so "make Test" stops at the first program with a failure
+
+#define TEST_MAX_REPORTED_FAILURES 20 //checks in loops can fail thousands of times, only print the first few
+
+static int g_test_checks = 0;
+static int g_test_failures = 0;
+
+#define CHECK(cond) do { \
+	g_test_checks++; \
+	if(!(cond)){ \
+		if(g_test_failures<TEST_MAX_REPORTED_FAILURES) printf("FAILED %s:%d: %s\n", __FILE__, __LINE__, #cond); \
+		g_test_failures++; \
+	} \
+} while(0)
+
+#define CHECK_NEAR(a, b, tolerance) do { \
+	g_test_checks++; \
+	double check_a_ = (a), check_b_ = (b); \
+	if(!(fabs(check_a_-check_b_)<=(tolerance))){ \
+		if(g_test_failures<TEST_MAX_REPORTED_FAILURES) \
+			printf("FAILED %s:%d: %s = %.9g, %s = %.9g (tolerance %g)\n", __FILE__, __LINE__, #a, check_a_, #b, check_b_, (double)(tolerance)); \
+		g_test_failures++; \
+	} \
+} while(0)
+
+//Repeatable random numbers (an LCG), each program picks its own seed with test_seed() at the start of main
+static uint32_t g_test_rng = 1;
+inline void test_seed(uint32_t seed){
+	g_test_rng = seed;
+}
+inline float random_float(float lo, float hi){
+	g_test_rng = g_test_rng*1664525u + 1013904223u;
+	return lo + (hi-lo)*((g_test_rng >> 8)*(1.0f/16777216.0f));
+}
+
+inline int test_result(const char* name){
+	if(g_test_failures) printf("%s: %d of %d checks FAILED\n", name, g_test_failures, g_test_checks);
+	else printf("%s: all %d checks passed\n", name, g_test_checks);
+	return g_test_failures ? 1 : 0;
+}